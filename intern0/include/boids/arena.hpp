@@ -0,0 +1,126 @@
+// ------------------------------------------------------------
+// FrameArena：ティック内だけ使う一時領域のバンプアロケータ
+//   make<T>(n) は先頭から詰めて切り出すだけ，reset() は位置を 0 に戻すだけ（O(1)）．
+//   ティック中に足りなくなったら追加ブロックを取り（このティックだけ確保が起きる），
+//   次の reset() で全体を 1 ブロックにまとめ直すので，ウォームアップ後は確保なし．
+//   置けるのはトリビアルに破棄できる型だけ（デストラクタは呼ばない）．
+//   ブロックは HugePages から取る（2 MiB 以上なら huge page，kind() で何で取れたか）．
+//   data() は現在の先頭ブロックなので，reserve() の後に呼び出し側が first-touch できる
+//
+// AllocCounter：グローバル operator new の呼び出し回数
+//   置き換え本体は実行ファイル側（BOIDS_COUNT_ALLOC を定義した 1 つの翻訳単位）で
+//   count() を呼ぶ．定常ループの前後で news() の差を見れば確保の有無がわかる
+// ------------------------------------------------------------
+#ifndef __BOIDS_ARENA_HPP__
+#define __BOIDS_ARENA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <span>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include "numa.hpp"
+
+struct AllocCounter {
+    static std::atomic<uint64_t>& counter() { static std::atomic<uint64_t> n{0}; return n; }
+    static void     count() { counter().fetch_add(1, std::memory_order_relaxed); }
+    static uint64_t news()  { return counter().load(std::memory_order_relaxed); }
+};
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t bytes = 1 << 16) { blocks_.reserve(8); grow(bytes); }
+    ~FrameArena() { release(); }
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // 未初期化の n 要素（値は呼び出し側が書く）
+    template<class T>
+    std::span<T> make(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T>, "FrameArena holds trivially destructible types only");
+        return { static_cast<T*>(alloc(n * sizeof(T), alignof(T))), n };
+    }
+    // src を並べてコピー
+    template<class T>
+    std::span<T> copy(std::span<const T> src) {
+        static_assert(std::is_trivially_copyable_v<T>, "FrameArena::copy needs trivially copyable types");
+        std::span<T> dst = make<T>(src.size());
+        std::copy(src.begin(), src.end(), dst.begin());
+        return dst;
+    }
+    // 同じく，parallelFor の区間ごとに各スレッドがコピー（first-touch した区間と同じ担当）
+    template<class T>
+    std::span<T> copy(std::span<const T> src, ThreadPool& pool) {
+        static_assert(std::is_trivially_copyable_v<T>, "FrameArena::copy needs trivially copyable types");
+        std::span<T> dst = make<T>(src.size());
+        pool.parallelFor((int)src.size(), [&](int b, int e){
+            std::copy(src.begin() + b, src.begin() + e, dst.begin() + b);
+        });
+        return dst;
+    }
+
+    // あらかじめ bytes 以上を 1 ブロックで持つ（ティックの外で呼ぶ）
+    void reserve(size_t bytes) {
+        if (capacity() >= bytes) return;
+        release();
+        grow(bytes);
+        used_ = 0;
+    }
+
+    // ティックの先頭で呼ぶ．前のティックで溢れていたら合計サイズの 1 ブロックに
+    void reset() {
+        if (blocks_.size() > 1) {
+            const size_t total = std::max(highWater_, capacity());
+            release();
+            grow(total + total / 4);
+            ++regrows_;
+        }
+        used_ = 0;
+        off_  = 0;
+    }
+
+    void*  data()      const { return blocks_.empty() ? nullptr : blocks_.front().data; }
+    HugePages::Kind kind() const { return kind_; }
+    size_t used()      const { return used_; }
+    size_t highWater() const { return highWater_; }
+    size_t capacity()  const { size_t c = 0; for (const Block& b : blocks_) c += b.size; return c; }
+    int    regrows()   const { return regrows_; }
+
+private:
+    struct Block { std::byte* data; size_t size; };
+    std::vector<Block> blocks_;     // 末尾が現在のブロック
+    size_t off_{0};                 // 現在のブロック内の位置
+    size_t used_{0}, highWater_{0};
+    int    regrows_{0};
+    HugePages::Kind kind_{HugePages::Heap};     // 直近のブロックの取り方
+    static constexpr std::align_val_t kAlign{64};
+
+    void* alloc(size_t bytes, size_t align) {
+        Block* b = &blocks_.back();
+        size_t at = (off_ + align - 1) & ~(align - 1);
+        if (at + bytes > b->size) {
+            grow(std::max(bytes + align, b->size * 2));
+            b  = &blocks_.back();
+            at = 0;
+        }
+        off_   = at + bytes;
+        used_ += bytes;
+        highWater_ = std::max(highWater_, used_);
+        return b->data + at;
+    }
+    void grow(size_t bytes) {
+        blocks_.push_back(Block{ static_cast<std::byte*>(HugePages::allocate(bytes, kAlign)), bytes });
+        kind_ = bytes >= HugePages::kHuge ? (HugePages::Kind)HugePages::lastKind().load() : HugePages::Heap;
+        off_ = 0;
+    }
+    void release() {
+        for (const Block& b : blocks_) HugePages::release(b.data, b.size, kAlign);
+        blocks_.clear();
+    }
+};
+
+#endif // __BOIDS_ARENA_HPP__
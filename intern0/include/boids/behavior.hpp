@@ -0,0 +1,171 @@
+// ------------------------------------------------------------
+// Behavior<Terms...>：力の項をコンパイル時に組み合わせる
+//   BasicAgent<D, Behavior<Separation, Alignment, Wall>> のように使う．
+//   含まれない項はコードごと消え，含まれる項は近傍ループ 1 本に融合される．
+//
+//   各項は ForceTerm を継承し，必要なフックだけを上書きする
+//     pair(f, nb, P)   近傍 1 体ぶん（nb.d < 視野半径のときだけ呼ばれる）
+//     self(f, me, P)   自分の状態だけで決まる項（ループの後）
+//     needsFlock       近傍が「仲間」か（SpeciesTable::flocks）を使う
+//     flockStats       仲間の平均速度・平均位置を使う（整列・凝集）
+//     random           ティックごとに乱数力を引く
+//   Tier<P> を入れると距離・制限の norm を精度 P で計算する（既定 BOIDS_PRECISION）
+//   合力は従来と同じ順（分離，整列，凝集，壁，乱数，ゴール，種間）に足す
+// ------------------------------------------------------------
+#ifndef __BOIDS_BEHAVIOR_HPP__
+#define __BOIDS_BEHAVIOR_HPP__
+
+#include <type_traits>
+#include <algorithm>
+#include "vec.hpp"
+#include "species.hpp"
+#include "flowfield.hpp"
+
+// 項ごとの累積（使わない項はゼロのまま，合成時に足さない）
+template<int D>
+struct ForceAcc {
+    Vec<D> sep{}, ali{}, coh{}, wall{}, ran{}, goal{}, inter{};
+    Vec<D> vSum{}, pSum{};
+    int    cnt = 0;
+};
+
+// 視野内の近傍 1 体
+template<int D>
+struct Neighbor {
+    Vec<D> rij;        // 自分 → 相手
+    Vec<D> pj, vj;     // 相手の（外挿後の）位置と速度
+    float  d;          // |rij|
+    float  invD;       // 1/|rij|（精度段階に応じて rsqrt から）
+    float  viewRad;
+    bool   flock;      // 仲間か（needsFlock な項があるときだけ有効）
+    float  k;          // 種間ゲイン
+};
+
+// 自分の状態
+template<int D>
+struct SelfState {
+    const Vec<D>&    p;
+    const Vec<D>&    v;
+    const Vec<D>&    world;
+    const Vec<D>&    u_ran;
+    const FlowField* flow;
+};
+
+struct ForceTerm {
+    static constexpr int  tier       = -1;     // Tier<P> 以外は指定なし
+    static constexpr bool needsFlock = false;
+    static constexpr bool flockStats = false;
+    static constexpr bool random     = false;
+    template<int D> static void pair(ForceAcc<D>&, const Neighbor<D>&, const SpeciesParams&) {}
+    template<int D> static void self(ForceAcc<D>&, const SelfState<D>&, const SpeciesParams&) {}
+};
+
+// 分離（反発）：仲間と逆向き，近いほど強く
+struct Separation : ForceTerm {
+    static constexpr bool needsFlock = true;
+    template<int D> static void pair(ForceAcc<D>& f, const Neighbor<D>& n, const SpeciesParams& P) {
+        if (n.flock && n.d > 1e-4f) {
+            float overlap = n.viewRad - n.d;
+            f.sep -= n.rij * n.invD * (P.k_sep * overlap / (n.d + 1e-3f));
+        }
+    }
+};
+
+// 整列：仲間の平均速度へ
+struct Alignment : ForceTerm {
+    static constexpr bool needsFlock = true;
+    static constexpr bool flockStats = true;
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams& P) {
+        if (f.cnt > 0) f.ali += (f.vSum * (1.0f/f.cnt) - me.v) * P.k_ali;
+    }
+};
+
+// 凝集：仲間の重心へ
+struct Cohesion : ForceTerm {
+    static constexpr bool needsFlock = true;
+    static constexpr bool flockStats = true;
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams& P) {
+        if (f.cnt > 0) f.coh += (f.pSum * (1.0f/f.cnt) - me.p) * P.k_coh;
+    }
+};
+
+// 壁：やわらかバネで内側へ
+struct Wall : ForceTerm {
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams& P) {
+        const float margin = 10.f;
+        for (int k = 0; k < D; ++k) {
+            if (me.p[k] < margin)             f.wall[k] += P.k_wall * (margin - me.p[k]);
+            if (me.p[k] > me.world[k]-margin) f.wall[k] -= P.k_wall * (me.p[k] - (me.world[k]-margin));
+        }
+    }
+};
+
+// 乱数力（ティック先頭で 1 回引き，ティック中は一定）
+struct RandomWalk : ForceTerm {
+    static constexpr bool random = true;
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams&) {
+        f.ran = me.u_ran;
+    }
+};
+
+// ゴール：フローフィールドを 1 回引くだけ（2D のみ）
+struct Goal : ForceTerm {
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams& P) {
+        if constexpr (D == 2) {
+            if (me.flow) f.goal = me.flow->steer(me.p) * P.k_goal;
+        }
+    }
+};
+
+// 種間：追従(+)/逃避(-)，近いほど強く
+struct Interaction : ForceTerm {
+    template<int D> static void pair(ForceAcc<D>& f, const Neighbor<D>& n, const SpeciesParams&) {
+        if (n.k != 0.f && n.d > 1e-4f)
+            f.inter += n.rij * (n.k * (n.viewRad - n.d) / (n.viewRad * n.d));
+    }
+};
+
+// 力の項ではなく，近傍距離と制限に使う norm の精度段階（vec.hpp の Precision）
+template<Precision P>
+struct Tier : ForceTerm {
+    static constexpr int tier = (int)P;
+};
+
+template<class... Terms>
+struct Behavior {
+    static constexpr int tierMax = std::max({-1, Terms::tier...});
+    static constexpr Precision precision = tierMax < 0 ? BOIDS_PRECISION : (Precision)tierMax;
+
+    template<class T> static constexpr bool has = (std::is_same_v<T, Terms> || ...);
+    static constexpr bool needsFlock = (Terms::needsFlock || ...);
+    static constexpr bool flockStats = (Terms::flockStats || ...);
+    static constexpr bool random     = (Terms::random || ...);
+    static constexpr bool pairwise   = has<Separation> || has<Interaction> || flockStats;
+
+    template<int D> static void pair(ForceAcc<D>& f, const Neighbor<D>& n, const SpeciesParams& P) {
+        (Terms::pair(f, n, P), ...);
+    }
+    template<int D> static void self(ForceAcc<D>& f, const SelfState<D>& me, const SpeciesParams& P) {
+        (Terms::self(f, me, P), ...);
+    }
+    // 含まれる項だけを決まった順に合成
+    template<int D> static Vec<D> total(const ForceAcc<D>& f) {
+        Vec<D> F{};
+        if constexpr (has<Separation>)  F += f.sep;
+        if constexpr (has<Alignment>)   F += f.ali;
+        if constexpr (has<Cohesion>)    F += f.coh;
+        if constexpr (has<Wall>)        F += f.wall;
+        if constexpr (has<RandomWalk>)  F += f.ran;
+        if constexpr (has<Goal>)        F += f.goal;
+        if constexpr (has<Interaction>) F += f.inter;
+        return F;
+    }
+};
+
+// 従来の Agent と同じ全項入り
+using FullBoids = Behavior<Separation, Alignment, Cohesion, Wall, RandomWalk, Goal, Interaction>;
+// 全項入りで精度段階だけ指定
+template<Precision P>
+using WithTier = Behavior<Separation, Alignment, Cohesion, Wall, RandomWalk, Goal, Interaction, Tier<P>>;
+
+#endif // __BOIDS_BEHAVIOR_HPP__
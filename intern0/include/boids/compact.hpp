@@ -0,0 +1,472 @@
+// ------------------------------------------------------------
+// CompactFlock：量子化した詰めた状態で進める省メモリ版（自分の状態だけで決まる力）
+//   数百万体になると float の p, v, a（2D 24 B/体，3D 36 B/体）がキャッシュに載らず，
+//   1 ステップが帯域で頭打ちになる．ここでは状態を
+//     位置   セル原点からの 16 bit 固定小数点（セルは格納順で決まるので持たない）
+//     速度   半精度（IEEE binary16）
+//     ID     元の番号（書き戻し・比較用）
+//   の SoA に詰め，カーネルの中でだけ float に戻して積分し，また詰める．
+//   2D は 12 B/体，3D は 16 B/体（ID 込み）．加速度は毎ステップ力から作るので持たない．
+//
+//   個体はセル順に並べ，start_ で各セルの区間を持つ（格子の計数ソートと同じ CSR）．
+//   オフセットはセル幅 C に対して [-C/2, 3C/2) を表せるので，多少はみ出しても
+//   そのまま進められる．はみ出しが C/4 を超えた個体が出たら次のステップの前に
+//   計数ソートで並べ直す（rebin）．位置の分解能は C/32768，速度は相対 2^-11．
+//
+//   step(dt, field)      力は Field(p, v) → F（外部の場．壁・減衰・制限・クランプは Agent と同じ式）
+//   flockStep<B>(dt, vr, noise)  近傍の群れ．Behavior B の項（分離・整列・凝集・壁・乱数…）を
+//                        Agent::force と同じ式で集める．start_ の CSR のまま，セルごとに周囲
+//                        (2r+1)^D セルを float のタイルへ広げて視野内の相手を探す
+//                        （r = ceil(vr / C + 1/2)：はみ出し C/4 ずつを両側に見込む）．
+//                        近傍はティック先頭の状態を見るので，新しい状態は別の列に書いて入れ替える．
+//                        1 種だけ（全員が仲間・種間の力なし）．noise(id) が RandomWalk の乱数力
+// ------------------------------------------------------------
+#ifndef __BOIDS_COMPACT_HPP__
+#define __BOIDS_COMPACT_HPP__
+
+#include <vector>
+#include <span>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "vec.hpp"
+#include "species.hpp"
+#include "behavior.hpp"
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif BOIDS_VEC_SSE
+#include <emmintrin.h>
+#endif
+
+// float ↔ binary16．F16C があれば命令 1 つ，なければビット操作（最近接偶数丸め）
+inline uint16_t halfFromFloat(float f) {
+#if defined(__F16C__)
+    return (uint16_t)_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x &= 0x7fffffffu;
+    if (x >= 0x47800000u)                              // 65536 以上・inf・NaN
+        return (uint16_t)(sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    if (x < 0x38800000u) {                             // 非正規化数（2^-14 未満）
+        float a;
+        std::memcpy(&a, &x, 4);
+        return (uint16_t)(sign | (uint32_t)std::nearbyint(a * 16777216.f));   // 2^24 倍して丸め
+    }
+    const uint32_t r = x + 0xc8000fffu + ((x >> 13) & 1u);   // 指数の付け替え + 偶数丸め
+    return (uint16_t)(sign | (r >> 13));
+#endif
+}
+inline float floatFromHalf(uint16_t h) {
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    const uint32_t em   = h & 0x7fffu;
+    float f;
+    if (em >= 0x7c00u) {                               // inf・NaN
+        const uint32_t x = sign | 0x7f800000u | ((em & 0x3ffu) << 13);
+        std::memcpy(&f, &x, 4);
+    } else if (em < 0x0400u) {                         // 非正規化数
+        f = (float)em * (1.0f / 16777216.f);
+        if (sign) f = -f;
+    } else {
+        const uint32_t x = sign | ((em << 13) + 0x38000000u);
+        std::memcpy(&f, &x, 4);
+    }
+    return f;
+#endif
+}
+
+// ステップ内の一括変換（n 個ずつ）．速度は |v| <= Vmax なので正規化数の範囲だけ扱い，
+// 2^-14 未満は 0 に，65504 超は 65504 に丸める（スカラーの余りも同じ式）．
+// SSE2 で 4 個ずつ，F16C があれば cvtps_ph/cvtph_ps（非正規化数もそのまま）
+inline uint16_t halfFromFloatFast(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x = std::min(x & 0x7fffffffu, 0x477fe000u);
+    const uint32_t r = (x + 0xc8000fffu + ((x >> 13) & 1u)) >> 13;
+    return (uint16_t)(sign | (x < 0x38800000u ? 0u : r));
+}
+inline float floatFromHalfFast(uint16_t h) {
+    const uint32_t em = h & 0x7fffu;
+    const uint32_t x  = ((uint32_t)(h & 0x8000u) << 16) | (em < 0x0400u ? 0u : (em << 13) + 0x38000000u);
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+inline void halfFromFloatN(const float* src, uint16_t* dst, int n) {
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    for (; i < n; ++i) dst[i] = halfFromFloat(src[i]);
+#else
+#if BOIDS_VEC_SSE
+    const __m128i absM = _mm_set1_epi32(0x7fffffff), maxH = _mm_set1_epi32(0x477fe000);
+    const __m128i minN = _mm_set1_epi32(0x38800000 - 1), bias = _mm_set1_epi32((int)0xc8000fffu);
+    const __m128i one  = _mm_set1_epi32(1);
+    for (; i + 4 <= n; i += 4) {
+        __m128i x    = _mm_castps_si128(_mm_loadu_ps(src + i));
+        __m128i sign = _mm_and_si128(_mm_srli_epi32(x, 16), _mm_set1_epi32(0x8000));
+        x = _mm_and_si128(x, absM);
+        const __m128i big = _mm_cmpgt_epi32(x, maxH);                   // SSE2 に epu32 の min がない
+        x = _mm_or_si128(_mm_and_si128(big, maxH), _mm_andnot_si128(big, x));
+        __m128i r = _mm_add_epi32(_mm_add_epi32(x, bias), _mm_and_si128(_mm_srli_epi32(x, 13), one));
+        r = _mm_and_si128(_mm_srli_epi32(r, 13), _mm_cmpgt_epi32(x, minN));
+        r = _mm_or_si128(r, sign);
+        r = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);                  // 符号拡張して飽和なしで詰める
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packs_epi32(r, r));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = halfFromFloatFast(src[i]);
+#endif
+}
+inline void floatFromHalfN(const uint16_t* src, float* dst, int n) {
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(src + i))));
+    for (; i < n; ++i) dst[i] = floatFromHalf(src[i]);
+#else
+#if BOIDS_VEC_SSE
+    const __m128i emM = _mm_set1_epi32(0x7fff), minN = _mm_set1_epi32(0x03ff);
+    const __m128i bias = _mm_set1_epi32(0x38000000);
+    for (; i + 4 <= n; i += 4) {
+        const __m128i h  = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + i)), _mm_setzero_si128());
+        const __m128i em = _mm_and_si128(h, emM);
+        __m128i x = _mm_add_epi32(_mm_slli_epi32(em, 13), bias);
+        x = _mm_and_si128(x, _mm_cmpgt_epi32(em, minN));
+        x = _mm_or_si128(x, _mm_slli_epi32(_mm_andnot_si128(emM, h), 16));
+        _mm_storeu_ps(dst + i, _mm_castsi128_ps(x));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = floatFromHalfFast(src[i]);
+#endif
+}
+
+template<int D>
+class CompactFlock {
+public:
+    using VecD = Vec<D>;
+
+    CompactFlock(const VecD& world, float cell, float radius = 3.f, const SpeciesParams& params = {})
+        : world_(world), C_(cell), radius_(radius), P_(params),
+          toQ_(32768.f / cell), fromQ_(cell / 32768.f)
+    {
+        cells_ = 1;
+        for (int k = 0; k < D; ++k) {
+            n_[k] = std::max(1, (int)std::ceil(world[k] / cell));
+            cells_ *= n_[k];
+        }
+        start_.assign(cells_ + 1, 0);
+    }
+
+    SpeciesParams& params() { return P_; }
+    int size() const { return (int)id_.size(); }
+    int rebins() const { return rebins_; }
+    static constexpr size_t bytesPerAgent() { return D * 2 + D * 2 + 4; }
+
+    // 状態を詰める（i 番目の ID = i）
+    void assign(std::span<const VecD> p, std::span<const VecD> v) {
+        const int n = (int)p.size();
+        for (int k = 0; k < D; ++k) { q_[k].resize(n); h_[k].resize(n); q2_[k].resize(n); h2_[k].resize(n); }
+        id_.resize(n); id2_.resize(n);
+        cellOf_.resize(n); oldCell_.resize(n);
+        bin(n, [&](int i){ return p[i]; },
+               [&](int i, int k){ return halfFromFloat(v[i][k]); },
+               [&](int i){ return (uint32_t)i; });
+    }
+
+    // ID 順に float へ戻す
+    void unpack(std::vector<VecD>& p, std::vector<VecD>& v) const {
+        const int n = size();
+        p.resize(n); v.resize(n);
+        forEachCell([&](int c, const VecD& o){
+            for (int i = start_[c]; i < start_[c+1]; ++i) {
+                p[id_[i]] = position(i, o);
+                v[id_[i]] = velocity(i);
+            }
+        });
+    }
+
+    // セルを最大 kBlock 体ずつ float の作業列へ広げ，積分して詰め直す
+    template<class Field>
+    void step(float dt, Field&& field) {
+        if (dirty_) rebin();
+        const float lo = -0.25f * C_, hi = 1.25f * C_;
+        bool out = false;
+        forEachCell([&](int c, const VecD& o){
+            const int end = start_[c+1];
+            for (int b = start_[c]; b < end; b += kBlock) {
+                const int m = std::min(kBlock, end - b);
+                for (int k = 0; k < D; ++k) {
+                    dequantizeN(q_[k].data() + b, bp_[k], m, o[k]);
+                    floatFromHalfN(h_[k].data() + b, bv_[k], m);
+                }
+                for (int j = 0; j < m; ++j) {
+                    VecD p, v;
+                    for (int k = 0; k < D; ++k) { p[k] = bp_[k][j]; v[k] = bv_[k][j]; }
+                    VecD a = (field(p, v) + wall(p) - v * P_.D) * (1.0f / P_.M);
+                    clip(a, P_.Amax);
+                    v += a * dt;
+                    clip(v, P_.Vmax);
+                    p += v * dt;
+                    for (int k = 0; k < D; ++k) {
+                        const float off = std::min(std::max(p[k], radius_), world_[k] - radius_) - o[k];
+                        out |= (off < lo) | (off >= hi);
+                        bp_[k][j] = off;
+                        bv_[k][j] = v[k];
+                    }
+                }
+                for (int k = 0; k < D; ++k) {
+                    quantizeN(bp_[k], q_[k].data() + b, m);
+                    halfFromFloatN(bv_[k], h_[k].data() + b, m);
+                }
+            }
+        });
+        dirty_ = out;
+    }
+
+    // 近傍の群れで 1 ステップ（半陰的オイラー．加速度・速度の制限は B の精度段階の norm）
+    template<class B, class Noise>
+    void flockStep(float dt, float viewRadius, Noise&& noise) {
+        if (dirty_) rebin();
+        constexpr Precision PR = B::precision;
+        const int   n  = size();
+        const int   r  = (int)std::ceil(viewRadius / C_ + 0.5f);
+        const float lo = -0.25f * C_, hi = 1.25f * C_;
+        for (int k = 0; k < D; ++k) { q2_[k].resize(n); h2_[k].resize(n); }
+        bool out = false;
+        forEachCell([&](int c, const VecD& o){
+            const int base = tile(c, r);
+            for (int i = start_[c]; i < start_[c+1]; ++i) {
+                const int me = base + (i - start_[c]);
+                VecD p, v;
+                for (int k = 0; k < D; ++k) { p[k] = tp_[k][me]; v[k] = tv_[k][me]; }
+                ForceAcc<D> f;
+                if constexpr (B::pairwise) {
+                    for (int j = 0; j < tn_; ++j) {
+                        if (j == me) continue;
+                        VecD pj, vj;
+                        for (int k = 0; k < D; ++k) { pj[k] = tp_[k][j]; vj[k] = tv_[k][j]; }
+                        const VecD rij = pj - p;
+                        float d, invD;
+                        if (!inView<PR>(dot(rij, rij), viewRadius, d, invD)) continue;
+                        if constexpr (B::flockStats) { f.vSum += vj; f.pSum += pj; ++f.cnt; }
+                        B::pair(f, Neighbor<D>{ rij, pj, vj, d, invD, viewRadius, true, 0.f }, P_);
+                    }
+                }
+                VecD u{};
+                if constexpr (B::random) u = noise(id_[i]);
+                ForceAcc<D> g = f;
+                B::self(g, SelfState<D>{ p, v, world_, u, nullptr }, P_);
+                VecD a = (B::total(g) - v * P_.D) * (1.0f / P_.M);
+                clip<PR>(a, P_.Amax);
+                v += a * dt;
+                clip<PR>(v, P_.Vmax);
+                p += v * dt;
+                for (int k = 0; k < D; ++k) {
+                    const float off = std::min(std::max(p[k], radius_), world_[k] - radius_) - o[k];
+                    out |= (off < lo) | (off >= hi);
+                    q2_[k][i] = quantize(off);
+                    h2_[k][i] = halfFromFloat(v[k]);
+                }
+            }
+        });
+        for (int k = 0; k < D; ++k) { q_[k].swap(q2_[k]); h_[k].swap(h2_[k]); }
+        dirty_ = out;
+    }
+
+private:
+    VecD  world_;
+    float C_, radius_;
+    SpeciesParams P_;
+    float toQ_, fromQ_;              // オフセット ↔ 量子の換算（除算をループから出す）
+    int   n_[D];
+    int   cells_;
+    std::vector<int16_t>  q_[D];     // セル原点からのオフセット（C/32768 刻み，+C/2 中心）
+    std::vector<uint16_t> h_[D];     // 速度（binary16）
+    std::vector<uint32_t> id_;
+    std::vector<int16_t>  q2_[D];    // rebin の書き込み先（入れ替えて使う）
+    std::vector<uint16_t> h2_[D];
+    std::vector<uint32_t> id2_;
+    std::vector<int>      start_;    // セル c の個体は [start_[c], start_[c+1])
+    std::vector<int>      cellOf_, oldCell_, fill_;
+    bool dirty_{false};
+    int  rebins_{0};
+    static constexpr int kBlock = 64;
+    alignas(16) float bp_[D][kBlock], bv_[D][kBlock];   // step の作業列（位置はオフセット）
+    std::vector<float>    tp_[D], tv_[D];   // flockStep のタイル（周囲のセルの位置・速度を float で）
+    int tn_{0};
+
+    int16_t quantize(float off) const {
+        const float s = std::min(std::max((off - 0.5f * C_) * toQ_, -32768.f), 32767.f);
+#if BOIDS_VEC_SSE
+        return (int16_t)_mm_cvt_ss2si(_mm_set_ss(s));    // 最近接丸め（lrint は -O2 だと関数呼び出し）
+#else
+        return (int16_t)std::lrint(s);
+#endif
+    }
+    float dequantize(int16_t q, float o) const { return o + 0.5f * C_ + q * fromQ_; }
+    void quantizeN(const float* off, int16_t* q, int n) const {
+        int i = 0;
+#if BOIDS_VEC_SSE
+        const __m128 half = _mm_set1_ps(0.5f * C_), s = _mm_set1_ps(toQ_);
+        const __m128 qlo = _mm_set1_ps(-32768.f), qhi = _mm_set1_ps(32767.f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(off + i), half), s);
+            x = _mm_min_ps(_mm_max_ps(x, qlo), qhi);
+            const __m128i r = _mm_cvtps_epi32(x);
+            _mm_storel_epi64((__m128i*)(q + i), _mm_packs_epi32(r, r));
+        }
+#endif
+        for (; i < n; ++i) q[i] = quantize(off[i]);
+    }
+    void dequantizeN(const int16_t* q, float* p, int n, float o) const {
+        int i = 0;
+#if BOIDS_VEC_SSE
+        const __m128 base = _mm_set1_ps(o + 0.5f * C_), s = _mm_set1_ps(fromQ_);
+        for (; i + 4 <= n; i += 4) {
+            const __m128i x = _mm_loadl_epi64((const __m128i*)(q + i));
+            const __m128i w = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            _mm_storeu_ps(p + i, _mm_add_ps(base, _mm_mul_ps(_mm_cvtepi32_ps(w), s)));
+        }
+#endif
+        for (; i < n; ++i) p[i] = dequantize(q[i], o);
+    }
+    VecD position(int i, const VecD& o) const {
+        VecD p;
+        for (int k = 0; k < D; ++k) p[k] = dequantize(q_[k][i], o[k]);
+        return p;
+    }
+    VecD velocity(int i) const {
+        VecD v;
+        for (int k = 0; k < D; ++k) v[k] = floatFromHalf(h_[k][i]);
+        return v;
+    }
+    VecD wall(const VecD& p) const {
+        const float margin = 10.f;
+        VecD f{};
+        for (int k = 0; k < D; ++k) {
+            if (p[k] < margin)              f[k] += P_.k_wall * (margin - p[k]);
+            if (p[k] > world_[k] - margin)  f[k] -= P_.k_wall * (p[k] - (world_[k] - margin));
+        }
+        return f;
+    }
+    template<Precision PR = BOIDS_PRECISION>
+    static void clip(VecD& x, float m) {
+        const float n = norm<PR>(x);
+        if (n > m) x = x * (m / (n + 1e-6f));
+    }
+    // Agent::inView と同じ（r2 が視野内なら距離とその逆数）
+    template<Precision PR>
+    static bool inView(float r2, float vr, float& d, float& invD) {
+        if constexpr (PR == Precision::Exact) {
+            d = std::sqrt(r2);
+            if (d >= vr) return false;
+            invD = 1.0f / d;
+        } else {
+            if (r2 >= vr * vr) return false;
+            invD = (r2 > 0.f) ? rsqrt<PR>(r2) : 0.f;
+            d = r2 * invD;
+        }
+        return true;
+    }
+
+    // セル c のまわり (2r+1)^D セルの個体を tp_/tv_ に広げる（個体数は tn_）．
+    // 返り値はセル c 自身の個体がタイルのどこから始まるか
+    int tile(int c, int r) {
+        int cc[D], off[D];
+        for (int k = 0, x = c; k < D; ++k) { cc[k] = x % n_[k]; x /= n_[k]; off[k] = -r; }
+        int base = 0;
+        tn_ = 0;
+        for (;;) {
+            bool inside = true;
+            int  nc = 0;
+            for (int k = D-1; k >= 0; --k) {
+                const int x = cc[k] + off[k];
+                inside &= (x >= 0) & (x < n_[k]);
+                nc = nc * n_[k] + x;
+            }
+            if (inside && start_[nc] != start_[nc+1]) {
+                const int b = start_[nc], m = start_[nc+1] - b;
+                if (nc == c) base = tn_;
+                const VecD o = originOf(nc);
+                for (int k = 0; k < D; ++k) {
+                    if ((int)tp_[k].size() < tn_ + m) { tp_[k].resize(2 * (tn_ + m)); tv_[k].resize(2 * (tn_ + m)); }
+                    dequantizeN(q_[k].data() + b, tp_[k].data() + tn_, m, o[k]);
+                    floatFromHalfN(h_[k].data() + b, tv_[k].data() + tn_, m);
+                }
+                tn_ += m;
+            }
+            int k = 0;
+            while (k < D && ++off[k] > r) { off[k] = -r; ++k; }
+            if (k == D) break;
+        }
+        return base;
+    }
+
+    // セルごとに原点を渡して回す（セル番号は x が最速）
+    template<class F>
+    void forEachCell(F&& f) const {
+        int cc[D] = {};
+        for (int c = 0; c < cells_; ++c) {
+            if (start_[c] != start_[c+1]) {
+                VecD o;
+                for (int k = 0; k < D; ++k) o[k] = cc[k] * C_;
+                f(c, o);
+            }
+            for (int k = 0; k < D && ++cc[k] == n_[k]; ++k) cc[k] = 0;
+        }
+    }
+    int cellOf(const VecD& p) const {
+        int c = 0;
+        for (int k = D-1; k >= 0; --k)
+            c = c * n_[k] + std::clamp((int)(p[k] / C_), 0, n_[k] - 1);
+        return c;
+    }
+    VecD originOf(int c) const {
+        VecD o;
+        for (int k = 0; k < D; ++k) { o[k] = (c % n_[k]) * C_; c /= n_[k]; }
+        return o;
+    }
+
+    // セルからはみ出した個体を本来のセルへ（詰めた状態のまま安定な計数ソート）
+    void rebin() {
+        forEachCell([&](int c, const VecD&){
+            for (int i = start_[c]; i < start_[c+1]; ++i) oldCell_[i] = c;
+        });
+        bin(size(), [&](int i){ return position(i, originOf(oldCell_[i])); },
+                    [&](int i, int k){ return h_[k][i]; },
+                    [&](int i){ return id_[i]; });
+        ++rebins_;
+        dirty_ = false;
+    }
+
+    // pos(i), vel(i, k)（binary16），id(i) の n 体をセル順に q2_/h2_/id2_ へ詰めて入れ替える
+    template<class PosFn, class VelFn, class IdFn>
+    void bin(int n, PosFn&& pos, VelFn&& vel, IdFn&& id) {
+        std::fill(start_.begin(), start_.end(), 0);
+        for (int i = 0; i < n; ++i) { cellOf_[i] = cellOf(pos(i)); ++start_[cellOf_[i] + 1]; }
+        for (int c = 0; c < cells_; ++c) start_[c + 1] += start_[c];
+        fill_.assign(start_.begin(), start_.end() - 1);
+        for (int i = 0; i < n; ++i) {
+            const int  j = fill_[cellOf_[i]]++;
+            const VecD p = pos(i), o = originOf(cellOf_[i]);
+            for (int k = 0; k < D; ++k) {
+                q2_[k][j] = quantize(p[k] - o[k]);
+                h2_[k][j] = vel(i, k);
+            }
+            id2_[j] = id(i);
+        }
+        for (int k = 0; k < D; ++k) { q_[k].swap(q2_[k]); h_[k].swap(h2_[k]); }
+        id_.swap(id2_);
+    }
+};
+
+#endif // __BOIDS_COMPACT_HPP__
@@ -0,0 +1,167 @@
+// ------------------------------------------------------------
+// ContactSolver：剛体球の非重なり拘束 |p_i - p_j| >= r_i + r_j
+//   積分後の位置に対し，位置ベースの Jacobi 反復で重なりを押し戻す．
+//     1. 接触候補（距離 < r_i + r_j + margin）を格子で集めて CSR に
+//     2. 各反復で i ごとに旧位置だけを読んで補正量を合計 → 新位置へ
+//        （相手との重なりの半分ずつ，接触数で平均して relax 倍）
+//   i の補正は i 自身の近傍順で足すだけなので，スレッド数に依らず
+//   結果はビット単位で一致する．2D/3D 共通（BasicContactSolver<D>）．
+// ------------------------------------------------------------
+#ifndef __BOIDS_CONTACT_HPP__
+#define __BOIDS_CONTACT_HPP__
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include "vec.hpp"
+#include "grid.hpp"
+#include "parallel.hpp"
+
+template<int D>
+class BasicContactSolver {
+public:
+    using VecD = Vec<D>;
+
+    struct Result {
+        int   iterations{0};   // 実際に回した反復回数
+        int   contacts{0};     // 重なっているペア数（反復後）
+        float maxOverlap{0};   // 最大の重なり [px]
+        float sumOverlap{0};   // 重なりの総和 [px]
+    };
+
+    bool  enabled    = false;
+    int   iterations = 8;      // 反復回数の上限
+    float relax      = 1.0f;   // Jacobi の緩和係数
+    float tolerance  = 1e-3f;  // 最大重なりがこれ未満なら打ち切り
+
+    const Result& last() const { return last_; }
+
+    // n 個体・1 個体あたり接触候補 perAgent 件までは solve() で再確保しない
+    void reserve(int n, int perAgent = 16) {
+        start_.reserve(n + 1); pairs_.reserve((size_t)n * perAgent);
+        cnt_.reserve(n); q_.reserve(n); over_.reserve(n); maxOf_.reserve(n);
+    }
+
+    // p, r: 位置と半径（p を書き換える）．各軸 [r, world-r] にも収める
+    Result solve(std::vector<VecD>& p, const std::vector<float>& r,
+                 const VecD& world, ThreadPool& pool)
+    {
+        const int n = (int)p.size();
+        last_ = {};
+        if (n == 0) return last_;
+
+        float rmax = 0.f;
+        for (float ri : r) rmax = std::max(rmax, ri);
+        const float margin = 0.5f * rmax;
+        if (!grid_ || grid_->cellSize() != 2.f*rmax + margin) {
+            grid_ = std::make_unique<BasicGrid<D>>(world, 2.f*rmax + margin);
+        }
+        grid_->build(n, [&](int i){ return p[i]; });
+
+        // --- 1. 接触候補（件数 → 前置和 → 書き込み） ---
+        start_.assign(n + 1, 0);
+        pool.parallelFor(n, [&](int b, int e){
+            for (int i = b; i < e; ++i)
+                start_[i+1] = gather(i, p, r, margin, nullptr);
+        });
+        for (int i = 0; i < n; ++i) start_[i+1] += start_[i];
+        pairs_.resize(start_[n]);
+        pool.parallelFor(n, [&](int b, int e){
+            for (int i = b; i < e; ++i) gather(i, p, r, margin, pairs_.data() + start_[i]);
+        });
+
+        // --- 2. Jacobi 反復 ---
+        q_.resize(n);
+        over_.resize(n);
+        for (int it = 0; it < iterations; ++it) {
+            pool.parallelFor(n, [&](int b, int e){
+                for (int i = b; i < e; ++i) q_[i] = relaxOne(i, p, r, world);
+            });
+            p.swap(q_);
+            ++last_.iterations;
+            if (measure(p, r, pool) < tolerance) break;
+        }
+        if (last_.iterations == 0) measure(p, r, pool);
+
+        // 総和は i 順の直列和（スレッド数で丸めが変わらないように）
+        for (int i = 0; i < n; ++i) {
+            last_.sumOverlap += over_[i];
+            last_.contacts   += cnt_[i];
+        }
+        return last_;
+    }
+
+private:
+    std::unique_ptr<BasicGrid<D>> grid_;
+    std::vector<int>   start_, pairs_, cnt_;
+    std::vector<VecD>  q_;
+    std::vector<float> over_, maxOf_;
+    Result last_;
+
+    int gather(int i, const std::vector<VecD>& p, const std::vector<float>& r,
+               float margin, int* out) const
+    {
+        int k = 0;
+        grid_->query(p[i], grid_->cellSize(), [&](int j){
+            if (j == i) return;
+            const VecD  d  = p[j] - p[i];
+            const float rr = r[i] + r[j] + margin;
+            if (dot(d, d) < rr*rr) { if (out) out[k] = j; ++k; }
+        });
+        return k;
+    }
+
+    VecD relaxOne(int i, const std::vector<VecD>& p, const std::vector<float>& r,
+                  const VecD& world) const
+    {
+        VecD corr{};
+        int  hit = 0;
+        for (int k = start_[i]; k < start_[i+1]; ++k) {
+            const int   j  = pairs_[k];
+            const VecD  d  = p[i] - p[j];
+            const float dn = norm(d);
+            const float ov = r[i] + r[j] - dn;
+            if (ov <= 0.f) continue;
+            // 完全一致は番号で向きを決める（対称に押し分ける）
+            VecD nrm{};
+            if (dn > 1e-6f) nrm = d * (1.0f/dn);
+            else            nrm[0] = (i < j) ? -1.f : 1.f;
+            corr += nrm * (0.5f * ov);
+            ++hit;
+        }
+        VecD q = p[i];
+        if (hit > 0) q += corr * (relax / hit);
+        for (int k = 0; k < D; ++k) q[k] = std::clamp(q[k], r[i], world[k] - r[i]);
+        return q;
+    }
+
+    // 各 i の重なり和と最大値（最大値は順序に依らない）
+    float measure(const std::vector<VecD>& p, const std::vector<float>& r, ThreadPool& pool)
+    {
+        const int n = (int)p.size();
+        cnt_.resize(n);
+        maxOf_.resize(n);
+        pool.parallelFor(n, [&](int b, int e){
+            for (int i = b; i < e; ++i) {
+                float s = 0.f, m = 0.f; int c = 0;
+                for (int k = start_[i]; k < start_[i+1]; ++k) {
+                    const int j = pairs_[k];
+                    if (j < i) continue;                 // ペアは 1 回だけ数える
+                    const float ov = r[i] + r[j] - norm(p[i] - p[j]);
+                    if (ov > 0.f) { s += ov; m = std::max(m, ov); ++c; }
+                }
+                over_[i] = s; maxOf_[i] = m; cnt_[i] = c;
+            }
+        });
+        float m = 0.f;
+        for (int i = 0; i < n; ++i) m = std::max(m, maxOf_[i]);
+        last_.maxOverlap = m;
+        return m;
+    }
+};
+
+using ContactSolver  = BasicContactSolver<2>;
+using ContactSolver3 = BasicContactSolver<3>;
+
+#endif // __BOIDS_CONTACT_HPP__
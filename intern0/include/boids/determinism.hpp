@@ -0,0 +1,96 @@
+// ------------------------------------------------------------
+// Deterministic：スレッド数・実行ごとに依らずビット単位で同じ結果にするモード
+//   並列化して結果が変わる原因は 2 つ
+//     1. 乱数   std::rand を複数スレッドから引くと，どの個体が何番目を引くかが毎回変わる
+//     2. 総和   スレッドごとの部分和を足す区間・順序がスレッド数で変わり，丸めが変わる
+//   enabled のときは
+//     1. 乱数を (seed, 個体の系列, ティック, 何個目) のハッシュから作る（カウンタ型，状態なし）
+//     2. 総和を n だけで決まる固定の block 個ずつに切り，ブロック内は順に，
+//        ブロックの部分和は決まった形の二分木で足す（Reduction）
+//   個体ごとの近傍和は自分の近傍リストの順に足すだけなので，もともと分け方に依らない
+//
+// RandomDraw：1 体・1 ティックぶんの一様乱数 [0, 1] の引き口
+//   det が nullptr なら従来どおり std::rand（1 スレッドなら従来の軌道とビット単位で一致）
+// ------------------------------------------------------------
+#ifndef __BOIDS_DETERMINISM_HPP__
+#define __BOIDS_DETERMINISM_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include "parallel.hpp"
+
+struct Deterministic {
+    bool     enabled = false;
+    uint64_t seed    = 0x2545f4914f6cdd1dull;
+    int      block   = 1024;          // 総和のブロックの大きさ（スレッド数とは無関係に固定）
+
+    // splitmix64 の仕上げ（全ビットを混ぜる）
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27; x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+    // 系列 stream のティック tick の k 個目（24 bit の一様乱数を [0, 1) へ）
+    float uniform(uint64_t stream, uint32_t tick, uint32_t k) const {
+        const uint64_t h = mix(seed ^ mix(stream * 0x9e3779b97f4a7c15ull + (((uint64_t)tick << 16) | k)));
+        return (float)(h >> 40) * (1.0f / 16777216.f);
+    }
+};
+
+struct RandomDraw {
+    const Deterministic* det = nullptr;
+    uint64_t stream = 0;
+    uint32_t tick   = 0;
+    uint32_t k      = 0;
+    float operator()() {
+        if (det) return det->uniform(stream, tick, k++);
+        return (float)std::rand() / RAND_MAX;
+    }
+};
+
+// Σ term(i)（i = 0..n-1）を pool で．T は + と値初期化（ゼロ）ができる型
+//   fixed = false  スレッド数ぶんの連続区間の部分和を t 順に（スレッド数で丸めが変わる）
+//   fixed = true   block ずつの部分和を二分木で（スレッド数に依らない）
+//   部分和の置き場は使い回すので，ブロック数が増えない限り確保しない
+template<class T>
+class Reduction {
+public:
+    template<class Term>
+    T run(ThreadPool& pool, int n, bool fixed, int block, Term&& term) {
+        if (n <= 0) return T{};
+        if (!fixed) {
+            const int P = std::min(pool.size(), n);
+            part_.assign(P, T{});
+            pool.forEachThread(P, [&](int t){
+                const int b = (int)((long long)n * t / P), e = (int)((long long)n * (t+1) / P);
+                T s{};
+                for (int i = b; i < e; ++i) s = s + term(i);
+                part_[t] = s;
+            });
+            T s = part_[0];
+            for (int t = 1; t < P; ++t) s = s + part_[t];
+            return s;
+        }
+        block = std::max(1, block);
+        const int B = (n + block - 1) / block;
+        part_.assign(B, T{});
+        pool.parallelFor(B, [&](int bb, int be){
+            for (int k = bb; k < be; ++k) {
+                T s{};
+                for (int i = k * block, e = std::min(n, (k+1) * block); i < e; ++i) s = s + term(i);
+                part_[k] = s;
+            }
+        });
+        for (int w = 1; w < B; w *= 2)                  // 隣どうし → 4 つおき → … の決まった木
+            for (int k = 0; k + w < B; k += 2 * w) part_[k] = part_[k] + part_[k + w];
+        return part_[0];
+    }
+
+private:
+    std::vector<T> part_;
+};
+
+#endif // __BOIDS_DETERMINISM_HPP__
@@ -0,0 +1,656 @@
+// ------------------------------------------------------------
+// 領域分割（複数プロセス）の通信まわりと，短冊 1 本ぶんの World（BasicDomainWorld，末尾）
+//   ワールドを x 方向の短冊に分け，rank r が [x0, x1) を持つ（Strip）．
+//   やりとりは隣（r-1, r+1）とだけなので，トランスポートは隣とのメッセージ送受信だけを持つ
+//     send(peer, data, n)   長さつきで 1 通送る（届くまで待つことがある）
+//     recv(peer, buf)       1 通受け取って buf に入れる
+//     good()                つながっているか（作成・送受信に失敗したら false）
+//   ShmTransport  同じノード内：POSIX 共有メモリ上の向きごとの SPSC リングバッファ．
+//                 rank 0 が毎回作り直し，待ちは期限と相手の pid の生存確認つき
+//   TcpTransport  ノード間：rank r は basePort + r で待ち受け，左隣へ接続する
+//
+//   exchange() は隣どうしの交換を (0-1, 2-3, …) → (1-2, 3-4, …) の 2 段で行い，
+//   組の中では小さい rank が先に送る．どの段も送りと受けが対になるので詰まらない
+//
+//   Rebalancer は短冊の境界を計測したコストで動かす（period ティックごとに 1 回）．
+//     回ごとに偶数境界（0|1, 2|3, …）と奇数境界（1|2, 3|4, …）を交互に動かすので，
+//     ある短冊で同時に動く境界は 1 本だけ．境界の両側は同じ材料
+//       [コスト, 向こう端, 1 回に渡せる数, 個体数, 境界に近い順の x …]
+//     を交換し，decide() で同じ新境界を計算する（相談の往復なし）．
+//     重い側から渡すのは (コストの差 / 2) に見合う数まで，かつ両側の予算の小さいほうまで．
+//     予算は budgetMs ÷ 実測の 1 体あたりの移住コストなので，移住で 1 ティックが
+//     budgetMs 以上延びない．短冊は minWidth（視野半径）より細くしない（ハローが隣で足りるように）
+// ------------------------------------------------------------
+#ifndef __BOIDS_DOMAIN_HPP__
+#define __BOIDS_DOMAIN_HPP__
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <iterator>
+#include <span>
+#include <ctime>
+#include <cmath>
+#include "vec.hpp"
+#include "grid.hpp"
+#include "species.hpp"
+#include "flowfield.hpp"
+#include "integrator.hpp"
+#include "determinism.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+// rank の担当範囲（x 方向の短冊）
+struct Strip {
+    int   rank = 0, size = 1;
+    float x0 = 0, x1 = 0;
+    Strip() = default;
+    Strip(int r, int n, float width) : rank(r), size(n), x0(width * r / n), x1(width * (r + 1) / n) {
+        if (r == n - 1) x1 = width;
+    }
+    bool hasLeft()  const { return rank > 0; }
+    bool hasRight() const { return rank < size - 1; }
+    bool owns(float x) const { return (x >= x0 || !hasLeft()) && (x < x1 || !hasRight()); }
+};
+
+#ifdef __linux__
+
+class ShmTransport {
+public:
+    static constexpr const char* name = "shm";
+    static constexpr size_t kCap = size_t(1) << 22;     // リング 1 本の容量
+
+    // 同じ name を開いた size 個のプロセスでつながる．rank 0 が前の回の残り（落ちた回の
+    // 共有メモリ）を shm_unlink してから作り直し，ヘッダに作り手の pid と kMagic を書く．
+    // ほかの rank は作り手が生きている版が現れるまで開き直して待ち，加わったら joined を進める．
+    // 作成・参加も送受信の待ちも timeoutSec 秒で諦め，相手のプロセスが消えたらすぐ諦める（good() = false）
+    ShmTransport(const char* shmName, int rank, int size, double timeoutSec = 20.0)
+        : rank_(rank), size_(size), name_(shmName), timeout_(timeoutSec)
+    {
+        ringsAt_ = (sizeof(Header) + sizeof(std::atomic<int32_t>) * std::max(1, size) + 63) / 64 * 64;
+        bytes_ = ringsAt_ + sizeof(Ring) * 2 * std::max(1, size);
+        const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSec);
+        if (rank == 0) {
+            shm_unlink(shmName);
+            const int fd = shm_open(shmName, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) { std::perror("shm_open"); return; }
+            if (ftruncate(fd, (off_t)bytes_) != 0) { std::perror("ftruncate"); close(fd); return; }
+            if (!map(fd)) return;                        // ftruncate したばかりなので中身は 0
+            pid(0).store((int32_t)getpid(), std::memory_order_relaxed);
+            header().magic.store(kMagic, std::memory_order_release);
+            while (header().joined.load(std::memory_order_acquire) < (uint32_t)size - 1) {
+                if (std::chrono::steady_clock::now() > until) {
+                    std::fprintf(stderr, "shm: only %u of %d ranks joined %s\n",
+                                 header().joined.load() + 1, size, shmName);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        } else {
+            for (;;) {
+                const int fd = shm_open(shmName, O_RDWR, 0600);
+                struct stat st{};
+                if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size == bytes_ && map(fd)) {
+                    if (header().magic.load(std::memory_order_acquire) == kMagic && alive(pid(0).load())) break;
+                    munmap(base_, bytes_);                // rank 0 がまだ作っていないか，前の回の残り
+                    base_ = nullptr;
+                } else if (fd >= 0) {
+                    close(fd);
+                }
+                if (std::chrono::steady_clock::now() > until) {
+                    std::fprintf(stderr, "shm: rank 0 never created %s\n", shmName);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            pid(rank).store((int32_t)getpid(), std::memory_order_relaxed);
+            header().joined.fetch_add(1, std::memory_order_acq_rel);
+        }
+        ok_ = true;
+    }
+    ~ShmTransport() {
+        if (base_) munmap(base_, bytes_);
+        if (rank_ == 0) shm_unlink(name_.c_str());
+    }
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    bool good() const { return ok_; }
+
+    bool send(int peer, const void* data, size_t n) {
+        Ring& r = ring(rank_, peer);
+        const uint64_t len = n;
+        ok_ = ok_ && put(r, peer, &len, sizeof(len)) && put(r, peer, data, n);
+        return ok_;
+    }
+    bool recv(int peer, std::vector<unsigned char>& buf) {
+        Ring& r = ring(peer, rank_);
+        uint64_t len = 0;
+        ok_ = ok_ && get(r, peer, &len, sizeof(len));
+        if (!ok_) return false;
+        buf.resize(len);
+        ok_ = get(r, peer, buf.data(), len);
+        return ok_;
+    }
+
+private:
+    static constexpr uint64_t kMagic = 0x626f6964732d3031ull;   // "boids-01"
+
+    struct Header {
+        std::atomic<uint64_t> magic;                   // rank 0 が作り終えたら kMagic
+        std::atomic<uint32_t> joined;                  // 加わった rank 1.. の数
+    };
+    struct Ring {
+        alignas(64) std::atomic<uint64_t> head;        // 書いた総バイト数（送り手だけが進める）
+        alignas(64) std::atomic<uint64_t> tail;        // 読んだ総バイト数（受け手だけが進める）
+        alignas(64) unsigned char buf[kCap];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory rings need lock-free 64-bit atomics");
+
+    // [Header][rank ごとの pid][リング 2*size 本]
+    unsigned char* base_{nullptr};
+    size_t bytes_{0}, ringsAt_{0};
+    int    rank_, size_;
+    std::string name_;
+    double timeout_;
+    bool   ok_{false};
+
+    bool map(int fd) {
+        void* p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { std::perror("mmap"); return false; }
+        base_ = static_cast<unsigned char*>(p);
+        return true;
+    }
+    Header& header() { return *reinterpret_cast<Header*>(base_); }
+    std::atomic<int32_t>& pid(int r) { return reinterpret_cast<std::atomic<int32_t>*>(base_ + sizeof(Header))[r]; }
+    static bool alive(int32_t p) { return p > 0 && (kill(p, 0) == 0 || errno != ESRCH); }
+
+    // 向き src → dst のリング（隣どうしだけ）：右向きは 2*src，左向きは 2*dst+1
+    Ring& ring(int src, int dst) {
+        Ring* rings = reinterpret_cast<Ring*>(base_ + ringsAt_);
+        return rings[dst > src ? 2 * src : 2 * dst + 1];
+    }
+
+    // 進めないときの待ち：時々（1024 回に 1 回）期限と相手の生存を見る
+    bool wait(int peer, unsigned& spins, std::chrono::steady_clock::time_point& since) {
+        std::this_thread::yield();
+        if ((++spins & 1023) != 0) return true;
+        if (spins == 1024) since = std::chrono::steady_clock::now();
+        const int32_t p = pid(peer).load(std::memory_order_relaxed);
+        if (!alive(p)) {
+            std::fprintf(stderr, "shm: rank %d (pid %d) is gone\n", peer, (int)p);
+            return false;
+        }
+        if (std::chrono::steady_clock::now() - since > std::chrono::duration<double>(timeout_)) {
+            std::fprintf(stderr, "shm: no progress from rank %d for %.0f s\n", peer, timeout_);
+            return false;
+        }
+        return true;
+    }
+    bool put(Ring& r, int peer, const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        unsigned spins = 0;
+        std::chrono::steady_clock::time_point since;
+        while (n > 0) {
+            const uint64_t h = r.head.load(std::memory_order_relaxed);
+            const uint64_t t = r.tail.load(std::memory_order_acquire);
+            const size_t room = kCap - (size_t)(h - t);
+            if (room == 0) { if (!wait(peer, spins, since)) return false; continue; }
+            const size_t k = std::min({ n, room, kCap - (size_t)(h % kCap) });
+            std::memcpy(r.buf + h % kCap, p, k);
+            r.head.store(h + k, std::memory_order_release);
+            p += k; n -= k;
+            spins = 0;
+        }
+        return true;
+    }
+    bool get(Ring& r, int peer, void* data, size_t n) {
+        unsigned char* p = static_cast<unsigned char*>(data);
+        unsigned spins = 0;
+        std::chrono::steady_clock::time_point since;
+        while (n > 0) {
+            const uint64_t t = r.tail.load(std::memory_order_relaxed);
+            const uint64_t h = r.head.load(std::memory_order_acquire);
+            const size_t have = (size_t)(h - t);
+            if (have == 0) { if (!wait(peer, spins, since)) return false; continue; }
+            const size_t k = std::min({ n, have, kCap - (size_t)(t % kCap) });
+            std::memcpy(p, r.buf + t % kCap, k);
+            r.tail.store(t + k, std::memory_order_release);
+            p += k; n -= k;
+            spins = 0;
+        }
+        return true;
+    }
+};
+
+class TcpTransport {
+public:
+    static constexpr const char* name = "tcp";
+
+    // hosts[r] は rank r のホスト（足りなければ 127.0.0.1）．接続は最大 timeoutSec 秒待つ
+    TcpTransport(int rank, int size, int basePort, const std::vector<std::string>& hosts = {},
+                 double timeoutSec = 20.0)
+        : rank_(rank)
+    {
+        int lfd = -1;
+        if (rank < size - 1) {                          // 右隣からの接続を待ち受ける
+            lfd = socket(AF_INET, SOCK_STREAM, 0);
+            const int one = 1;
+            setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in a{};
+            a.sin_family = AF_INET;
+            a.sin_addr.s_addr = htonl(INADDR_ANY);
+            a.sin_port = htons((uint16_t)(basePort + rank));
+            if (bind(lfd, (sockaddr*)&a, sizeof(a)) != 0 || listen(lfd, 1) != 0) {
+                std::perror("tcp listen");
+                close(lfd);
+                return;
+            }
+        }
+        if (rank > 0) {                                 // 左隣へ（立ち上がるまで再試行）
+            const std::string host = (int)hosts.size() > rank - 1 ? hosts[rank - 1] : "127.0.0.1";
+            left_ = connectTo(host, basePort + rank - 1, timeoutSec);
+            if (left_ < 0) { std::fprintf(stderr, "tcp: cannot reach rank %d at %s\n", rank - 1, host.c_str()); if (lfd >= 0) close(lfd); return; }
+        }
+        if (lfd >= 0) {
+            right_ = accept(lfd, nullptr, nullptr);
+            close(lfd);
+            if (right_ < 0) { std::perror("tcp accept"); return; }
+            noDelay(right_);
+        }
+        ok_ = true;
+    }
+    ~TcpTransport() {
+        if (left_  >= 0) close(left_);
+        if (right_ >= 0) close(right_);
+    }
+    TcpTransport(const TcpTransport&) = delete;
+    TcpTransport& operator=(const TcpTransport&) = delete;
+
+    bool good() const { return ok_; }
+
+    bool send(int peer, const void* data, size_t n) {
+        const int fd = peer < rank_ ? left_ : right_;
+        const uint64_t len = n;
+        ok_ = ok_ && writeAll(fd, &len, sizeof(len)) && writeAll(fd, data, n);
+        return ok_;
+    }
+    bool recv(int peer, std::vector<unsigned char>& buf) {
+        const int fd = peer < rank_ ? left_ : right_;
+        uint64_t len = 0;
+        ok_ = ok_ && readAll(fd, &len, sizeof(len));
+        if (!ok_) return false;
+        buf.resize(len);
+        ok_ = readAll(fd, buf.data(), len);
+        return ok_;
+    }
+
+private:
+    int  rank_;
+    int  left_{-1}, right_{-1};
+    bool ok_{false};
+
+    static void noDelay(int fd) { const int one = 1; setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); }
+
+    static int connectTo(const std::string& host, int port, double timeoutSec) {
+        addrinfo hints{}, *res = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0 || !res) return -1;
+        const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSec);
+        int fd = -1;
+        while (std::chrono::steady_clock::now() < until) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(fd, res->ai_addr, res->ai_addrlen) == 0) break;
+            close(fd);
+            fd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        freeaddrinfo(res);
+        if (fd >= 0) noDelay(fd);
+        return fd;
+    }
+    static bool writeAll(int fd, const void* data, size_t n) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0) {
+            const ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+            if (k <= 0) return false;
+            p += k; n -= (size_t)k;
+        }
+        return true;
+    }
+    static bool readAll(int fd, void* data, size_t n) {
+        char* p = static_cast<char*>(data);
+        while (n > 0) {
+            const ssize_t k = ::recv(fd, p, n, 0);
+            if (k <= 0) return false;
+            p += k; n -= (size_t)k;
+        }
+        return true;
+    }
+};
+
+#endif // __linux__
+
+class Rebalancer {
+public:
+    bool   enabled  = false;
+    int    period   = 10;          // 何ティックごとに境界を動かすか
+    double budgetMs = 0.5;         // 1 ティックの移住に使ってよい時間
+    float  tolerance = 0.1f;       // コストの差がこれ以下なら動かさない
+    bool   useWork  = false;       // コストを計測時間でなく仕事量（近傍対の数）で（再現性のため）
+    float  minWidth = 0;           // 短冊の最小幅（0 なら DomainWorld が視野半径に）
+
+    struct Stats { int rounds = 0, shifts = 0; };
+
+    bool due(uint32_t tick) const { return enabled && period > 0 && (int)(tick % (uint32_t)period) == period - 1; }
+    // この回に動かす境界 b|b+1 は b % 2 == round % 2 のもの
+    bool active(int leftRank) const { return (leftRank & 1) == (stats_.rounds & 1); }
+
+    // ティックごとの計算コスト（知覚 + 力）
+    void record(double sec, uint64_t work) { cost_ += useWork ? (double)work : sec; }
+    // 移住の 1 体あたりのコスト（送り手・受け手の手元の処理時間．指数移動平均）
+    void recordMigration(int moved, double sec) {
+        if (moved >= 8) perAgent_ = 0.8 * perAgent_ + 0.2 * (sec / moved);
+    }
+    int budget() const { return (int)std::clamp(budgetMs * 1e-3 / std::max(perAgent_, 1e-9), 1.0, 1e6); }
+
+    // 境界 b の自分の側の材料．xs は自分の個体の x（並べ替えに使うので壊す）．
+    // right = true なら境界は自分の右（大きい x から），false なら左（小さい x から）
+    void message(bool right, float farEdge, std::vector<float>& xs, std::vector<float>& out) const {
+        const int k = std::min((int)xs.size(), budget());
+        auto cmp = [&](float a, float b){ return right ? a > b : a < b; };
+        if (k < (int)xs.size()) std::nth_element(xs.begin(), xs.begin() + k, xs.end(), cmp);
+        std::sort(xs.begin(), xs.begin() + k, cmp);
+        out.assign({ (float)cost_, farEdge, (float)budget(), (float)xs.size() });
+        out.insert(out.end(), xs.begin(), xs.begin() + k);
+    }
+
+    // 左 L・右 R の材料から新しい境界（両側で同じ値になる）
+    float decide(const std::vector<float>& L, const std::vector<float>& R, float current) const {
+        if (L.size() < 4 || R.size() < 4) return current;
+        const float costL = L[0], costR = R[0];
+        const float lo = L[1] + minWidth, hi = R[1] - minWidth;
+        const int   budget = (int)std::min(L[2], R[2]);
+        float nb = current;
+        if (costL > costR * (1 + tolerance) && costL > 0) {            // 左の右端の個体を右へ
+            const int k = std::min({ budget, (int)(L[3] * (costL - costR) / (2 * costL)), (int)L.size() - 4 });
+            if (k > 0) nb = std::max(L[3 + k], lo);                    // x >= nb が右の持ち分
+            nb = std::min(nb, current);
+        } else if (costR > costL * (1 + tolerance) && costR > 0) {     // 右の左端の個体を左へ
+            const int k = std::min({ budget, (int)(R[3] * (costR - costL) / (2 * costR)), (int)R.size() - 4 });
+            if (k > 0) nb = std::min(std::nextafter(R[3 + k], HUGE_VALF), hi);
+            nb = std::max(nb, current);
+        }
+        return lo <= hi ? nb : current;
+    }
+    // 1 回ぶんを終える（コストを測り直す）
+    void finish(bool moved) { ++stats_.rounds; stats_.shifts += moved; cost_ = 0; }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    double cost_{0};
+    double perAgent_{2e-6};        // 初めは 1 体 2 µs と見積もる
+    Stats  stats_;
+};
+
+// 隣との交換：toLeft/toRight を送り，fromLeft/fromRight に受ける（T はトリビアルにコピーできる型）
+template<class Transport, class T>
+bool exchange(Transport& tr, const Strip& s,
+              const std::vector<T>& toLeft, const std::vector<T>& toRight,
+              std::vector<T>& fromLeft, std::vector<T>& fromRight,
+              std::vector<unsigned char>& scratch)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "exchange() sends raw bytes");
+    fromLeft.clear();
+    fromRight.clear();
+    auto unpack = [&](std::vector<T>& out) {
+        out.resize(scratch.size() / sizeof(T));
+        if (!out.empty()) std::memcpy(out.data(), scratch.data(), out.size() * sizeof(T));
+    };
+    bool ok = true;
+    for (int phase = 0; phase < 2; ++phase) {
+        // この段の相手：(rank - phase) が偶数なら右，奇数なら左
+        const bool right = ((s.rank - phase) & 1) == 0;
+        if (right ? !s.hasRight() : !s.hasLeft()) continue;
+        const int peer = right ? s.rank + 1 : s.rank - 1;
+        const std::vector<T>& out = right ? toRight : toLeft;
+        std::vector<T>&       in  = right ? fromRight : fromLeft;
+        if (s.rank < peer) {
+            ok &= tr.send(peer, out.data(), out.size() * sizeof(T));
+            ok &= tr.recv(peer, scratch);
+        } else {
+            ok &= tr.recv(peer, scratch);
+            ok &= tr.send(peer, out.data(), out.size() * sizeof(T));
+        }
+        unpack(in);
+    }
+    return ok;
+}
+
+// ------------------------------------------------------------
+// BasicDomainWorld：短冊 1 本ぶんの 2D World（複数プロセスの領域分割）
+//   Record は送受信する 1 体の記録（id, Record::of(id, 個体), agent() を持つ．kadai_2C の AgentRec）
+//   各ティック
+//     1. ハロー  境界から視野半径以内の自分の個体を隣へ送り，隣のものを受け取る
+//     2. 知覚    自分の個体 + ハローを ID 順に並べた配列で格子を作り，自分の個体だけ近傍を集める
+//     3. 力      自分の個体だけ進める（乱数は決定的モードと同じカウンタ型．系列 = ID）
+//     4. 移住    短冊を出た個体を隣へ渡す（1 ティックで隣より遠くへは行かない）
+//                rebalance() が有効なら，その前に計測したコストで境界を動かす（Rebalancer）
+//   配列を ID 順に保つので，近傍リストの順も 1 プロセスの World（ID = 生成順）と同じになり，
+//   決定的モード・SoA なし・接触なしの World とビット単位で一致する．
+//   遮蔽・接触・間引き・適応刻みは扱わない（接触の反復はハローの外まで伝わるため）
+// ------------------------------------------------------------
+template<class Transport, class Record, class Integrator = SemiImplicitEuler>
+class BasicDomainWorld {
+public:
+    using Rec   = Record;
+    using Agent = std::remove_cvref_t<decltype(std::declval<const Rec&>().agent())>;
+    struct Stats {
+        uint64_t halo = 0, migrated = 0;
+        double   commSec = 0, computeSec = 0;
+        int      migratedMax = 0;       // 1 ティックの移住数の最大
+        double   migrateSecMax = 0;     // 1 ティックの移住の手元の CPU 時間の最大（通信待ちを除く）
+    };
+
+    BasicDomainWorld(float W, float H, float flowCell, float viewRadius, const Strip& strip, Transport& tr)
+        : world_{W, H}, strip_(strip), tr_(tr), flow_(W, H, flowCell),
+          grid_(world_, viewRadius * 0.5f), halo_(viewRadius) { det_.enabled = true; rebal_.minWidth = viewRadius; }
+
+    SpeciesTable&  species() { return species_; }
+    Deterministic& deterministic() { return det_; }
+    Rebalancer&    rebalance() { return rebal_; }
+    const Strip&   strip() const { return strip_; }
+    const Stats&   stats() const { return stats_; }
+    int  population() const { return (int)own_.size(); }
+    bool good() const { return ok_; }
+
+    // 初期配置：ID の昇順に足す．担当外の x なら捨てる
+    void add(uint64_t id, const Agent& a) {
+        if (strip_.owns(a.pos().x)) { own_.push_back(a); ownId_.push_back(id); }
+    }
+    // 自分の個体を ID 順に
+    void records(std::vector<Rec>& out) const {
+        out.clear();
+        for (size_t k = 0; k < own_.size(); ++k) out.push_back(pack(ownId_[k], own_[k]));
+    }
+
+    void step(float dt) {
+        flow_.update();
+        // --- 1. ハロー ---
+        toL_.clear(); toR_.clear();
+        for (size_t k = 0; k < own_.size(); ++k) {
+            const float x = own_[k].pos().x;
+            if (strip_.hasLeft()  && x <  strip_.x0 + halo_) toL_.push_back(pack(ownId_[k], own_[k]));
+            if (strip_.hasRight() && x >= strip_.x1 - halo_) toR_.push_back(pack(ownId_[k], own_[k]));
+        }
+        communicate();
+        stats_.halo += fromL_.size() + fromR_.size();
+        // 自分 + ハローを ID 順に（左右のハローはそれぞれ ID 順で届く）
+        ghosts_.clear();
+        std::merge(fromL_.begin(), fromL_.end(), fromR_.begin(), fromR_.end(), std::back_inserter(ghosts_),
+                   [](const Rec& a, const Rec& b){ return a.id < b.id; });
+        all_.clear(); self_.clear();
+        for (size_t k = 0, g = 0; k < own_.size() || g < ghosts_.size(); ) {
+            if (g == ghosts_.size() || (k < own_.size() && ownId_[k] < ghosts_[g].id)) {
+                self_.push_back((int)all_.size());
+                all_.push_back(own_[k++]);
+            } else {
+                all_.push_back(unpack(ghosts_[g++]));
+            }
+        }
+        // --- 2. 知覚（World::perceive と同じ手順・同じ順） ---
+        const auto c0 = std::chrono::steady_clock::now();
+        const int n = (int)all_.size();
+        const int S = species_.count();
+        if (grid_.layers() != S) grid_.setLayers(S);
+        masks_.resize(S);
+        for (int s = 0; s < S; ++s) masks_[s] = species_.mask(s);
+        grid_.build(n, [&](int k){ return all_[k].pos(); }, [&](int k){ return all_[k].species(); });
+        nbrStart_.assign(1, 0);
+        nbrIdx_.clear();
+        for (int i : self_) {
+            const Vec2  p  = all_[i].pos();
+            const float vr = all_[i].viewRadius();
+            grid_.query(p, vr, masks_[all_[i].species()], [&](int j){
+                if (j == i) return;
+                const Vec2 r = all_[j].pos() - p;
+                if (dot(r, r) < vr*vr) nbrIdx_.push_back(j);
+            });
+            nbrStart_.push_back((int)nbrIdx_.size());
+        }
+        // --- 3. 自分の個体を進める ---
+        for (size_t k = 0; k < own_.size(); ++k) {
+            const std::span<const int> nb{ nbrIdx_.data() + nbrStart_[k], nbrIdx_.data() + nbrStart_[k+1] };
+            own_[k].template drive<Integrator>(dt, all_, nb, species_, world_, &flow_, 1,
+                                               RandomDraw{ &det_, ownId_[k], tick_ });
+        }
+        const double csec = std::chrono::duration<double>(std::chrono::steady_clock::now() - c0).count();
+        stats_.computeSec += csec;
+        rebal_.record(csec, nbrIdx_.size());
+        // --- 4. 移住 ---
+        if (rebal_.due(tick_)) rebalanceBoundaries();
+        // 移住の処理時間は CPU 時間で（同じコアを分け合う rank に横取りされた分を数えない）
+        double msec = 0;
+        std::clock_t m0 = std::clock();
+        toL_.clear(); toR_.clear();
+        size_t keep = 0;
+        for (size_t k = 0; k < own_.size(); ++k) {
+            const float x = own_[k].pos().x;
+            if      (strip_.hasLeft()  && x <  strip_.x0) toL_.push_back(pack(ownId_[k], own_[k]));
+            else if (strip_.hasRight() && x >= strip_.x1) toR_.push_back(pack(ownId_[k], own_[k]));
+            else { own_[keep] = own_[k]; ownId_[keep] = ownId_[k]; ++keep; }
+        }
+        own_.erase(own_.begin() + keep, own_.end());
+        ownId_.resize(keep);
+        const int sent = (int)(toL_.size() + toR_.size());
+        msec += (double)(std::clock() - m0) / CLOCKS_PER_SEC;
+        communicate();
+        m0 = std::clock();
+        const int moved = (int)(fromL_.size() + fromR_.size());
+        stats_.migrated += moved;
+        ghosts_.clear();
+        std::merge(fromL_.begin(), fromL_.end(), fromR_.begin(), fromR_.end(), std::back_inserter(ghosts_),
+                   [](const Rec& a, const Rec& b){ return a.id < b.id; });
+        if (!ghosts_.empty()) {                        // 来た個体を ID 順に差し込む
+            mergeOwn_.clear(); mergeId_.clear();
+            for (size_t k = 0, g = 0; k < own_.size() || g < ghosts_.size(); ) {
+                if (g == ghosts_.size() || (k < own_.size() && ownId_[k] < ghosts_[g].id)) {
+                    mergeOwn_.push_back(own_[k]); mergeId_.push_back(ownId_[k]); ++k;
+                } else {
+                    mergeOwn_.push_back(unpack(ghosts_[g])); mergeId_.push_back(ghosts_[g].id); ++g;
+                }
+            }
+            own_.swap(mergeOwn_);
+            ownId_.swap(mergeId_);
+        }
+        msec += (double)(std::clock() - m0) / CLOCKS_PER_SEC;
+        rebal_.recordMigration(sent + moved, msec);
+        stats_.migratedMax   = std::max(stats_.migratedMax, moved);
+        stats_.migrateSecMax = std::max(stats_.migrateSecMax, msec);
+        ++tick_;
+    }
+
+private:
+    Vec2          world_;
+    Strip         strip_;
+    Transport&    tr_;
+    FlowField     flow_;
+    SpatialGrid   grid_;
+    SpeciesTable  species_;
+    Deterministic det_;
+    Rebalancer    rebal_;
+    float         halo_;
+    bool          ok_{true};
+    uint32_t      tick_{0};
+    Stats         stats_;
+
+    std::vector<Agent>    own_, all_, mergeOwn_;
+    std::vector<uint64_t> ownId_, mergeId_;
+    std::vector<int>      self_;                  // all_ の中の自分の個体（own_ と同じ順）
+    std::vector<Rec>      toL_, toR_, fromL_, fromR_, ghosts_;
+    std::vector<unsigned char> wire_;
+    std::vector<float>    loadL_, loadR_, inL_, inR_, xs_;   // 境界を動かす材料
+    std::vector<int>      nbrStart_, nbrIdx_;
+    std::vector<uint32_t> masks_;
+
+    // この回に動かす境界（自分の左右のどちらか 1 本）の両側で材料を交換し，同じ新境界に動かす
+    void rebalanceBoundaries() {
+        const bool left  = strip_.hasLeft()  && rebal_.active(strip_.rank - 1);
+        const bool right = strip_.hasRight() && rebal_.active(strip_.rank);
+        loadL_.clear(); loadR_.clear();
+        if (left || right) {
+            xs_.clear();
+            for (const Agent& a : own_) xs_.push_back(a.pos().x);
+            if (left)  rebal_.message(false, strip_.x1, xs_, loadL_);
+            if (right) rebal_.message(true,  strip_.x0, xs_, loadR_);
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        ok_ &= exchange(tr_, strip_, loadL_, loadR_, inL_, inR_, wire_);
+        stats_.commSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        bool moved = false;
+        if (left) {
+            const float b = rebal_.decide(inL_, loadL_, strip_.x0);
+            moved = b != strip_.x0;
+            strip_.x0 = b;
+        }
+        if (right) {
+            const float b = rebal_.decide(loadR_, inR_, strip_.x1);
+            moved = b != strip_.x1;
+            strip_.x1 = b;
+        }
+        rebal_.finish(moved);
+    }
+
+    void communicate() {
+        const auto t0 = std::chrono::steady_clock::now();
+        ok_ &= exchange(tr_, strip_, toL_, toR_, fromL_, fromR_, wire_);
+        stats_.commSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    static Rec   pack(uint64_t id, const Agent& a) { return Rec::of(id, a); }
+    static Agent unpack(const Rec& r) { return r.agent(); }
+};
+
+#endif // __BOIDS_DOMAIN_HPP__
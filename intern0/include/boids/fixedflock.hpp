@@ -0,0 +1,133 @@
+// ------------------------------------------------------------
+// FixedFlock<N>：小さな群れ（N ≤ 64 程度）専用の固定容量版
+//   状態は std::array（ヒープ確保なし），近傍は格子を使わず全対を見る．
+//   相手のループは N がコンパイル時定数なので完全に展開する．
+//   スナップショットのコピーはせず，状態を 2 面持って 1 ティックごとに入れ替える．
+//   力の項・積分器は World と同じ Behavior / Integrator ポリシーを使う．
+//   種は 1 つ（SpeciesParams を 1 組），フローフィールドなし，乱数は内蔵 xorshift
+// ------------------------------------------------------------
+#ifndef __BOIDS_FIXEDFLOCK_HPP__
+#define __BOIDS_FIXEDFLOCK_HPP__
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include "vec.hpp"
+#include "species.hpp"
+#include "behavior.hpp"
+#include "integrator.hpp"
+
+// f(integral_constant<int, 0>) … f(integral_constant<int, N-1>) を展開して呼ぶ
+template<class F, int... I>
+BOIDS_INLINE void unrollImpl(F& f, std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>{}), ...);
+}
+template<int N, class F>
+BOIDS_INLINE void unroll(F&& f) { unrollImpl(f, std::make_integer_sequence<int, N>{}); }
+
+template<int N, int D = 2, class Behavior = FullBoids, class Integrator = SemiImplicitEuler>
+class FixedFlock {
+public:
+    using VecD = Vec<D>;
+    static constexpr int size = N;
+
+    explicit FixedFlock(const VecD& world, float radius = 3.f, float viewRadius = 200.f,
+                        const SpeciesParams& params = {})
+        : world_(world), radius_(radius), viewRad_(viewRadius), P_(params) {}
+
+    void set(int i, const VecD& p, const VecD& v) { p_[cur_][i] = p; v_[cur_][i] = v; a_[i] = VecD{}; }
+    const VecD& pos(int i) const { return p_[cur_][i]; }
+    const VecD& vel(int i) const { return v_[cur_][i]; }
+    SpeciesParams& params() { return P_; }
+    void seed(uint32_t s) { rng_ = s ? s : 1u; }
+
+    // 1 ティック：全員が同じ時刻の状態（面 cur_）を見て，結果を反対の面に書く
+    void step(float dt) {
+        const std::array<VecD, N>& P0 = p_[cur_];
+        const std::array<VecD, N>& V0 = v_[cur_];
+        std::array<VecD, N>& P1 = p_[cur_ ^ 1];
+        std::array<VecD, N>& V1 = v_[cur_ ^ 1];
+        for (int i = 0; i < N; ++i) {
+            VecD p = P0[i], v = V0[i];
+            VecD u_ran{};
+            if constexpr (Behavior::random) u_ran = randomDir() * (30.f * P_.k_ran);
+            Integrator::step(p, v, a_[i], dt,
+                [&](const VecD& q, const VecD& w, float tau){ return accel(i, q, w, tau, u_ran, P0, V0); },
+                [&](VecD& w){ clip(w, P_.Vmax); });
+            for (int k = 0; k < D; ++k)
+                p[k] = std::fmin(std::fmax(p[k], radius_), world_[k] - radius_);
+            P1[i] = p;
+            V1[i] = v;
+        }
+        cur_ ^= 1;
+    }
+
+private:
+    VecD  world_;
+    float radius_, viewRad_;
+    SpeciesParams P_;
+    std::array<VecD, N> p_[2]{}, v_[2]{};
+    std::array<VecD, N> a_{};
+    int      cur_{0};
+    uint32_t rng_{2463534242u};
+
+    // i の加速度．相手は面 cur_ の状態から tau 秒外挿（World の Agent::accel と同じ式）
+    VecD accel(int i, const VecD& p, const VecD& v, float tau, const VecD& u_ran,
+               const std::array<VecD, N>& P0, const std::array<VecD, N>& V0) const
+    {
+        ForceAcc<D> f;
+        if constexpr (Behavior::pairwise) {
+            unroll<N>([&](auto J){
+                constexpr int j = decltype(J)::value;
+                if (j == i) return;
+                const VecD pj = (tau == 0.f) ? P0[j] : P0[j] + V0[j] * tau;
+                const VecD rij = pj - p;
+                const float r2 = dot(rij, rij);
+                float d, invD;
+                if constexpr (PREC == Precision::Exact) {
+                    d = std::sqrt(r2);
+                    if (d >= viewRad_) return;
+                    invD = 1.0f / d;
+                } else {
+                    if (r2 >= viewRad_ * viewRad_) return;
+                    invD = (r2 > 0.f) ? rsqrt<PREC>(r2) : 0.f;
+                    d = r2 * invD;
+                }
+                const Neighbor<D> nb{ rij, pj, V0[j], d, invD, viewRad_, true, 0.f };
+                if constexpr (Behavior::flockStats) { f.vSum += V0[j]; f.pSum += pj; ++f.cnt; }
+                Behavior::pair(f, nb, P_);
+            });
+        }
+        ForceAcc<D> g = f;
+        Behavior::self(g, SelfState<D>{ p, v, world_, u_ran, nullptr }, P_);
+        VecD a = (Behavior::total(g) - v * P_.D) * (1.0f / P_.M);
+        clip(a, P_.Amax);
+        return a;
+    }
+
+    static constexpr Precision PREC = Behavior::precision;
+
+    static void clip(VecD& x, float m) {
+        const float n = norm<PREC>(x);
+        if (n > m) x = x * (m / (n + 1e-6f));
+    }
+
+    float uniform() {                       // xorshift32 → [0, 1)
+        rng_ ^= rng_ << 13; rng_ ^= rng_ >> 17; rng_ ^= rng_ << 5;
+        return (rng_ >> 8) * (1.0f / 16777216.0f);
+    }
+    VecD randomDir() {
+        const float ang = uniform() * 6.2831853f;
+        if constexpr (D == 2) {
+            return VecD{ std::cos(ang), std::sin(ang) };
+        } else {
+            const float z = uniform() * 2.f - 1.f;
+            const float s = std::sqrt(std::fmax(0.f, 1.f - z*z));
+            return VecD{ s*std::cos(ang), s*std::sin(ang), z };
+        }
+    }
+};
+
+#endif // __BOIDS_FIXEDFLOCK_HPP__
@@ -0,0 +1,237 @@
+// ------------------------------------------------------------
+// FlowField：ワールド格子上のゴール誘導場
+//   ゴールから 8 近傍ダイクストラ（距離場 ≒ アイコナール解）を張り，
+//   セルごとに「ゴールへ向かう単位ベクトル」を持つ．
+//   エージェントは steer(p) を 1 回引くだけでゴール項を得る．
+//
+//   ゴール・障害物の変更は保留し，update() でまとめて反映する：
+//     - 障害物の追加 / 旧ゴール：そのセルを経由していた部分木だけを無効化し，
+//       境界から再ダイクストラ（距離が増える側）
+//     - 障害物の除去 / 新ゴール：そのセルから距離が縮む範囲だけ伝播
+//   ゴールが 1 つだけのとき旧ゴールの部分木は到達可能域全体なので，
+//   ゴール移動は結果的に全面再計算になる（障害物編集は局所で済む）．
+// ------------------------------------------------------------
+#ifndef __BOIDS_FLOWFIELD_HPP__
+#define __BOIDS_FLOWFIELD_HPP__
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include "vec.hpp"
+
+class FlowField {
+public:
+    FlowField(float worldW, float worldH, float cellSize)
+        : cell_(cellSize),
+          cols_(std::max(1, (int)std::ceil(worldW / cellSize))),
+          rows_(std::max(1, (int)std::ceil(worldH / cellSize))),
+          dist_(cols_*rows_, INF), parent_(cols_*rows_, -1),
+          blocked_(cols_*rows_, 0), dir_(cols_*rows_),
+          stamp_(cols_*rows_, 0) {}
+
+    int   cols()     const { return cols_; }
+    int   rows()     const { return rows_; }
+    int   size()     const { return cols_*rows_; }
+    float cellSize() const { return cell_; }
+
+    int cellOf(const Vec2& p) const {
+        int cx = std::clamp((int)(p.x / cell_), 0, cols_-1);
+        int cy = std::clamp((int)(p.y / cell_), 0, rows_-1);
+        return cy*cols_ + cx;
+    }
+    Vec2 cellCenter(int c) const {
+        return { (c % cols_ + 0.5f) * cell_, (c / cols_ + 0.5f) * cell_ };
+    }
+
+    bool  blocked(int c)   const { return blocked_[c] != 0; }
+    bool  blockedAt(const Vec2& p) const { return blocked(cellOf(p)); }
+    bool  hasGoal()        const { return goal_ >= 0; }
+    int   goalCell()       const { return goal_; }
+    float distance(int c)  const { return dist_[c]; }
+    bool  dirty()          const { return !raise_.empty() || !lower_.empty(); }
+
+    // 操舵ベクトル（単位 or 0）：セル 1 回の参照
+    const Vec2& steer(const Vec2& p) const { return dir_[cellOf(p)]; }
+
+    // --- 編集（update() まで保留） ---
+    bool setGoal(const Vec2& p) {
+        int c = cellOf(p);
+        if (blocked(c) || c == goal_) return false;
+        if (goal_ >= 0) raise_.push_back(goal_);
+        goal_ = c;
+        lower_.push_back(c);
+        return true;
+    }
+    void clearGoal() {
+        if (goal_ < 0) return;
+        raise_.push_back(goal_);
+        goal_ = -1;
+    }
+    void setObstacle(int c, bool on) {
+        if (blocked(c) == on) return;
+        blocked_[c] = on ? 1 : 0;
+        if (on) {
+            if (c == goal_) goal_ = -1;     // ゴールを塞いだらゴール消失
+            raise_.push_back(c);
+        } else {
+            lower_.push_back(c);
+        }
+    }
+    void setObstacle(const Vec2& p, bool on) { setObstacle(cellOf(p), on); }
+    void toggleObstacle(const Vec2& p) { int c = cellOf(p); setObstacle(c, !blocked(c)); }
+
+    // 保留中の変更を局所的に反映．再計算したセル数を返す
+    int update() {
+        if (!dirty()) return 0;
+        ++tick_;
+        touched_.clear();
+        heap_.clear();
+
+        // ① 距離が増える側：部分木を無効化
+        std::vector<int>& inval = scratch_;
+        inval.clear();
+        for (int c : raise_) {
+            invalidateSubtree(c, inval);
+            // c の角を通る斜め辺を親に持つ近傍も無効
+            forNeighbors(c, [&](int n, int){
+                if (parent_[n] >= 0 && !edgeOk(n, parent_[n])) invalidateSubtree(n, inval);
+            });
+        }
+        // 無効域の外周（有効な近傍）から張り直す
+        for (int c : inval) {
+            forNeighbors(c, [&](int n, int){
+                if (!blocked(n) && stamp_[n] != tick_ && dist_[n] < INF) push(dist_[n], n);
+            });
+        }
+
+        // ② 距離が減る側：新ゴール・解放セルの近傍から伝播
+        if (goal_ >= 0 && !blocked(goal_)) {
+            if (dist_[goal_] != 0.f) touch(goal_);
+            dist_[goal_] = 0.f; parent_[goal_] = -1;
+            push(0.f, goal_);
+        }
+        for (int c : lower_) {
+            forNeighbors(c, [&](int n, int){
+                if (!blocked(n) && dist_[n] < INF) push(dist_[n], n);
+            });
+        }
+        raise_.clear();
+        lower_.clear();
+
+        // ③ ダイクストラ（変化したセルだけ touched_ に積む）
+        while (!heap_.empty()) {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<>{});
+            auto [d, c] = heap_.back();
+            heap_.pop_back();
+            if (d > dist_[c]) continue;
+            forNeighbors(c, [&](int n, int k){
+                if (blocked(n) || !edgeOk(c, n)) return;
+                float nd = d + COST[k];
+                if (nd + 1e-5f < dist_[n]) {
+                    dist_[n] = nd; parent_[n] = c;
+                    touch(n);
+                    push(nd, n);
+                }
+            });
+        }
+
+        // ④ 方向の更新：変化セル + その近傍の障害物セル（脱出方向）
+        const int changed = (int)touched_.size();
+        for (int i = 0; i < changed; ++i) {
+            int c = touched_[i];
+            forNeighbors(c, [&](int n, int){ if (blocked(n)) touch(n); });
+        }
+        for (int c : touched_) refreshDir(c);
+        return changed;
+    }
+
+    // 全面再計算（比較・初期化用）．計算したセル数を返す
+    int rebuild() {
+        std::fill(dist_.begin(), dist_.end(), INF);
+        std::fill(parent_.begin(), parent_.end(), -1);
+        std::fill(dir_.begin(), dir_.end(), Vec2{});
+        raise_.clear(); lower_.clear();
+        if (goal_ < 0) return 0;
+        lower_.push_back(goal_);
+        return update();
+    }
+
+private:
+    static constexpr float INF = std::numeric_limits<float>::infinity();
+    static constexpr int   DX[8]   = { 1,-1, 0, 0, 1, 1,-1,-1 };
+    static constexpr int   DY[8]   = { 0, 0, 1,-1, 1,-1, 1,-1 };
+    static constexpr float COST[8] = { 1.f,1.f,1.f,1.f, 1.41421356f,1.41421356f,1.41421356f,1.41421356f };
+
+    float cell_;
+    int   cols_, rows_;
+    int   goal_{-1};
+
+    std::vector<float>   dist_;      // ゴールまでの距離 [セル]
+    std::vector<int>     parent_;    // 最短路で次に進むセル
+    std::vector<uint8_t> blocked_;
+    std::vector<Vec2>    dir_;       // 操舵ベクトル
+
+    std::vector<int> raise_, lower_;           // 保留中の変更
+    std::vector<std::pair<float,int>> heap_;
+    std::vector<int> touched_, scratch_, stack_;
+    std::vector<uint32_t> stamp_;              // update() 内の重複排除
+    uint32_t tick_{0};
+
+    template<class F>
+    void forNeighbors(int c, F&& f) const {
+        const int cx = c % cols_, cy = c / cols_;
+        for (int k = 0; k < 8; ++k) {
+            int nx = cx + DX[k], ny = cy + DY[k];
+            if (nx < 0 || ny < 0 || nx >= cols_ || ny >= rows_) continue;
+            f(ny*cols_ + nx, k);
+        }
+    }
+    // 斜め移動は角の 2 セルが両方空いているときだけ（角抜け禁止）
+    bool edgeOk(int a, int b) const {
+        const int ax = a % cols_, ay = a / cols_;
+        const int bx = b % cols_, by = b / cols_;
+        if (ax == bx || ay == by) return true;
+        return !blocked(ay*cols_ + bx) && !blocked(by*cols_ + ax);
+    }
+    void push(float d, int c) {
+        heap_.emplace_back(d, c);
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<>{});
+    }
+    void touch(int c) {
+        if (stamp_[c] == tick_) return;
+        stamp_[c] = tick_;
+        touched_.push_back(c);
+    }
+    void invalidateSubtree(int root, std::vector<int>& out) {
+        stack_.clear();
+        stack_.push_back(root);
+        while (!stack_.empty()) {
+            int x = stack_.back(); stack_.pop_back();
+            if (stamp_[x] == tick_ || x == goal_) continue;
+            stamp_[x] = tick_;
+            touched_.push_back(x);
+            out.push_back(x);
+            dist_[x] = INF; parent_[x] = -1;
+            forNeighbors(x, [&](int n, int){ if (parent_[n] == x) stack_.push_back(n); });
+        }
+    }
+    void refreshDir(int c) {
+        dir_[c] = Vec2{};
+        if (c == goal_) return;
+        int best = blocked(c) ? -1 : parent_[c];
+        if (blocked(c)) {
+            // 障害物内：最も近い空きセルへ押し出す
+            float bd = INF;
+            forNeighbors(c, [&](int n, int){
+                if (!blocked(n) && dist_[n] < bd) { bd = dist_[n]; best = n; }
+            });
+        }
+        if (best >= 0) dir_[c] = normalize(cellCenter(best) - cellCenter(c));
+    }
+};
+
+#endif // __BOIDS_FLOWFIELD_HPP__
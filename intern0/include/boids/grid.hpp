@@ -0,0 +1,174 @@
+// ------------------------------------------------------------
+// SpatialGrid：一様格子による近傍探索（BasicGrid<D>，2D/3D 共通）
+//   build() でエージェント番号をセル順に計数ソート（CSR 形式）し，
+//   query() は半径 r の円にかかるセルだけを走査する．
+//   layers > 1 のときは (セル, 層) の順に並べ，マスクで層（種）を選んで走査できる．
+//   traverseDDA() は線分が通るセルを順に列挙する（遮蔽判定用，2D のみ）．
+// ------------------------------------------------------------
+#ifndef __BOIDS_GRID_HPP__
+#define __BOIDS_GRID_HPP__
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include "vec.hpp"
+
+// 線分 a→b が通るセルを a 側から順に visit(cx, cy) する（Amanatides–Woo）
+// visit が false を返したら打ち切り，そのとき false を返す
+template<class F>
+static bool traverseDDA(const Vec2& a, const Vec2& b, float cell, int cols, int rows, F&& visit)
+{
+    const float inv = 1.0f / cell;
+    int cx = std::clamp((int)(a.x * inv), 0, cols-1);
+    int cy = std::clamp((int)(a.y * inv), 0, rows-1);
+    const int ex = std::clamp((int)(b.x * inv), 0, cols-1);
+    const int ey = std::clamp((int)(b.y * inv), 0, rows-1);
+
+    const Vec2  d  = b - a;
+    const int   sx = (d.x > 0) ? 1 : -1;
+    const int   sy = (d.y > 0) ? 1 : -1;
+    const float big = 1e30f;
+    // 次の縦/横境界までのパラメータ t と，1 セル進むごとの増分
+    float tMaxX = (d.x != 0) ? (((cx + (sx > 0)) * cell - a.x) / d.x) : big;
+    float tMaxY = (d.y != 0) ? (((cy + (sy > 0)) * cell - a.y) / d.y) : big;
+    const float tDx = (d.x != 0) ? cell / std::fabs(d.x) : big;
+    const float tDy = (d.y != 0) ? cell / std::fabs(d.y) : big;
+
+    const int maxSteps = std::abs(ex - cx) + std::abs(ey - cy);
+    for (int s = 0; ; ++s) {
+        if (!visit(cx, cy)) return false;
+        if ((cx == ex && cy == ey) || s >= maxSteps) return true;
+        if (tMaxX < tMaxY) { cx += sx; tMaxX += tDx; }
+        else               { cy += sy; tMaxY += tDy; }
+        if (cx < 0 || cy < 0 || cx >= cols || cy >= rows) return true;
+    }
+}
+
+// D 次元の一様格子．セル番号は x が最速（c = x + cols*(y + rows*z)）
+// 要素は (セル c, 層 l) → バケット c*L + l に入る（L = layers）
+template<int D>
+class BasicGrid {
+public:
+    using VecD = Vec<D>;
+
+    BasicGrid(const VecD& world, float cellSize) : cell_(cellSize) {
+        int total = 1;
+        for (int k = 0; k < D; ++k) {
+            n_[k] = std::max(1, (int)std::ceil(world[k] / cellSize));
+            total *= n_[k];
+        }
+        cells_ = total;
+        start_.assign(cells_*L_ + 1, 0);
+    }
+    BasicGrid(float worldW, float worldH, float cellSize) requires (D == 2)
+        : BasicGrid(VecD{worldW, worldH}, cellSize) {}
+
+    int   cols()     const { return n_[0]; }
+    int   rows()     const { return n_[1]; }
+    int   cells(int k) const { return n_[k]; }
+    int   size()     const { return cells_; }
+    int   layers()   const { return L_; }
+    void  setLayers(int L) { L_ = std::max(1, L); start_.assign(cells_*L_ + 1, 0); }
+    float cellSize() const { return cell_; }
+
+    // k 軸をワールド全体の格子のセル [first, first+count) に絞る（窓の外は端のセルに寄せる）．
+    // セルの切り方は全体の格子と同じなので，窓の中の個体の走査順も全体の格子と変わらない
+    void setWindow(int k, int first, int count) {
+        org_[k] = first;
+        n_[k]   = std::max(1, count);
+        cells_  = 1;
+        for (int j = 0; j < D; ++j) cells_ *= n_[j];
+        start_.assign(cells_*L_ + 1, 0);
+    }
+
+    int cellCoord(float v, int k) const { return std::clamp((int)(v / cell_) - org_[k], 0, n_[k]-1); }
+    int cellX(float x) const { return cellCoord(x, 0); }
+    int cellY(float y) const { return cellCoord(y, 1); }
+    int cellOf(const VecD& p) const {
+        int c = 0;
+        for (int k = D-1; k >= 0; --k) c = c*n_[k] + cellCoord(p[k], k);
+        return c;
+    }
+
+    // pos(i) → VecD を n 個ぶん登録し直す（layer(i) → 0..L-1）
+    template<class PosFn>
+    void build(int n, PosFn&& pos) { build(n, pos, [](int){ return 0; }); }
+
+    template<class PosFn, class LayerFn>
+    void build(int n, PosFn&& pos, LayerFn&& layer) {
+        cellOfItem_.resize(n);
+        items_.resize(n);
+        std::fill(start_.begin(), start_.end(), 0);
+        for (int i = 0; i < n; ++i) {
+            int c = cellOf(pos(i))*L_ + layer(i);
+            cellOfItem_[i] = c;
+            ++start_[c + 1];
+        }
+        const int buckets = cells_*L_;
+        for (int c = 0; c < buckets; ++c) start_[c + 1] += start_[c];
+        fill_.assign(start_.begin(), start_.end() - 1);
+        for (int i = 0; i < n; ++i) items_[fill_[cellOfItem_[i]]++] = i;
+    }
+
+    // セル c の要素列 [begin, end)（全層）
+    const int* cellBegin(int c) const { return items_.data() + start_[c*L_]; }
+    const int* cellEnd  (int c) const { return items_.data() + start_[(c + 1)*L_]; }
+    const int* cellBegin(int cx, int cy) const requires (D == 2) { return cellBegin(cy*n_[0] + cx); }
+    const int* cellEnd  (int cx, int cy) const requires (D == 2) { return cellEnd(cy*n_[0] + cx); }
+
+    // p 中心・半径 r にかかるセルの要素をすべて f(j) に渡す（距離判定は呼び出し側）
+    // layerMask を渡すとビットの立った層だけ
+    template<class F>
+    void query(const VecD& p, float r, F&& f) const { query(p, r, ~0u, f); }
+
+    template<class F>
+    void query(const VecD& p, float r, uint32_t layerMask, F&& f) const {
+        int lo[D], hi[D];
+        for (int k = 0; k < D; ++k) { lo[k] = cellCoord(p[k] - r, k); hi[k] = cellCoord(p[k] + r, k); }
+        if constexpr (D == 2) {
+            for (int cy = lo[1]; cy <= hi[1]; ++cy)
+                for (int cx = lo[0]; cx <= hi[0]; ++cx)
+                    visitCell(cy*n_[0] + cx, layerMask, f);
+        } else {
+            for (int cz = lo[2]; cz <= hi[2]; ++cz)
+                for (int cy = lo[1]; cy <= hi[1]; ++cy)
+                    for (int cx = lo[0]; cx <= hi[0]; ++cx)
+                        visitCell((cz*n_[1] + cy)*n_[0] + cx, layerMask, f);
+        }
+    }
+
+    template<class F>
+    bool traverse(const VecD& a, const VecD& b, F&& visit) const requires (D == 2) {
+        return traverseDDA(a, b, cell_, n_[0], n_[1], visit);
+    }
+
+private:
+    float cell_;
+    int   n_[D];
+    int   org_[D]{};                // 窓の先頭セル（setWindow）
+    int   cells_{1};
+    int   L_{1};
+    std::vector<int> start_;        // バケット b の要素は items_[start_[b] .. start_[b+1])
+    std::vector<int> items_;
+    std::vector<int> cellOfItem_, fill_;
+
+    template<class F>
+    void visitCell(int c, uint32_t layerMask, F& f) const {
+        const uint32_t all = (L_ >= 32) ? ~0u : ((1u << L_) - 1);
+        if ((layerMask & all) == all) {         // 全層なら連続区間 1 本で済む
+            for (const int* it = cellBegin(c); it != cellEnd(c); ++it) f(*it);
+            return;
+        }
+        for (uint32_t m = layerMask & all; m; m &= m - 1) {
+            const int b = c*L_ + std::countr_zero(m);
+            for (int k = start_[b]; k < start_[b + 1]; ++k) f(items_[k]);
+        }
+    }
+};
+
+using SpatialGrid  = BasicGrid<2>;
+using SpatialGrid3 = BasicGrid<3>;
+
+#endif // __BOIDS_GRID_HPP__
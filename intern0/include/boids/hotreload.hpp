@@ -0,0 +1,237 @@
+// ------------------------------------------------------------
+// HotParams：JSON のパラメータファイルを inotify で見張り，動かしたまま差し替える
+//   ファイルの形（書いたキーだけ上書き．書かなければ watch() に渡した表の値のまま）
+//     {
+//       "species":  [ { "k_coh": 3.0, "Vmax": 120 }, ... ],   // 添字 = 種番号
+//       "flocks":   [[1, 0], [0, 1]],                          // 種の数 × 種の数
+//       "interact": [[0, -5], [8, 0]]
+//     }
+//   書き込み側（見張りスレッド）
+//     ファイルが書き終わる（IN_CLOSE_WRITE）か置き換わる（IN_MOVED_TO，エディタの保存）たびに
+//     読んで構文解析し，新しい不変の ParamBlock を作って cur_ に atomic に差し込む．
+//     壊れた JSON・種の数の違うファイル・有限でない値・M <= 0 や負の D / Vmax / Amax は
+//     捨てて（failures）前の版のまま
+//   読み出し側（シミュレーションスレッド）
+//     apply() をティックの境目で呼ぶ．cur_ を 1 回読むだけで，版が変わっていれば表を写す．
+//     ロックも待ちもない．版は丸ごと不変なので，半分だけ新しい値を読むことはない
+//   古い版の解放（RCU の静止状態）
+//     apply() は最後に読んだ版を quiescent_ に書く．読み手は 1 本なので，
+//     それより古い版はもう誰も読んでいない．見張りスレッドはその分だけ delete する
+// ------------------------------------------------------------
+#ifndef __BOIDS_HOTRELOAD_HPP__
+#define __BOIDS_HOTRELOAD_HPP__
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include "species.hpp"
+#include "../json.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+struct ParamBlock {
+    uint64_t     version = 0;
+    SpeciesTable species;
+};
+
+class HotParams {
+public:
+    struct Stats {
+        std::atomic<uint64_t> reloads{0}, failures{0}, applied{0};
+        std::atomic<double>   parseMsMax{0};     // 読んで解析して差し込むまで（見張りスレッド側）
+    };
+
+    HotParams() = default;
+    ~HotParams() { stop(); }
+    HotParams(const HotParams&) = delete;
+    HotParams& operator=(const HotParams&) = delete;
+
+    bool enabled() const { return cur_.load(std::memory_order_relaxed) != nullptr; }
+    const Stats& stats() const { return stats_; }
+    const std::string& path() const { return path_; }
+    uint64_t version() const { return applied_; }
+
+    // path を読み込んで見張り始める．base は書かれていないキーの値と種の数
+    bool watch(const std::string& path, const SpeciesTable& base) {
+        stop();
+        path_ = path;
+        base_ = base;
+        if (!reload()) return false;                   // 最初の 1 回は呼び出し元で（壊れていれば始めない）
+#ifdef __linux__
+        quit_ = false;
+        worker_ = std::thread([this]{ loop(); });
+        return true;
+#else
+        std::fprintf(stderr, "hot reload: inotify is Linux only; %s is loaded once\n", path.c_str());
+        return true;
+#endif
+    }
+    void stop() {
+        quit_ = true;
+        if (worker_.joinable()) worker_.join();
+        delete cur_.exchange(nullptr);
+        retired_.clear();
+    }
+
+    // シミュレーションスレッドがティックの境目で呼ぶ．新しい版を写したら true
+    bool apply(SpeciesTable& into) {
+        const ParamBlock* p = cur_.load(std::memory_order_acquire);
+        if (!p) return false;
+        bool changed = false;
+        if (p->version != applied_) {
+            into = p->species;                         // 種の数は同じなので確保し直さない
+            applied_ = p->version;
+            stats_.applied.fetch_add(1, std::memory_order_relaxed);
+            changed = true;
+        }
+        quiescent_.store(p->version, std::memory_order_release);   // これより古い版はもう読まない
+        return changed;
+    }
+
+    // text を base に重ねて out に（失敗なら err に理由）．例外は使わない
+    static bool parse(const std::string& text, const SpeciesTable& base, SpeciesTable& out, std::string& err) {
+        using nlohmann::json;
+        const json j = json::parse(text, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) { err = "not a JSON object"; return false; }
+        out = base;
+        const int S = base.count();
+        if (auto it = j.find("species"); it != j.end()) {
+            if (!it->is_array() || (int)it->size() > S) { err = "\"species\" must be an array of at most " + std::to_string(S) + " objects"; return false; }
+            for (int s = 0; s < (int)it->size(); ++s) {
+                const json& o = (*it)[s];
+                if (!o.is_object()) { err = "species[" + std::to_string(s) + "] is not an object"; return false; }
+                SpeciesParams& P = out.params(s);
+                for (auto kv = o.begin(); kv != o.end(); ++kv) {
+                    float* f = field(P, kv.key());
+                    if (!f) { err = "unknown parameter \"" + kv.key() + "\""; return false; }
+                    if (!kv->is_number()) { err = "\"" + kv.key() + "\" is not a number"; return false; }
+                    *f = kv->get<float>();
+                    if (!std::isfinite(*f)) { err = "\"" + kv.key() + "\" is not finite"; return false; }
+                }
+                // 次のティックで inf/NaN にならない範囲（M で割る・制限で割る）
+                const std::string at = "species[" + std::to_string(s) + "]: ";
+                if (!(P.M > 0.f))    { err = at + "\"M\" must be > 0"; return false; }
+                if (P.D < 0.f)       { err = at + "\"D\" must be >= 0"; return false; }
+                if (P.Vmax < 0.f)    { err = at + "\"Vmax\" must be >= 0"; return false; }
+                if (P.Amax < 0.f)    { err = at + "\"Amax\" must be >= 0"; return false; }
+            }
+        }
+        auto matrix = [&](const char* key, auto&& set) {
+            auto it = j.find(key);
+            if (it == j.end()) return true;
+            if (!it->is_array() || (int)it->size() != S) { err = std::string("\"") + key + "\" must be " + std::to_string(S) + " x " + std::to_string(S); return false; }
+            for (int s = 0; s < S; ++s) {
+                const json& row = (*it)[s];
+                if (!row.is_array() || (int)row.size() != S) { err = std::string("\"") + key + "\" must be " + std::to_string(S) + " x " + std::to_string(S); return false; }
+                for (int t = 0; t < S; ++t) {
+                    if (!row[t].is_number()) { err = std::string("\"") + key + "\" has a non-number"; return false; }
+                    const float v = row[t].get<float>();
+                    if (!std::isfinite(v)) { err = std::string("\"") + key + "\" has a non-finite value"; return false; }
+                    set(s, t, v);
+                }
+            }
+            return true;
+        };
+        return matrix("flocks",   [&](int s, int t, float v){ out.setFlocks(s, t, v != 0.f); })
+            && matrix("interact", [&](int s, int t, float v){ out.setInteract(s, t, v); });
+    }
+
+private:
+    std::string  path_;
+    SpeciesTable base_;
+    std::atomic<const ParamBlock*> cur_{nullptr};
+    std::atomic<uint64_t> quiescent_{0};
+    std::atomic<bool>     quit_{true};
+    uint64_t     applied_{0};                          // 読み手だけが触る
+    uint64_t     next_{0};                             // 書き手だけが触る
+    std::vector<std::unique_ptr<const ParamBlock>> retired_;   // 書き手だけが触る
+    Stats        stats_;
+    std::thread  worker_;
+
+    static float* field(SpeciesParams& P, const std::string& k) {
+        if (k == "M")      return &P.M;
+        if (k == "D")      return &P.D;
+        if (k == "k_sep")  return &P.k_sep;
+        if (k == "k_ali")  return &P.k_ali;
+        if (k == "k_coh")  return &P.k_coh;
+        if (k == "k_wall") return &P.k_wall;
+        if (k == "k_ran")  return &P.k_ran;
+        if (k == "k_goal") return &P.k_goal;
+        if (k == "Vmax")   return &P.Vmax;
+        if (k == "Amax")   return &P.Amax;
+        return nullptr;
+    }
+
+    // 読んで解析し，新しい版を差し込む（書き手）
+    bool reload() {
+        const auto t0 = std::chrono::steady_clock::now();
+        std::ifstream f(path_);
+        std::stringstream ss;
+        if (f) ss << f.rdbuf();
+        auto block = std::make_unique<ParamBlock>();
+        std::string err = f ? "" : "cannot open";
+        if (!f || !parse(ss.str(), base_, block->species, err)) {
+            std::fprintf(stderr, "hot reload: %s: %s (keeping version %llu)\n", path_.c_str(), err.c_str(),
+                         (unsigned long long)next_);
+            stats_.failures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        block->version = ++next_;
+        const ParamBlock* old = cur_.exchange(block.release(), std::memory_order_acq_rel);
+        if (old) retired_.emplace_back(old);
+        stats_.reloads.fetch_add(1, std::memory_order_relaxed);
+        const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (ms > stats_.parseMsMax.load(std::memory_order_relaxed)) stats_.parseMsMax.store(ms, std::memory_order_relaxed);
+        reclaim();
+        return true;
+    }
+    // 読み手が静止状態を過ぎた版を解放
+    void reclaim() {
+        const uint64_t q = quiescent_.load(std::memory_order_acquire);
+        std::erase_if(retired_, [&](const std::unique_ptr<const ParamBlock>& b){ return b->version < q; });
+    }
+
+#ifdef __linux__
+    void loop() {
+        const size_t slash = path_.find_last_of('/');
+        const std::string dir  = slash == std::string::npos ? "." : path_.substr(0, slash);
+        const std::string name = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+        const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        // ディレクトリを見る（エディタは別名に書いて rename するので，ファイル自体の watch は消える）
+        if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::perror("inotify");
+            if (fd >= 0) close(fd);
+            return;
+        }
+        alignas(inotify_event) char buf[4096];
+        while (!quit_.load(std::memory_order_relaxed)) {
+            pollfd p{ fd, POLLIN, 0 };
+            if (poll(&p, 1, 100) <= 0) { reclaim(); continue; }   // 100 ms ごとに止める合図と解放を見る
+            bool hit = false;
+            for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0; ) {
+                for (char* q = buf; q < buf + n; ) {
+                    const inotify_event* e = reinterpret_cast<const inotify_event*>(q);
+                    if (e->len > 0 && name == e->name) hit = true;
+                    q += sizeof(inotify_event) + e->len;
+                }
+            }
+            if (hit) reload();
+        }
+        close(fd);
+    }
+#endif
+};
+
+#endif // __BOIDS_HOTRELOAD_HPP__
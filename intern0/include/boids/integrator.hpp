@@ -0,0 +1,64 @@
+// ------------------------------------------------------------
+// 積分器ポリシー（テンプレート引数で選ぶ → ホットループに仮想呼び出しなし）
+//   step(p, v, a, dt, accel, limitV)
+//     accel(p, v, tau) → ティック先頭から tau 秒後の加速度
+//                        （近傍は先頭の状態から等速で外挿して評価する）
+//     limitV(v)   → 速度制限（Vmax）
+//     a           → 直近に評価した加速度（Verlet は前ティックの値を再利用）
+//
+//   SemiImplicitEuler  1 評価/step, 1 次．従来の v ← v + a dt, p ← p + v dt
+//   VelocityVerlet     1 評価/step, 2 次．kick-drift-kick（速度依存力は半歩速度で評価）
+//   RK4                4 評価/step, 4 次（古典的ルンゲ・クッタ）
+// ------------------------------------------------------------
+#ifndef __BOIDS_INTEGRATOR_HPP__
+#define __BOIDS_INTEGRATOR_HPP__
+
+struct SemiImplicitEuler {
+    static constexpr const char* name  = "semi-implicit Euler";
+    static constexpr int         evals = 1;
+
+    template<class VecD, class Accel, class Limit>
+    static void step(VecD& p, VecD& v, VecD& a, float dt, Accel&& accel, Limit&& limitV) {
+        a = accel(p, v, 0.f);
+        v += a * dt;
+        limitV(v);
+        p += v * dt;
+    }
+};
+
+struct VelocityVerlet {
+    static constexpr const char* name  = "velocity Verlet";
+    static constexpr int         evals = 1;
+
+    template<class VecD, class Accel, class Limit>
+    static void step(VecD& p, VecD& v, VecD& a, float dt, Accel&& accel, Limit&& limitV) {
+        const float h = 0.5f * dt;
+        v += a * h;              // kick（前ティックの加速度）
+        limitV(v);
+        p += v * dt;             // drift
+        a = accel(p, v, dt);
+        v += a * h;              // kick
+        limitV(v);
+    }
+};
+
+struct RK4 {
+    static constexpr const char* name  = "RK4";
+    static constexpr int         evals = 4;
+
+    template<class VecD, class Accel, class Limit>
+    static void step(VecD& p, VecD& v, VecD& a, float dt, Accel&& accel, Limit&& limitV) {
+        const float h = 0.5f * dt;
+        const VecD p1 = p,          v1 = v,          a1 = accel(p1, v1, 0.f);
+        const VecD p2 = p + v1*h,   v2 = v + a1*h,   a2 = accel(p2, v2, h);
+        const VecD p3 = p + v2*h,   v3 = v + a2*h,   a3 = accel(p3, v3, h);
+        const VecD p4 = p + v3*dt,  v4 = v + a3*dt,  a4 = accel(p4, v4, dt);
+        const float w = dt / 6.f;
+        p += (v1 + (v2 + v3)*2.f + v4) * w;
+        v += (a1 + (a2 + a3)*2.f + a4) * w;
+        limitV(v);
+        a = a1;
+    }
+};
+
+#endif // __BOIDS_INTEGRATOR_HPP__
@@ -0,0 +1,129 @@
+// ------------------------------------------------------------
+// MortonOrder：エージェント配列を Z 順（Morton 曲線）に並べ替える順列を作る
+//   長く回すと空間的に隣どうしの個体が配列上でばらばらになり，近傍アクセスが
+//   キャッシュを外し続ける．位置をワールドで正規化して量子化し，軸ごとのビットを
+//   交互に並べた 32 bit のキーで安定に並べれば，近い個体は配列上でも近くなる．
+//   並べ替えは 8 bit × 4 パスの LSD 基数ソートで，各パスを
+//     1. スレッドごとの連続区間でヒストグラム
+//     2. (桁, スレッド) の順に前置和 → 書き込み先
+//     3. 各スレッドが自分の区間を順に書き込む（安定）
+//   の 3 段で ThreadPool に分ける．結果はスレッド数に依らない．
+//   order()[i] は「並べ替え後の i 番目に来る元の番号」
+// ------------------------------------------------------------
+#ifndef __BOIDS_MORTON_HPP__
+#define __BOIDS_MORTON_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include "vec.hpp"
+#include "parallel.hpp"
+
+// x の下位 16 bit を 1 つおきに（2D 用）
+inline uint32_t mortonSpread2(uint32_t x) {
+    x &= 0x0000ffffu;
+    x = (x | (x << 8)) & 0x00ff00ffu;
+    x = (x | (x << 4)) & 0x0f0f0f0fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+// x の下位 10 bit を 2 つおきに（3D 用）
+inline uint32_t mortonSpread3(uint32_t x) {
+    x &= 0x000003ffu;
+    x = (x | (x << 16)) & 0x030000ffu;
+    x = (x | (x <<  8)) & 0x0300f00fu;
+    x = (x | (x <<  4)) & 0x030c30c3u;
+    x = (x | (x <<  2)) & 0x09249249u;
+    return x;
+}
+
+// p ∈ [0, world) を 2D は 16 bit，3D は 10 bit ずつに量子化して交互に並べる
+template<int D>
+inline uint32_t mortonCode(const Vec<D>& p, const Vec<D>& world) {
+    constexpr int bits = (D == 2) ? 16 : 10;
+    constexpr float top = (float)((1u << bits) - 1);
+    uint32_t q[D];
+    for (int k = 0; k < D; ++k)
+        q[k] = (uint32_t)std::clamp(p[k] / world[k] * top, 0.f, top);
+    if constexpr (D == 2) return mortonSpread2(q[0]) | (mortonSpread2(q[1]) << 1);
+    else return mortonSpread3(q[0]) | (mortonSpread3(q[1]) << 1) | (mortonSpread3(q[2]) << 2);
+}
+
+template<int D>
+class MortonOrder {
+public:
+    bool enabled = false;
+    int  period  = 64;       // 何ティックごとに並べ替えるか
+
+    struct Stats {
+        int    sorts   = 0;
+        double seconds = 0;  // キー計算 + ソート
+    };
+
+    bool due(uint32_t tick) const { return enabled && period > 0 && tick % period == 0; }
+
+    // 位置 pos(i)（i = 0..n-1）から並べ替え順を作る
+    template<class PosFn>
+    const std::vector<int>& sort(int n, PosFn&& pos, const Vec<D>& world, ThreadPool& pool) {
+        const auto t0 = std::chrono::steady_clock::now();
+        key_.resize(n); val_.resize(n); key2_.resize(n); val2_.resize(n);
+        pool.parallelFor(n, [&](int b, int e){
+            for (int i = b; i < e; ++i) { key_[i] = mortonCode<D>(pos(i), world); val_[i] = i; }
+        });
+        const int T = std::max(1, std::min(pool.size(), n / 4096 + 1));
+        hist_.assign((size_t)T * 256, 0);
+        for (int shift = 0; shift < 32; shift += 8) {
+            pass(n, T, shift, pool);
+            key_.swap(key2_);
+            val_.swap(val2_);
+        }
+        ++stats_.sorts;
+        stats_.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return val_;
+    }
+
+    const std::vector<int>& order() const { return val_; }
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = {}; }
+
+private:
+    std::vector<uint32_t> key_, key2_;
+    std::vector<int>      val_, val2_;
+    std::vector<int>      hist_;       // [スレッド][桁] → 書き込み先
+    Stats stats_;
+
+    // key_/val_ を桁 (key >> shift) & 255 で安定に key2_/val2_ へ
+    void pass(int n, int T, int shift, ThreadPool& pool) {
+        auto range = [&](int t, int& b, int& e){
+            b = (int)((long long)n * t / T);
+            e = (int)((long long)n * (t+1) / T);
+        };
+        pool.forEachThread(T, [&](int t){
+            int b, e; range(t, b, e);
+            int* h = &hist_[(size_t)t * 256];
+            std::fill(h, h + 256, 0);
+            for (int i = b; i < e; ++i) ++h[(key_[i] >> shift) & 255];
+        });
+        int sum = 0;
+        for (int d = 0; d < 256; ++d)
+            for (int t = 0; t < T; ++t) {
+                int& h = hist_[(size_t)t * 256 + d];
+                const int c = h;
+                h = sum;
+                sum += c;
+            }
+        pool.forEachThread(T, [&](int t){
+            int b, e; range(t, b, e);
+            int* h = &hist_[(size_t)t * 256];
+            for (int i = b; i < e; ++i) {
+                const int o = h[(key_[i] >> shift) & 255]++;
+                key2_[o] = key_[i];
+                val2_[o] = val_[i];
+            }
+        });
+    }
+};
+
+#endif // __BOIDS_MORTON_HPP__
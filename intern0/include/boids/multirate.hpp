@@ -0,0 +1,65 @@
+// ------------------------------------------------------------
+// Multirate：活動度に応じた更新周期（落ち着いた個体は k ティックに 1 回）
+//   due(i, tick)       このティックに知覚・力計算をするか
+//   settle(i, tick, c) 更新直後に呼ぶ．c（穏やか）なら period 後，そうでなければ次ティック
+//   wake(i, tick)      他個体が近づいたなどで次ティックに起こす
+//   休んでいる個体は直前の（乱数項を除いた）加速度を保ったまま外挿で進め，
+//   他個体からは外挿位置で見える．穏やかの判定は World 側（近傍距離・壁・加速度）
+// ------------------------------------------------------------
+#ifndef __BOIDS_MULTIRATE_HPP__
+#define __BOIDS_MULTIRATE_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+class Multirate {
+public:
+    bool  enabled        = false;
+    int   period         = 4;      // 穏やかな個体の更新間隔 k [ticks]
+    float accelThreshold = 2.f;    // これ未満の |a|（乱数項を除く）なら穏やか
+    float nearDist       = 10.f;   // これより近い相手がいれば毎ティック
+    float wallDist       = 20.f;   // 壁までこれより近ければ毎ティック
+
+    struct Stats {
+        uint64_t agentTicks = 0;   // (個体, ティック) の数
+        uint64_t updated    = 0;   // そのうち知覚・力計算をした数
+        uint64_t wakes      = 0;   // 近づかれて起こされた回数
+    };
+
+    // 個体数が変わったら合わせる（新しい個体はすぐ更新）
+    void resize(int n) { next_.resize(n, 0); }
+
+    // 個体の並べ替えに合わせる（order[i] = 新しい i 番目の元の番号）
+    void permute(const std::vector<int>& order) {
+        tmp_.resize(order.size());
+        for (size_t i = 0; i < order.size(); ++i) tmp_[i] = next_[order[i]];
+        next_.swap(tmp_);
+    }
+
+    // 個体 i を消して末尾を i へ詰めたとき（SlotMap::erase と同じ動き）
+    void erase(int i) {
+        if (i >= (int)next_.size()) return;
+        next_[i] = next_.back();
+        next_.pop_back();
+    }
+
+    bool due(int i, uint32_t tick) const { return !enabled || next_[i] <= tick; }
+
+    void settle(int i, uint32_t tick, bool calm) { next_[i] = tick + (calm ? period : 1); }
+
+    void wake(int i, uint32_t tick) {
+        if (next_[i] > tick + 1) { next_[i] = tick + 1; ++stats_.wakes; }
+    }
+
+    void count(bool updated) { ++stats_.agentTicks; if (updated) ++stats_.updated; }
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = {}; }
+
+private:
+    std::vector<uint32_t> next_;   // 次に更新するティック
+    std::vector<uint32_t> tmp_;
+    Stats stats_;
+};
+
+#endif // __BOIDS_MULTIRATE_HPP__
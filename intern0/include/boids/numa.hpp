@@ -0,0 +1,239 @@
+// ------------------------------------------------------------
+// NUMA を意識した置き場所：大きな個体配列を huge page に置き，ノードごとに
+// 担当スレッドが最初に触って（first-touch）そのノードのメモリに載せる
+//   HugePageAllocator<T>  2 MiB 以上の確保は mmap で
+//                           1. MAP_HUGETLB（予約済みの huge page）
+//                           2. だめなら通常の mmap + madvise(MADV_HUGEPAGE)（THP）
+//                         の順に試す．それより小さい確保と Linux 以外は operator new
+//   Placement             /sys/devices/system/node からノードと CPU を読み，
+//                         ThreadPool のスレッド t を「t の担当区間を持つノード」の CPU に固定．
+//                         firstTouch() は parallelFor と同じ連続区間で各スレッドにページを触らせる
+//   ノードが 1 つ（または読めない）なら固定も first-touch もせず，ふつうの確保と同じに振る舞う
+// ------------------------------------------------------------
+#ifndef __BOIDS_NUMA_HPP__
+#define __BOIDS_NUMA_HPP__
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include "parallel.hpp"
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct HugePages {
+    static constexpr size_t kHuge = size_t(2) << 20;   // x86-64 の huge page
+
+    enum Kind { Heap, HugeTLB, THP, Mmap };
+    static const char* name(Kind k) {
+        switch (k) {
+            case HugeTLB: return "MAP_HUGETLB";
+            case THP:     return "mmap + madvise(MADV_HUGEPAGE)";
+            case Mmap:    return "mmap (no huge pages)";
+            default:      return "heap (below 2 MiB)";
+        }
+    }
+    // 直近の大きな確保がどれで取れたか（起動ログ用）
+    static std::atomic<int>& lastKind() { static std::atomic<int> k{Heap}; return k; }
+
+    static void* allocate(size_t bytes) {
+#ifdef __linux__
+        if (bytes >= kHuge) {
+            const size_t len = round(bytes);
+            void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) { lastKind() = HugeTLB; return p; }
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            lastKind() = madvise(p, len, MADV_HUGEPAGE) == 0 ? THP : Mmap;
+            return p;
+        }
+#endif
+        return ::operator new(bytes);
+    }
+    static void release(void* p, size_t bytes) {
+#ifdef __linux__
+        if (bytes >= kHuge) { munmap(p, round(bytes)); return; }
+#endif
+        ::operator delete(p);
+    }
+    // 小さいときもキャッシュライン境界が要る確保用（mmap はページ境界なのでそのまま）
+    static void* allocate(size_t bytes, std::align_val_t align) {
+#ifdef __linux__
+        if (bytes >= kHuge) return allocate(bytes);
+#endif
+        return ::operator new(bytes, align);
+    }
+    static void release(void* p, size_t bytes, std::align_val_t align) {
+#ifdef __linux__
+        if (bytes >= kHuge) { release(p, bytes); return; }
+#endif
+        ::operator delete(p, align);
+    }
+
+private:
+    static size_t round(size_t bytes) { return (bytes + kHuge - 1) / kHuge * kHuge; }
+};
+
+template<class T>
+struct HugePageAllocator {
+    using value_type = T;
+    HugePageAllocator() = default;
+    template<class U> HugePageAllocator(const HugePageAllocator<U>&) {}
+    T*   allocate(size_t n)          { return static_cast<T*>(HugePages::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n)  { HugePages::release(p, n * sizeof(T)); }
+    template<class U> bool operator==(const HugePageAllocator<U>&) const { return true; }
+};
+
+class Placement {
+public:
+    struct Node { int id; std::vector<int> cpus; };
+
+    Placement() { detect(); }
+
+    int  nodes() const { return (int)nodes_.size(); }
+    bool numa()  const { return nodes_.size() > 1; }
+    bool pinned() const { return pinned_; }
+
+    // スレッド t（全 T 本）の担当ノード：CPU 数に比例した連続ブロック
+    int nodeOf(int t, int T) const {
+        if (!numa()) return 0;
+        size_t total = 0;
+        for (const Node& n : nodes_) total += n.cpus.size();
+        const size_t at = (size_t)t * total / std::max(1, T);
+        size_t acc = 0;
+        for (int k = 0; k < nodes(); ++k) {
+            acc += nodes_[k].cpus.size();
+            if (at < acc) return k;
+        }
+        return nodes() - 1;
+    }
+    int cpuOf(int t, int T) const {
+        const int k = nodeOf(t, T);
+        int first = t;
+        while (first > 0 && nodeOf(first - 1, T) == k) --first;
+        const std::vector<int>& c = nodes_[k].cpus;
+        return c.empty() ? -1 : c[(t - first) % c.size()];
+    }
+
+    // プールの各スレッド（t = 0 は呼び出し元）を担当ノードの CPU に固定
+    void pin(ThreadPool& pool) {
+        if (!numa()) return;
+        const int T = pool.size();
+        std::vector<int> ok(T, 0);
+        pool.forEachThread(T, [&](int t){ ok[t] = pinSelf(cpuOf(t, T)); });
+        pinned_ = std::all_of(ok.begin(), ok.end(), [](int v){ return v != 0; });
+    }
+
+    // [p, p+bytes) を parallelFor と同じ連続区間に分け，各スレッドが自分の区間のページを触る
+    // （書くのは読んだ値そのものなので，構築済みの要素があっても壊さない）
+    void firstTouch(void* p, size_t bytes, ThreadPool& pool) const {
+        if (!numa() || !p || bytes == 0) return;
+        const int T = pool.size();
+        const long page = pageSize();
+        volatile unsigned char* base = static_cast<unsigned char*>(p);
+        pool.forEachThread(T, [&](int t){
+            const size_t b = bytes * t / T, e = bytes * (t+1) / T;
+            for (size_t o = b; o < e; o += page) base[o] = base[o];
+        });
+    }
+
+    // 起動ログ
+    void describe(std::FILE* out, int threads, const char* what, size_t bytes) const {
+        std::fprintf(out, "placement: %d NUMA node%s", nodes(), nodes() == 1 ? "" : "s");
+        for (const Node& n : nodes_) std::fprintf(out, " [node%d: %zu cpus]", n.id, n.cpus.size());
+        std::fprintf(out, ", %d thread%s\n", threads, threads == 1 ? "" : "s");
+        if (numa()) {
+            std::fprintf(out, "  threads %s:", pinned_ ? "pinned" : "NOT pinned (sched_setaffinity failed)");
+            for (int t = 0; t < threads; ++t)
+                std::fprintf(out, " t%d->cpu%d(node%d)", t, cpuOf(t, threads), nodes_[nodeOf(t, threads)].id);
+            std::fprintf(out, "\n");
+        } else {
+            std::fprintf(out, "  single node: no pinning, no first-touch partitioning\n");
+        }
+        region(out, what, bytes, bytes >= HugePages::kHuge ? (HugePages::Kind)HugePages::lastKind().load()
+                                                           : HugePages::Heap);
+    }
+    // 起動ログの 1 行（個体配列以外の大きな領域用．kind は確保したときに控えたもの）
+    void region(std::FILE* out, const char* what, size_t bytes, HugePages::Kind kind) const {
+        std::fprintf(out, "  %s: %.1f MiB, %s%s\n", what, bytes / 1048576.0, HugePages::name(kind),
+                     numa() ? ", first-touch partitioned per thread" : "");
+    }
+
+private:
+    std::vector<Node> nodes_;
+    bool pinned_{false};
+
+    static long pageSize() {
+#ifdef __linux__
+        const long s = sysconf(_SC_PAGESIZE);
+        return s > 0 ? s : 4096;
+#else
+        return 4096;
+#endif
+    }
+    static bool pinSelf(int cpu) {
+#ifdef __linux__
+        if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+    // "0-3,8-11" → {0,1,2,3,8,9,10,11}
+    static std::vector<int> parseList(const std::string& s) {
+        std::vector<int> v;
+        size_t i = 0;
+        while (i < s.size()) {
+            size_t j = s.find(',', i);
+            if (j == std::string::npos) j = s.size();
+            const std::string r = s.substr(i, j - i);
+            const size_t dash = r.find('-');
+            try {
+                if (!r.empty() && r[0] >= '0' && r[0] <= '9') {
+                    const int a = std::stoi(r);
+                    const int b = dash == std::string::npos ? a : std::stoi(r.substr(dash + 1));
+                    for (int c = a; c <= b; ++c) v.push_back(c);
+                }
+            } catch (...) {}
+            i = j + 1;
+        }
+        return v;
+    }
+    void detect() {
+#ifdef __linux__
+        std::ifstream on("/sys/devices/system/node/online");
+        std::string ids;
+        if (on) std::getline(on, ids);
+        for (int id : parseList(ids)) {
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string line;
+            if (f) std::getline(f, line);
+            std::vector<int> cpus = parseList(line);
+            if (!cpus.empty()) nodes_.push_back(Node{ id, std::move(cpus) });   // CPU のないメモリだけのノードは外す
+        }
+#endif
+        if (nodes_.empty()) {                            // 読めなければ全 CPU で 1 ノード
+            Node n{ 0, {} };
+            const int c = std::max(1u, std::thread::hardware_concurrency());
+            for (int k = 0; k < c; ++k) n.cpus.push_back(k);
+            nodes_.push_back(std::move(n));
+        }
+    }
+};
+
+#endif // __BOIDS_NUMA_HPP__
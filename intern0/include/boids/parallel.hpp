@@ -0,0 +1,102 @@
+// ------------------------------------------------------------
+// ThreadPool：常駐ワーカーによる静的分割の parallelFor
+//   parallelFor(n, f) は [0,n) をスレッド数ぶんの連続区間に分け，
+//   f(begin, end) を呼び出し元スレッドも含めて並列に実行する．
+//   ジョブは関数ポインタ + コンテキストで渡すのでヒープ確保なし．
+// ------------------------------------------------------------
+#ifndef __BOIDS_PARALLEL_HPP__
+#define __BOIDS_PARALLEL_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+class ThreadPool {
+public:
+    // threads: 呼び出し元を含む総スレッド数（0 なら hardware_concurrency）
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int t = 1; t < threads; ++t) workers_.emplace_back([this, t]{ workerLoop(t); });
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers_.size() + 1; }
+
+    template<class F>
+    void parallelFor(int n, F&& f) {
+        if (n <= 0) return;
+        const int T = std::min(size(), n);
+        if (T == 1) { f(0, n); return; }
+        struct Ctx { F* f; int n, T; } ctx{ &f, n, T };
+        run(T, [](void* p, int t){
+            Ctx& c = *static_cast<Ctx*>(p);
+            (*c.f)((int)((long long)c.n * t / c.T), (int)((long long)c.n * (t+1) / c.T));
+        }, &ctx);
+    }
+
+    // タスク t = 0..tasks-1 を各スレッドに 1 つずつ（t=0 は呼び出し元）
+    template<class F>
+    void forEachThread(int tasks, F&& f) {
+        tasks = std::min(tasks, size());
+        if (tasks <= 1) { if (tasks == 1) f(0); return; }
+        run(tasks, [](void* p, int t){ (*static_cast<F*>(p))(t); }, &f);
+    }
+
+private:
+    using Fn = void(*)(void*, int);
+
+    std::vector<std::thread> workers_;
+    std::mutex m_;
+    std::condition_variable cv_, done_;
+    Fn    fn_{nullptr};
+    void* ctx_{nullptr};
+    int   tasks_{0}, pending_{0};
+    unsigned gen_{0};
+    bool  quit_{false};
+
+    void run(int tasks, Fn fn, void* ctx) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            fn_ = fn; ctx_ = ctx; tasks_ = tasks;
+            pending_ = tasks - 1;
+            ++gen_;
+        }
+        cv_.notify_all();
+        fn(ctx, 0);
+        std::unique_lock<std::mutex> lk(m_);
+        done_.wait(lk, [this]{ return pending_ == 0; });
+    }
+
+    void workerLoop(int id) {
+        unsigned seen = 0;
+        for (;;) {
+            Fn fn; void* ctx;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                cv_.wait(lk, [&]{ return quit_ || gen_ != seen; });
+                if (quit_) return;
+                seen = gen_;
+                if (id >= tasks_) continue;
+                fn = fn_; ctx = ctx_;
+            }
+            fn(ctx, id);
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                if (--pending_ == 0) done_.notify_one();
+            }
+        }
+    }
+};
+
+#endif // __BOIDS_PARALLEL_HPP__
@@ -0,0 +1,149 @@
+// ------------------------------------------------------------
+// SlotMap<T>：詰めた配列 + 世代つきハンドル
+//   要素は dense() に隙間なく並び（走査はふつうの配列と同じ），
+//   外から持つ参照は Handle{slot, gen} にする．
+//     emplace   空きスロットを使い回して末尾に追加（O(1)）
+//     erase     末尾の要素を消した位置へ移して詰める（O(1)）
+//     get       世代が一致しなければ nullptr（消えた個体を指したままでも安全）
+//     permute   並べ替え（Morton 順など）してもハンドルは同じ要素を指す
+//     rebuild   dense() に詰め直した要素に，保存しておいたハンドルと空きリストを付け直す（復元用）
+//   reserve した容量を超えなければ，生まれて消える定常運転で再確保は起きない．
+//   要素のアドレスは erase / permute で変わるので，保持するのはハンドルだけにする
+//   Alloc は dense() の配列のアロケータ（大きな群れを huge page に置くときなど）
+// ------------------------------------------------------------
+#ifndef __BOIDS_SLOTMAP_HPP__
+#define __BOIDS_SLOTMAP_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <memory>
+#include <span>
+
+struct Handle {
+    uint32_t slot = ~0u;
+    uint32_t gen  = 0;
+    explicit operator bool() const { return slot != ~0u; }
+    bool operator==(const Handle&) const = default;
+};
+
+template<class T, class Alloc = std::allocator<T>>
+class SlotMap {
+public:
+    using Vector = std::vector<T, Alloc>;
+
+    void reserve(size_t n) { dense_.reserve(n); owner_.reserve(n); slots_.reserve(n); }
+
+    int  size()     const { return (int)dense_.size(); }
+    bool empty()    const { return dense_.empty(); }
+    size_t capacity() const { return dense_.capacity(); }
+
+    Vector&       dense()       { return dense_; }
+    const Vector& dense() const { return dense_; }
+    T&       operator[](int i)       { return dense_[i]; }
+    const T& operator[](int i) const { return dense_[i]; }
+
+    template<class... A>
+    Handle emplace(A&&... args) {
+        uint32_t s;
+        if (free_ != ~0u) {                    // 空きスロットの連結リストから
+            s = free_;
+            free_ = slots_[s].index;
+        } else {
+            s = (uint32_t)slots_.size();
+            slots_.push_back(Slot{});
+        }
+        slots_[s].index = (uint32_t)dense_.size();
+        dense_.emplace_back(std::forward<A>(args)...);
+        owner_.push_back(s);
+        return Handle{ s, slots_[s].gen };
+    }
+
+    // 消せたら true．消した位置 i に末尾の要素が来る（i == 旧 size-1 なら何も来ない）
+    bool erase(Handle h) {
+        const int i = indexOf(h);
+        if (i < 0) return false;
+        const int last = size() - 1;
+        if (i != last) {
+            dense_[i] = std::move(dense_[last]);
+            owner_[i] = owner_[last];
+            slots_[owner_[i]].index = (uint32_t)i;
+        }
+        dense_.pop_back();
+        owner_.pop_back();
+        Slot& sl = slots_[h.slot];
+        ++sl.gen;                              // 古いハンドルを無効に
+        sl.index = free_;
+        free_ = h.slot;
+        return true;
+    }
+
+    bool contains(Handle h) const { return indexOf(h) >= 0; }
+    int indexOf(Handle h) const {
+        if (h.slot >= slots_.size() || slots_[h.slot].gen != h.gen) return -1;
+        return (int)slots_[h.slot].index;
+    }
+    T*       get(Handle h)       { const int i = indexOf(h); return i < 0 ? nullptr : &dense_[i]; }
+    const T* get(Handle h) const { const int i = indexOf(h); return i < 0 ? nullptr : &dense_[i]; }
+
+    // 配列位置 i の要素のハンドル
+    Handle handleAt(int i) const { return Handle{ owner_[i], slots_[owner_[i]].gen }; }
+
+    // 新しい i 番目 = 元の order[i] 番目．scratch は作業用（中身は壊れる）
+    void permute(const std::vector<int>& order, Vector& scratch) {
+        const int n = size();
+        if (n == 0) return;
+        scratch.resize(n, dense_[0]);
+        ownerTmp_.resize(n);
+        for (int i = 0; i < n; ++i) {
+            scratch[i]   = dense_[order[i]];
+            ownerTmp_[i] = owner_[order[i]];
+        }
+        dense_.swap(scratch);
+        owner_.swap(ownerTmp_);
+        for (int i = 0; i < n; ++i) slots_[owner_[i]].index = (uint32_t)i;
+    }
+
+    // 空きリストを先頭から順に f(Handle{slot, 次に振る世代})（保存用．ヒープを使わない）
+    int freeCount() const { int k = 0; for (uint32_t s = free_; s != ~0u; s = slots_[s].index) ++k; return k; }
+    template<class F>
+    void forEachFree(F&& f) const { for (uint32_t s = free_; s != ~0u; s = slots_[s].index) f(Handle{ s, slots_[s].gen }); }
+
+    // dense() に要素を詰めた後で呼ぶ．live[i] は位置 i の要素のハンドル，freeList は forEachFree の順．
+    // slots_ / owner_ / 空きリストをその通りに組み直すので，以後の emplace は保存元と同じハンドルを返す．
+    // スロットが欠けている・重なっている・数が合わなければ false（要素も消して空に戻す）
+    bool rebuild(std::span<const Handle> live, std::span<const Handle> freeList) {
+        const size_t total = live.size() + freeList.size();
+        bool ok = live.size() == dense_.size();
+        slots_.assign(ok ? total : 0, Slot{ ~0u, 0 });
+        std::vector<char> used(slots_.size(), 0);
+        auto take = [&](Handle h, uint32_t index) {
+            if (h.slot >= slots_.size() || used[h.slot]) return false;
+            used[h.slot] = 1;
+            slots_[h.slot] = Slot{ index, h.gen };
+            return true;
+        };
+        owner_.clear();
+        for (size_t i = 0; ok && i < live.size(); ++i) {
+            ok = take(live[i], (uint32_t)i);
+            owner_.push_back(live[i].slot);
+        }
+        for (size_t k = 0; ok && k < freeList.size(); ++k)
+            ok = take(freeList[k], k + 1 < freeList.size() ? freeList[k + 1].slot : ~0u);
+        free_ = ok && !freeList.empty() ? freeList[0].slot : ~0u;
+        if (!ok) { dense_.clear(); owner_.clear(); slots_.clear(); }
+        return ok;
+    }
+
+private:
+    struct Slot {
+        uint32_t index = 0;    // 生きていれば dense_ の位置，空きなら次の空きスロット
+        uint32_t gen   = 0;
+    };
+    Vector                dense_;
+    std::vector<uint32_t> owner_, ownerTmp_;   // dense_ の位置 → スロット
+    std::vector<Slot>     slots_;
+    uint32_t free_{~0u};
+};
+
+#endif // __BOIDS_SLOTMAP_HPP__
@@ -0,0 +1,202 @@
+// ------------------------------------------------------------
+// ForkCheckpoint：fork() のコピーオンライトで止まらないチェックポイント
+//   ティックの終わりに fork し，子プロセスがその瞬間のメモリの像（COW）を
+//   ファイルに書いて終わる．親はすぐに次のティックへ戻るので，ループが止まるのは
+//   fork がページテーブルを複製する間だけ．代わりに親が書き換えたページは
+//   1 枚ずつ COW のページフォールトで複製される（子が生きている間）
+//     maxInFlight  同時に書いている子の上限．埋まっていればそのティックは見送る（skipped）
+//     useFork      false なら同じ書き出しをループの中で行う（比較用の同期チェックポイント）
+//   書き出しは dir/checkpoint-<tick>.bin.tmp に書いて fdatasync し，rename で置き換える
+//   （途中で落ちても読めるファイルは常に完全なもの）．
+//   子はヒープを使わない（スタック上の SnapshotWriter で write(2) を直接呼ぶ）．
+//   fork はティックの合間（ThreadPool の作業スレッドが止まっている間）に呼ぶこと
+//   親の記録も固定長の配列だけなので，チェックポイントでヒープ確保は起きない
+// ------------------------------------------------------------
+#ifndef __BOIDS_SNAPSHOT_HPP__
+#define __BOIDS_SNAPSHOT_HPP__
+
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ファイルの先頭
+struct SnapshotHeader {
+    char     magic[8] = { 'B', 'O', 'I', 'D', 'S', 'N', 'A', 'P' };
+    uint32_t version  = 2;
+    uint32_t dim      = 0;
+    uint64_t tick     = 0;
+    uint64_t count    = 0;          // 個体数
+    uint64_t agentBytes = 0;        // 1 体の大きさ（読み手の型と違えば読まない）
+    uint64_t freeSlots  = 0;        // 末尾の空きスロット（ハンドル）の数．版 2 から
+    bool valid() const { return std::memcmp(magic, "BOIDSNAP", 8) == 0 && version == 2; }
+};
+
+#ifdef __linux__
+
+// バッファ付きの write(2)（ヒープを使わない．子プロセスのスタックに置く）
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(int fd) : fd_(fd) {}
+    bool put(const void* data, size_t n) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0 && ok_) {
+            const size_t k = std::min(n, sizeof(buf_) - used_);
+            std::memcpy(buf_ + used_, p, k);
+            used_ += k; p += k; n -= k;
+            if (used_ == sizeof(buf_)) flush();
+        }
+        return ok_;
+    }
+    bool finish() { flush(); return ok_ && fdatasync(fd_) == 0; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    int      fd_;
+    bool     ok_{true};
+    size_t   used_{0};
+    uint64_t bytes_{0};
+    char     buf_[1 << 16];
+
+    void flush() {
+        const char* p = buf_;
+        while (used_ > 0 && ok_) {
+            const ssize_t k = ::write(fd_, p, used_);
+            if (k <= 0) { ok_ = false; break; }
+            p += k; used_ -= (size_t)k; bytes_ += (uint64_t)k;
+        }
+        used_ = 0;
+    }
+};
+
+class ForkCheckpoint {
+public:
+    static constexpr int kMaxChildren = 8;
+
+    bool enabled     = false;
+    bool useFork     = true;
+    int  period      = 100;         // 何ティックごとか
+    int  maxInFlight = 1;           // 1..kMaxChildren
+    std::string dir  = ".";
+
+    struct Stats {
+        int      taken = 0, done = 0, skipped = 0, failed = 0;
+        double   pauseMsMax = 0, pauseMsSum = 0;      // ループが止まった時間（fork または同期書き出し）
+        double   latencyMsMax = 0, latencyMsSum = 0;  // 開始からファイルができるまで
+        uint64_t parentFaults = 0;                    // 子が生きている間の親のページフォールト（≒ COW）
+        uint64_t childFaults  = 0;
+        uint64_t lastTick = 0;                        // 最後に書き終えたティック
+    };
+
+    ~ForkCheckpoint() { poll(true); }
+
+    bool due(uint64_t tick) const { return enabled && period > 0 && tick % (uint64_t)period == 0; }
+    int  inFlight() const { return live_; }
+    const Stats& stats() const { return stats_; }
+    void path(uint64_t tick, char* out, size_t n, bool tmp = false) const {
+        std::snprintf(out, n, "%s/checkpoint-%llu.bin%s", dir.c_str(), (unsigned long long)tick, tmp ? ".tmp" : "");
+    }
+
+    // tick の像を書き始める．write(SnapshotWriter&) → 成功か（子プロセスで呼ばれる）
+    // 上限まで子が走っていれば見送って false
+    template<class Write>
+    bool begin(uint64_t tick, Write&& write) {
+        poll(false);
+        if (useFork && live_ >= std::clamp(maxInFlight, 1, kMaxChildren)) { ++stats_.skipped; return false; }
+        const auto t0 = std::chrono::steady_clock::now();
+        if (!useFork) {
+            const bool ok = writeFile(tick, write);
+            const double ms = msSince(t0);
+            record(ok, ms, tick);
+            stats_.pauseMsMax = std::max(stats_.pauseMsMax, ms);
+            stats_.pauseMsSum += ms;
+            ++stats_.taken;
+            return ok;
+        }
+        const uint64_t faults = minorFaults();
+        const pid_t pid = fork();
+        if (pid < 0) { ++stats_.failed; return false; }
+        if (pid == 0) _exit(writeFile(tick, write) ? 0 : 1);
+        const double ms = msSince(t0);
+        stats_.pauseMsMax = std::max(stats_.pauseMsMax, ms);
+        stats_.pauseMsSum += ms;
+        ++stats_.taken;
+        for (Child& c : kids_) {
+            if (c.pid != 0) continue;
+            c = Child{ pid, tick, t0, faults };
+            ++live_;
+            break;
+        }
+        return true;
+    }
+
+    // 書き終えた子を回収する（wait = true なら全員を待つ）
+    void poll(bool wait) {
+        for (Child& c : kids_) {
+            if (c.pid == 0) continue;
+            int st = 0;
+            rusage ru{};
+            const pid_t r = wait4(c.pid, &st, wait ? 0 : WNOHANG, &ru);
+            if (r == 0) continue;
+            const bool ok = r == c.pid && WIFEXITED(st) && WEXITSTATUS(st) == 0;
+            stats_.parentFaults += minorFaults() - c.faults0;
+            stats_.childFaults  += (uint64_t)ru.ru_minflt;
+            record(ok, msSince(c.t0), c.tick);
+            c.pid = 0;
+            --live_;
+        }
+    }
+
+private:
+    struct Child {
+        pid_t    pid = 0;
+        uint64_t tick = 0;
+        std::chrono::steady_clock::time_point t0{};
+        uint64_t faults0 = 0;
+    };
+    Child kids_[kMaxChildren];
+    int   live_{0};
+    Stats stats_;
+
+    static double msSince(std::chrono::steady_clock::time_point t0) {
+        return 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    static uint64_t minorFaults() {
+        rusage ru{};
+        getrusage(RUSAGE_SELF, &ru);
+        return (uint64_t)ru.ru_minflt;
+    }
+    void record(bool ok, double latencyMs, uint64_t tick) {
+        if (!ok) { ++stats_.failed; return; }
+        ++stats_.done;
+        stats_.latencyMsMax = std::max(stats_.latencyMsMax, latencyMs);
+        stats_.latencyMsSum += latencyMs;
+        stats_.lastTick = std::max(stats_.lastTick, tick);
+    }
+    template<class Write>
+    bool writeFile(uint64_t tick, Write& write) const {
+        char tmp[512], fin[512];
+        path(tick, tmp, sizeof(tmp), true);
+        path(tick, fin, sizeof(fin));
+        const int fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        SnapshotWriter w(fd);
+        bool ok = write(w) && w.finish();
+        ok &= ::close(fd) == 0;
+        return ok && std::rename(tmp, fin) == 0;
+    }
+};
+
+#endif // __linux__
+
+#endif // __BOIDS_SNAPSHOT_HPP__
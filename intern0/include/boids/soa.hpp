@@ -0,0 +1,160 @@
+// ------------------------------------------------------------
+// SoATail：力を集めた後の個体ごとの後処理を SoA の 1 パスで
+//   壁バネ → a = (F - D v)/M → |a| 制限 → v += a dt → |v| 制限 → p += v dt → クランプ
+//   をすべて min/max と選択（三項演算子）で書き，分岐をなくしてある．
+//   x86-64 では SSE2 で 4 個体ずつ（sqrt/除算もベクトル命令，制限はマスク選択）処理し，
+//   分岐予測ミスで止まらない．-O2 の自動ベクトル化は sqrt の errno 処理と
+//   実行時の個体数のせいで効かないので，明示的に書いてある．
+//   式は Agent::accel / clipAce / clipVec / クランプと同じ（合力に壁を足す順だけ違う）．
+//   その順の違いで丸めが変わり，AoS の経路とビット単位では一致しないので既定は切ってある．
+//   |a| / |v| の長さは P（World の Behavior と同じ精度段階）で求め，段階が混ざらないようにする
+// ------------------------------------------------------------
+#ifndef __BOIDS_SOA_HPP__
+#define __BOIDS_SOA_HPP__
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "vec.hpp"
+
+// x86-64 なら SSE2 は常にある．それ以外はスカラー版（式は同じ）
+#if defined(__SSE2__) || defined(_M_X64)
+#define BOIDS_SOA_SSE 1
+#include <emmintrin.h>
+#else
+#define BOIDS_SOA_SSE 0
+#endif
+
+template<int D, Precision P = BOIDS_PRECISION>
+class SoATail {
+public:
+    bool enabled = false;                          // --soa で入れる
+
+    // 成分 k の配列（World が AoS から詰めて，run 後に書き戻す）
+    std::vector<float> p[D], v[D], f[D], a[D];
+    // 個体ごとの定数（種から引いたもの）
+    std::vector<float> invM, damp, vmax, amax, kwall, rad;
+
+    void resize(int n) {
+        for (int k = 0; k < D; ++k) { p[k].resize(n); v[k].resize(n); f[k].resize(n); a[k].resize(n); }
+        invM.resize(n); damp.resize(n); vmax.resize(n); amax.resize(n); kwall.resize(n); rad.resize(n);
+    }
+
+    // f には壁以外の合力が入っている前提．wall = false なら壁バネを足さない
+    void run(int n, float dt, const Vec<D>& world, bool wall) {
+        if (wall) runImpl<true>(n, dt, world);
+        else      runImpl<false>(n, dt, world);
+    }
+
+private:
+    static constexpr float margin = 10.f;
+
+    // 長さ sqrt(r2)：vec.hpp の norm<P> と同じ式
+    static float len(float r2) {
+        if constexpr (P == Precision::Exact) return std::sqrt(r2);
+        else return (r2 > 0.f) ? r2 * rsqrt<P>(r2) : 0.f;
+    }
+
+    template<bool Wall>
+    void runImpl(int n, float dt, const Vec<D>& world) {
+        int i = 0;
+#if BOIDS_SOA_SSE
+        for (; i + 4 <= n; i += 4) lanes4<Wall>(i, dt, world);
+#endif
+        for (; i < n; ++i) scalar<Wall>(i, dt, world);
+    }
+
+    // 1 個体（端数と SSE のない環境用）
+    template<bool Wall>
+    void scalar(int i, float dt, const Vec<D>& world) {
+        float ai[D], vi[D];
+        float a2 = 0.f;
+        for (int k = 0; k < D; ++k) {
+            const float x = p[k][i];
+            float fk = f[k][i];
+            if constexpr (Wall)
+                fk += kwall[i] * (std::max(0.f, margin - x) - std::max(0.f, x - (world[k] - margin)));
+            ai[k] = (fk - v[k][i] * damp[i]) * invM[i];
+            a2 += ai[k] * ai[k];
+        }
+        const float an = len(a2);
+        const float sa = (an > amax[i]) ? amax[i] / (an + 1e-6f) : 1.f;
+        float v2 = 0.f;
+        for (int k = 0; k < D; ++k) {
+            ai[k] *= sa;
+            vi[k] = v[k][i] + ai[k] * dt;
+            v2 += vi[k] * vi[k];
+        }
+        const float vn = len(v2);
+        const float sv = (vn > vmax[i]) ? vmax[i] / (vn + 1e-6f) : 1.f;
+        for (int k = 0; k < D; ++k) {
+            const float w = vi[k] * sv;
+            p[k][i] = std::min(std::max(p[k][i] + w * dt, rad[i]), world[k] - rad[i]);
+            v[k][i] = w;
+            a[k][i] = ai[k];
+        }
+    }
+
+#if BOIDS_SOA_SSE
+    // 4 個体ずつ．制限は「超えたレーンだけ係数を差し替える」マスク選択
+    static __m128 select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+    static __m128 limitScale(__m128 n, __m128 m) {
+        const __m128 s = _mm_div_ps(m, _mm_add_ps(n, _mm_set1_ps(1e-6f)));
+        return select(_mm_cmpgt_ps(n, m), s, _mm_set1_ps(1.f));
+    }
+    // len の 4 レーン版（rsqrtps はレーンごとに rsqrtss と同じ値を返す．r2 = 0 のレーンは 0）
+    static __m128 len4(__m128 r2) {
+        if constexpr (P == Precision::Exact) {
+            return _mm_sqrt_ps(r2);
+        } else {
+            __m128 y = _mm_rsqrt_ps(r2);
+            if constexpr (P == Precision::Newton)
+                y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f),
+                        _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r2), y), y)));
+            return select(_mm_cmpgt_ps(r2, _mm_setzero_ps()), _mm_mul_ps(r2, y), _mm_setzero_ps());
+        }
+    }
+
+    template<bool Wall>
+    void lanes4(int i, float dt, const Vec<D>& world) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 vdt  = _mm_set1_ps(dt);
+        const __m128 iM = _mm_loadu_ps(&invM[i]);
+        const __m128 dm = _mm_loadu_ps(&damp[i]);
+        const __m128 r  = _mm_loadu_ps(&rad[i]);
+        __m128 ai[D], vi[D];
+        __m128 a2 = zero;
+        for (int k = 0; k < D; ++k) {
+            __m128 fk = _mm_loadu_ps(&f[k][i]);
+            if constexpr (Wall) {
+                const __m128 x  = _mm_loadu_ps(&p[k][i]);
+                const __m128 lo = _mm_max_ps(zero, _mm_sub_ps(_mm_set1_ps(margin), x));
+                const __m128 hi = _mm_max_ps(zero, _mm_sub_ps(x, _mm_set1_ps(world[k] - margin)));
+                fk = _mm_add_ps(fk, _mm_mul_ps(_mm_loadu_ps(&kwall[i]), _mm_sub_ps(lo, hi)));
+            }
+            ai[k] = _mm_mul_ps(_mm_sub_ps(fk, _mm_mul_ps(_mm_loadu_ps(&v[k][i]), dm)), iM);
+            a2 = _mm_add_ps(a2, _mm_mul_ps(ai[k], ai[k]));
+        }
+        const __m128 sa = limitScale(len4(a2), _mm_loadu_ps(&amax[i]));
+        __m128 v2 = zero;
+        for (int k = 0; k < D; ++k) {
+            ai[k] = _mm_mul_ps(ai[k], sa);
+            vi[k] = _mm_add_ps(_mm_loadu_ps(&v[k][i]), _mm_mul_ps(ai[k], vdt));
+            v2 = _mm_add_ps(v2, _mm_mul_ps(vi[k], vi[k]));
+        }
+        const __m128 sv = limitScale(len4(v2), _mm_loadu_ps(&vmax[i]));
+        for (int k = 0; k < D; ++k) {
+            const __m128 w = _mm_mul_ps(vi[k], sv);
+            const __m128 x = _mm_add_ps(_mm_loadu_ps(&p[k][i]), _mm_mul_ps(w, vdt));
+            const __m128 c = _mm_min_ps(_mm_max_ps(x, r), _mm_sub_ps(_mm_set1_ps(world[k]), r));
+            _mm_storeu_ps(&p[k][i], c);
+            _mm_storeu_ps(&v[k][i], w);
+            _mm_storeu_ps(&a[k][i], ai[k]);
+        }
+    }
+#endif
+};
+
+#endif // __BOIDS_SOA_HPP__
@@ -0,0 +1,74 @@
+// ------------------------------------------------------------
+// SpeciesTable：種ごとのゲインと種間の相互作用行列
+//   params[s]         種 s のマス・ダンパ定数，Boids ゲイン，制限
+//   flocks(s, t)      t を「仲間」として分離・整列・凝集に数えるか
+//   interact(s, t)    t への追従(+) / 逃避(-) ゲイン（0 なら無視）
+//   mask(s)           s が知覚する必要のある種のビット集合
+//                     （近傍格子は種ごとに並べてあるので，この集合だけ走査する）
+//   最大 32 種（mask が 32bit）
+// ------------------------------------------------------------
+#ifndef __BOIDS_SPECIES_HPP__
+#define __BOIDS_SPECIES_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+struct SpeciesParams {
+    // 物理パラメータ（マス・ダンパ）
+    float M = 1.0f;   // 質量
+    float D = 1.0f;   // 粘性係数（減衰）
+
+    // Boids ゲイン
+    float k_sep  = 4.f;
+    float k_ali  = 10.f;
+    float k_coh  = 2.f;
+    float k_wall = 2.f;
+    float k_ran  = 10.f;
+    float k_goal = 60.f;
+
+    // 制限
+    float Vmax = 100.f;
+    float Amax = 100.f;
+};
+
+class SpeciesTable {
+public:
+    static constexpr int MAX_SPECIES = 32;
+
+    explicit SpeciesTable(int count = 1) { resize(count); }
+
+    // 既定：各種は自分の種とだけ群れ，他種とは相互作用なし
+    void resize(int count) {
+        assert(count >= 1 && count <= MAX_SPECIES);
+        S_ = count;
+        params_.assign(S_, SpeciesParams{});
+        flocks_.assign(S_*S_, 0);
+        interact_.assign(S_*S_, 0.f);
+        for (int s = 0; s < S_; ++s) flocks_[s*S_ + s] = 1;
+    }
+
+    int  count() const { return S_; }
+    SpeciesParams&       params(int s)       { return params_[s]; }
+    const SpeciesParams& params(int s) const { return params_[s]; }
+
+    bool  flocks  (int s, int t) const { return flocks_[s*S_ + t] != 0; }
+    float interact(int s, int t) const { return interact_[s*S_ + t]; }
+    void  setFlocks  (int s, int t, bool on) { flocks_[s*S_ + t] = on ? 1 : 0; }
+    void  setInteract(int s, int t, float k) { interact_[s*S_ + t] = k; }
+
+    uint32_t mask(int s) const {
+        uint32_t m = 0;
+        for (int t = 0; t < S_; ++t)
+            if (flocks(s, t) || interact(s, t) != 0.f) m |= 1u << t;
+        return m;
+    }
+
+private:
+    int S_{1};
+    std::vector<SpeciesParams> params_;
+    std::vector<uint8_t>       flocks_;
+    std::vector<float>         interact_;
+};
+
+#endif // __BOIDS_SPECIES_HPP__
@@ -0,0 +1,163 @@
+// ------------------------------------------------------------
+// StealScheduler：見積もりコストで区間タスクに分け，ワークスティーリングで回す
+//   群れは固まるので，個体やセルを等分するとスレッドによって近傍対の数が
+//   何十倍も違う．ここでは
+//     1. plan()  項目（格子のセル）ごとの見積もりコストの前置和で [0, items) を
+//                ほぼ等コストの連続区間タスクに切り，スレッドごとに連続して配る
+//     2. run()   各スレッドは自分の列を先頭から取り（空間的に近い順），
+//                空になったら他のスレッドの列の末尾から盗む
+//   の 2 段で回す．列は区間 [head, tail) + 小さな mutex（タスクは粗いので十分）．
+//   f(t, k, begin, end)（k はタスク番号）は実際に行った仕事量（近傍候補の数など）を返し，
+//   スレッドごとの仕事量の max / mean を不均衡比として last() に残す
+//   比較用に stealing = false で見積もりだけの静的分割，
+//   さらに weighted = false で項目数の等分（従来の静的分割）にできる
+// ------------------------------------------------------------
+#ifndef __BOIDS_STEAL_HPP__
+#define __BOIDS_STEAL_HPP__
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include "parallel.hpp"
+
+class StealScheduler {
+public:
+    bool stealing      = true;
+    bool weighted      = true;      // false なら cost を使わず項目数で切る
+    int  tasksPerThread = 8;        // 1 スレッドあたりのタスク数の目安（盗む単位の細かさ）
+
+    struct Stats {
+        int    threads   = 0;       // 0 なら直前のティックは並列に回していない
+        int    tasks     = 0;
+        int    stolen    = 0;       // 持ち主以外が実行したタスク数
+        double imbalance = 1;       // スレッドごとの仕事量の max / mean
+        double busyImbalance = 1;   // 同じく所要時間の max / mean
+        uint64_t work    = 0;       // 全スレッドの仕事量の和
+    };
+
+    struct Task { int begin, end; };
+
+    // items 個の項目を cost(i) の見積もりでタスクに切る（threads は実行に使うスレッド数）
+    template<class CostFn>
+    void plan(int items, int threads, CostFn&& cost) {
+        threads_ = std::max(1, threads);
+        cum_.resize(items + 1);
+        cum_[0] = 0;
+        for (int i = 0; i < items; ++i) cum_[i+1] = cum_[i] + (weighted ? (double)cost(i) : 0.0) + 1e-3;   // 空の項目も少しは掛かる
+        const double total = cum_[items];
+        const int want = std::max(1, std::min(items, threads_ * std::max(1, tasksPerThread)));
+        // 前置和が total*k/want に届く位置で切る
+        tasks_.clear();
+        for (int b = 0, k = 1; b < items; ++k) {
+            int e = items;
+            if (k < want)
+                e = std::min(items, (int)(std::lower_bound(cum_.begin() + b + 1, cum_.end(), total * k / want) - cum_.begin()));
+            tasks_.push_back(Task{ b, e });
+            b = e;
+        }
+        // スレッド t には，コストの中点が [total*t/T, total*(t+1)/T) に入るタスクを（連続区間）
+        const int nt = (int)tasks_.size();
+        owner_.resize(nt);
+        for (int k = 0; k < nt; ++k) {
+            const double mid = 0.5 * (cum_[tasks_[k].begin] + cum_[tasks_[k].end]);
+            owner_[k] = std::min(threads_ - 1, (int)(mid / total * threads_));
+        }
+        deques_.resize(threads_);
+        for (int t = 0, k = 0; t < threads_; ++t) {
+            deques_[t].head = k;
+            while (k < nt && owner_[k] == t) ++k;
+            deques_[t].tail = k;
+        }
+    }
+
+    // 計画したタスクを pool で実行．f(t, k, begin, end) → 仕事量
+    template<class F>
+    void run(ThreadPool& pool, F&& f) {
+        const int T = std::min(threads_, pool.size());
+        work_.assign(threads_, 0);
+        busy_.assign(threads_, 0.0);
+        stolen_.assign(threads_, 0);
+        pool.forEachThread(T, [&](int t){
+            const auto t0 = std::chrono::steady_clock::now();
+            // プールが計画より小さければ，あぶれた列は盗まれるのを待つ
+            for (int k; (k = popOwn(t)) >= 0; )
+                work_[t] += f(t, k, tasks_[k].begin, tasks_[k].end);
+            if (stealing || T < threads_) {
+                for (int k; (k = steal(t)) >= 0; ) {
+                    work_[t] += f(t, k, tasks_[k].begin, tasks_[k].end);
+                    ++stolen_[t];
+                }
+            }
+            busy_[t] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        });
+        summarize(T);
+    }
+
+    const Stats& last() const { return last_; }
+    void clearLast() { last_ = Stats{}; }        // 直列で回したティック（threads = 0）
+    const std::vector<Task>& tasks() const { return tasks_; }
+
+private:
+    struct alignas(64) Deque {
+        std::mutex m;
+        std::atomic<int> head{0}, tail{0};      // 書き換えは m の下，盗む先選びだけロックなしで読む
+        Deque() = default;
+        Deque(Deque&&) noexcept {}                // resize 用（中身は plan が作り直す）
+    };
+    std::vector<double>   cum_;
+    std::vector<Task>     tasks_;
+    std::vector<int>      owner_;
+    std::vector<Deque>    deques_;
+    std::vector<uint64_t> work_;
+    std::vector<double>   busy_;
+    std::vector<int>      stolen_;
+    int   threads_{1};
+    Stats last_;
+
+    int popOwn(int t) {
+        Deque& d = deques_[t];
+        std::lock_guard<std::mutex> lk(d.m);
+        const int k = d.head;
+        if (k >= d.tail) return -1;
+        d.head = k + 1;
+        return k;
+    }
+    // 残りの多そうな列（残数最大）の末尾から 1 つ
+    int steal(int t) {
+        for (;;) {
+            int victim = -1, most = 0;
+            for (int v = 0; v < threads_; ++v) {
+                if (v == t) continue;
+                const int left = deques_[v].tail - deques_[v].head;   // 目安（ロックなしの読み）
+                if (left > most) { most = left; victim = v; }
+            }
+            if (victim < 0) return -1;
+            Deque& d = deques_[victim];
+            std::lock_guard<std::mutex> lk(d.m);
+            const int k = d.tail - 1;
+            if (k >= d.head) { d.tail = k; return k; }
+        }
+    }
+    void summarize(int T) {
+        Stats s;
+        s.threads = T;
+        s.tasks   = (int)tasks_.size();
+        uint64_t wmax = 0;
+        double   bmax = 0, bsum = 0;
+        for (int t = 0; t < T; ++t) {
+            s.work += work_[t];
+            wmax = std::max(wmax, work_[t]);
+            bmax = std::max(bmax, busy_[t]);
+            bsum += busy_[t];
+            s.stolen += stolen_[t];
+        }
+        s.imbalance     = s.work > 0 ? (double)wmax * T / (double)s.work : 1.0;
+        s.busyImbalance = bsum > 0 ? bmax * T / bsum : 1.0;
+        last_ = s;
+    }
+};
+
+#endif // __BOIDS_STEAL_HPP__
@@ -0,0 +1,420 @@
+// ------------------------------------------------------------
+// 外部記憶（ディスク）に置いたチャンクを順に流すための入出力と，それで回す World（BasicStreamWorld，末尾）
+//   MappedChunk  チャンクファイルを読み取り専用で mmap し，MADV_SEQUENTIAL で
+//                先読みを大きく・読んだページを早めに手放すよう伝える．
+//                close(drop) で POSIX_FADV_DONTNEED（ページキャッシュからも落とす）
+//   ChunkWriter  先頭から順に書くだけ（ブロックにまとめて write）．
+//                close(drop) は fdatasync してからページキャッシュを落とす
+//   Prefetcher   別スレッドで readahead() を掛け，次に使うチャンクを
+//                計算の裏でページキャッシュへ読み込ませる
+//   drop = true なら次のティックでも必ずディスクから読み直すので，
+//   メモリに載るのは窓の数チャンクぶんだけになる（RAM より大きな群れ用）
+// ------------------------------------------------------------
+#ifndef __BOIDS_STREAM_HPP__
+#define __BOIDS_STREAM_HPP__
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <span>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include "vec.hpp"
+#include "grid.hpp"
+#include "species.hpp"
+#include "flowfield.hpp"
+#include "integrator.hpp"
+#include "determinism.hpp"
+#include "domain.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class MappedChunk {
+public:
+    MappedChunk() = default;
+    ~MappedChunk() { close(false); }
+    MappedChunk(const MappedChunk&) = delete;
+    MappedChunk& operator=(const MappedChunk&) = delete;
+
+    bool open(const std::string& path) {
+        close(false);
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) { std::perror(path.c_str()); return false; }
+        struct stat st{};
+        if (fstat(fd_, &st) != 0) { std::perror("fstat"); close(false); return false; }
+        bytes_ = (size_t)st.st_size;
+        if (bytes_ == 0) return true;                  // 空のチャンク
+        void* p = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED) { std::perror("mmap"); close(false); return false; }
+        data_ = p;
+        madvise(data_, bytes_, MADV_SEQUENTIAL);
+        return true;
+    }
+    void close(bool drop) {
+        if (data_) munmap(data_, bytes_);
+        if (fd_ >= 0) {
+            if (drop) posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd_);
+        }
+        data_ = nullptr; fd_ = -1; bytes_ = 0;
+    }
+    bool   isOpen() const { return fd_ >= 0; }
+    size_t bytes()  const { return bytes_; }
+    template<class T>
+    std::span<const T> as() const { return { static_cast<const T*>(data_), bytes_ / sizeof(T) }; }
+
+private:
+    int    fd_{-1};
+    void*  data_{nullptr};
+    size_t bytes_{0};
+};
+
+class ChunkWriter {
+public:
+    static constexpr size_t kBlock = size_t(4) << 20;  // 1 回の write の大きさ
+
+    ChunkWriter() { buf_.reserve(kBlock); }
+    ~ChunkWriter() { close(false); }
+    ChunkWriter(const ChunkWriter&) = delete;
+    ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+    bool open(const std::string& path) {
+        close(false);
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) { std::perror(path.c_str()); return false; }
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        ok_ = true;
+        return true;
+    }
+    void write(const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        while (n > 0) {
+            const size_t k = std::min(n, kBlock - buf_.size());
+            buf_.insert(buf_.end(), p, p + k);
+            p += k; n -= k;
+            if (buf_.size() == kBlock) flush();
+        }
+    }
+    bool close(bool drop) {
+        if (fd_ < 0) return ok_;
+        flush();
+        if (drop) {
+            ok_ &= fdatasync(fd_) == 0;                // 汚れたページは DONTNEED で落ちないので先に書く
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        ::close(fd_);
+        fd_ = -1;
+        return ok_;
+    }
+    uint64_t written() const { return written_; }
+
+private:
+    int  fd_{-1};
+    bool ok_{true};
+    uint64_t written_{0};
+    std::vector<unsigned char> buf_;
+
+    void flush() {
+        const unsigned char* p = buf_.data();
+        size_t n = buf_.size();
+        while (n > 0 && ok_) {
+            const ssize_t k = ::write(fd_, p, n);
+            if (k <= 0) { std::perror("write"); ok_ = false; break; }
+            p += k; n -= (size_t)k;
+            written_ += (uint64_t)k;
+        }
+        buf_.clear();
+    }
+};
+
+class Prefetcher {
+public:
+    Prefetcher() : worker_([this]{ loop(); }) {}
+    ~Prefetcher() {
+        { std::lock_guard<std::mutex> lk(m_); quit_ = true; }
+        cv_.notify_one();
+        worker_.join();
+    }
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    void request(const std::string& path) {
+        { std::lock_guard<std::mutex> lk(m_); queue_.push_back(path); }
+        cv_.notify_one();
+    }
+    // 裏で読み込んだバイト数・掛かった時間（計算と重なっている）
+    uint64_t bytes()   const { std::lock_guard<std::mutex> lk(m_); return bytes_; }
+    double   seconds() const { std::lock_guard<std::mutex> lk(m_); return sec_; }
+
+private:
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    bool     quit_{false};
+    uint64_t bytes_{0};
+    double   sec_{0};
+    std::thread worker_;                               // 最後に初期化（ほかのメンバが揃ってから走る）
+
+    void loop() {
+        for (;;) {
+            std::string path;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                cv_.wait(lk, [&]{ return quit_ || !queue_.empty(); });
+                if (quit_) return;
+                path = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            const auto t0 = std::chrono::steady_clock::now();
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) continue;
+            struct stat st{};
+            size_t n = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+            // readahead() は読み終わるまで戻らないので，このスレッドが待つ（計算側は待たない）
+            if (n > 0 && readahead(fd, 0, n) != 0) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+            std::lock_guard<std::mutex> lk(m_);
+            bytes_ += n;
+            sec_   += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+    }
+};
+
+// ------------------------------------------------------------
+// BasicStreamWorld：RAM に載らない群れをディスク上の x 方向のチャンクで回す
+//   Record はチャンクファイルに並べる 1 体の記録（BasicDomainWorld と同じ．kadai_2C の AgentRec）
+//   状態はチャンクごとのファイル（Record を ID 順）に置き，世代 g を読んで g+1 を書く．
+//   1 ティックはチャンクを左から順に 1 回なめる
+//     1. 窓   チャンク k-1, k, k+1 を mmap（k+2 は Prefetcher が裏で先読み）
+//     2. 知覚 k の全員 + 両隣の境界から視野半径以内（ハロー）を ID 順に並べ，
+//             窓の分だけの格子（setWindow）で k の個体の近傍を集める
+//     3. 力   k の個体を進め，出た個体は隣のチャンク行きに分ける
+//     4. 書出 k-1 の新しい状態は k の左行きが揃った時点で確定するので，1 チャンク遅れで順に書く
+//   ハローは読む側の世代（g）から取るので同時刻参照になり，並び・乱数（系列 = ID）も
+//   BasicDomainWorld と同じく 1 プロセスの World（決定的モード・SoA なし・接触なし・ゴールなし）と一致する．
+//   チャンクの幅は視野半径以上（ハローが隣で足りる・1 ティックで隣より遠くへは行かない）
+// ------------------------------------------------------------
+template<class Record, class Integrator = SemiImplicitEuler>
+class BasicStreamWorld {
+public:
+    using Rec   = Record;
+    using Agent = std::remove_cvref_t<decltype(std::declval<const Rec&>().agent())>;
+
+    struct Stats {
+        uint64_t bytesRead = 0, bytesWritten = 0, agentTicks = 0;
+        double   computeSec = 0, wallSec = 0;
+        size_t   windowPeak = 0;         // 窓に載った個体数の最大（自分 + ハロー）
+    };
+
+    BasicStreamWorld(const std::string& dir, float W, float H, int chunks, float viewRadius)
+        : dir_(dir), world_{W, H}, chunks_(std::max(1, chunks)),
+          grid_(world_, viewRadius * 0.5f), halo_(viewRadius) { det_.enabled = true; }
+
+    SpeciesTable&  species() { return species_; }
+    Deterministic& deterministic() { return det_; }
+    int  chunks() const { return chunks_; }
+    Strip chunk(int k) const { return Strip(k, chunks_, world_.x); }
+    bool dropCache = false;              // 読み書きしたチャンクをページキャッシュから落とす（毎ティック実際に読む）
+    const Stats& stats() const { return stats_; }
+    const Prefetcher& prefetcher() const { return prefetch_; }
+    uint32_t tick() const { return tick_; }
+    std::string path(uint32_t gen, int k) const {
+        return dir_ + "/g" + std::to_string(gen & 1) + "_c" + std::to_string(k) + ".bin";
+    }
+
+    // 初期状態を世代 0 のファイルに：チャンク k に ID [N*k/C, N*(k+1)/C) を一様に置く．
+    // 位置・向きは (ID, 負のティック) のカウンタ型乱数から（全体を覚えずにチャンクごとに作れる）
+    static Agent initial(const Deterministic& det, uint64_t id, const Strip& c, float H, float viewRadius) {
+        const Vec2 p{ c.x0 + det.uniform(id, ~0u, 0) * (c.x1 - c.x0), det.uniform(id, ~0u, 1) * H };
+        return Agent(p, Agent::randomDir(RandomDraw{ &det, id, ~0u - 1 }) * 40.f, 3.f, viewRadius);
+    }
+    bool generate(uint64_t N) {
+        ChunkWriter w;
+        bool ok = true;
+        for (int k = 0; k < chunks_; ++k) {
+            if (!w.open(path(0, k))) return false;
+            const Strip c = chunk(k);
+            for (uint64_t id = N * k / chunks_; id < N * (k + 1) / chunks_; ++id) {
+                const Rec r = Rec::of(id, initial(det_, id, c, world_.y, halo_));
+                w.write(&r, sizeof(r));
+            }
+            ok &= w.close(dropCache);
+        }
+        tick_ = 0;
+        return ok;
+    }
+
+    bool step(float dt) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const uint32_t g = tick_;
+        bool ok = true;
+        for (auto& m : win_) m.close(dropCache);
+        carry_.clear();
+        pending_.clear();
+        for (int k = 0; k < chunks_ && ok; ++k) {
+            // --- 1. 窓を 1 つ進める（k-2 を閉じて k+1 を開く） ---
+            if (k == 0) ok &= win_[0].open(path(g, 0));
+            if (k + 1 < chunks_) {
+                MappedChunk& m = win_[(k + 1) % 3];
+                m.close(dropCache);
+                ok &= m.open(path(g, k + 1));
+                stats_.bytesRead += m.bytes();
+            }
+            if (k == 0) stats_.bytesRead += win_[0].bytes();
+            if (k + 2 < chunks_) prefetch_.request(path(g, k + 2));
+            if (!ok) break;
+            const auto c0 = std::chrono::steady_clock::now();
+            const Strip c = chunk(k);
+            gather(k, c);
+            perceiveAndDrive(dt, c);
+            stats_.computeSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - c0).count();
+            // --- 4. k-1 を確定して書き出し，k を保留にする ---
+            if (k > 0) ok &= writeChunk(g + 1, k - 1, pending_, toL_);
+            mergeById(stay_, carry_, pending_);
+            carry_.swap(toR_);
+        }
+        if (ok) ok &= writeChunk(g + 1, chunks_ - 1, pending_, carry_);   // 右端は右へ出られない（壁）
+        for (auto& m : win_) m.close(dropCache);
+        ++tick_;
+        stats_.wallSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return ok;
+    }
+
+    // 現在の世代を ID 順に f(Rec) へ
+    template<class F>
+    bool forEach(F&& f) const {
+        std::vector<Rec> all;
+        for (int k = 0; k < chunks_; ++k) {
+            MappedChunk m;
+            if (!m.open(path(tick_, k))) return false;
+            for (const Rec& r : m.as<Rec>()) all.push_back(r);
+        }
+        std::sort(all.begin(), all.end(), [](const Rec& a, const Rec& b){ return a.id < b.id; });
+        for (const Rec& r : all) f(r);
+        return true;
+    }
+
+private:
+    std::string   dir_;
+    Vec2          world_;
+    int           chunks_;
+    SpatialGrid   grid_;
+    SpeciesTable  species_;
+    Deterministic det_;
+    float         halo_;
+    uint32_t      tick_{0};
+    Stats         stats_;
+    MappedChunk   win_[3];               // チャンク k は win_[k % 3]
+    Prefetcher    prefetch_;
+    ChunkWriter   writer_;
+
+    std::vector<Agent>    all_;
+    std::vector<uint64_t> allId_;
+    std::vector<int>      self_;         // all_ の中のチャンク k の個体（ID 順）
+    std::vector<Rec> stay_, toL_, toR_, carry_, pending_, out_;
+    std::vector<int>      nbrStart_, nbrIdx_;
+    std::vector<uint32_t> masks_;
+
+    std::span<const Rec> old(int k) const {
+        if (k < 0 || k >= chunks_) return {};
+        return win_[k % 3].as<Rec>();
+    }
+
+    // --- 2. 左ハロー・自分・右ハローを ID 順に all_ へ ---
+    void gather(int k, const Strip& c) {
+        const std::span<const Rec> L = old(k - 1), M = old(k), R = old(k + 1);
+        all_.clear(); allId_.clear(); self_.clear();
+        size_t a = 0, b = 0, d = 0;
+        auto skipL = [&]{ while (a < L.size() && L[a].p.x <  c.x0 - halo_) ++a; };
+        auto skipR = [&]{ while (d < R.size() && R[d].p.x >= c.x1 + halo_) ++d; };
+        skipL(); skipR();
+        for (;;) {
+            const uint64_t il = a < L.size() ? L[a].id : UINT64_MAX;
+            const uint64_t im = b < M.size() ? M[b].id : UINT64_MAX;
+            const uint64_t ir = d < R.size() ? R[d].id : UINT64_MAX;
+            if (il == UINT64_MAX && im == UINT64_MAX && ir == UINT64_MAX) break;
+            if (im < il && im < ir) {
+                self_.push_back((int)all_.size());
+                all_.push_back(M[b].agent()); allId_.push_back(im); ++b;
+            } else if (il < ir) {
+                all_.push_back(L[a].agent()); allId_.push_back(il); ++a; skipL();
+            } else {
+                all_.push_back(R[d].agent()); allId_.push_back(ir); ++d; skipR();
+            }
+        }
+        stats_.windowPeak = std::max(stats_.windowPeak, all_.size());
+        // 格子は窓（k-1 の右端 〜 k+1 の左端）のセルだけ．切り方は全体の格子と同じ
+        const float cell = grid_.cellSize();
+        const int   cols = std::max(1, (int)std::ceil(world_.x / cell));
+        const int first = std::clamp((int)(std::max(0.f, c.x0 - halo_) / cell), 0, cols - 1);
+        const int last  = std::clamp((int)((c.x1 + halo_) / cell), 0, cols - 1);
+        grid_.setWindow(0, first, last - first + 1);
+    }
+
+    // --- 2. 3. BasicDomainWorld::step と同じ手順 ---
+    void perceiveAndDrive(float dt, const Strip& c) {
+        const int n = (int)all_.size();
+        const int S = species_.count();
+        if (grid_.layers() != S) grid_.setLayers(S);
+        masks_.resize(S);
+        for (int s = 0; s < S; ++s) masks_[s] = species_.mask(s);
+        grid_.build(n, [&](int k){ return all_[k].pos(); }, [&](int k){ return all_[k].species(); });
+        nbrStart_.assign(1, 0);
+        nbrIdx_.clear();
+        for (int i : self_) {
+            const Vec2  p  = all_[i].pos();
+            const float vr = all_[i].viewRadius();
+            grid_.query(p, vr, masks_[all_[i].species()], [&](int j){
+                if (j == i) return;
+                const Vec2 r = all_[j].pos() - p;
+                if (dot(r, r) < vr*vr) nbrIdx_.push_back(j);
+            });
+            nbrStart_.push_back((int)nbrIdx_.size());
+        }
+        stay_.clear(); toL_.clear(); toR_.clear();
+        for (size_t k = 0; k < self_.size(); ++k) {
+            const std::span<const int> nb{ nbrIdx_.data() + nbrStart_[k], nbrIdx_.data() + nbrStart_[k+1] };
+            const int i = self_[k];
+            Agent a = all_[i];
+            a.template drive<Integrator>(dt, all_, nb, species_, world_, nullptr, 1,
+                                         RandomDraw{ &det_, allId_[i], tick_ });
+            const Rec r = Rec::of(allId_[i], a);
+            const float x = r.p.x;
+            if      (c.hasLeft()  && x <  c.x0) toL_.push_back(r);
+            else if (c.hasRight() && x >= c.x1) toR_.push_back(r);
+            else stay_.push_back(r);
+        }
+        stats_.agentTicks += self_.size();
+    }
+
+    static void mergeById(const std::vector<Rec>& a, const std::vector<Rec>& b, std::vector<Rec>& out) {
+        out.clear();
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out),
+                   [](const Rec& x, const Rec& y){ return x.id < y.id; });
+    }
+    // 保留していた k の新しい状態に右から来た個体を足して，先頭から順に書く
+    bool writeChunk(uint32_t gen, int k, const std::vector<Rec>& kept, const std::vector<Rec>& fromRight) {
+        mergeById(kept, fromRight, out_);
+        if (!writer_.open(path(gen, k))) return false;
+        if (!out_.empty()) writer_.write(out_.data(), out_.size() * sizeof(Rec));
+        stats_.bytesWritten += out_.size() * sizeof(Rec);
+        return writer_.close(dropCache);
+    }
+};
+
+#endif // __linux__
+
+#endif // __BOIDS_STREAM_HPP__
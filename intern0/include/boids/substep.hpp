@@ -0,0 +1,60 @@
+// ------------------------------------------------------------
+// AdaptiveStep：局所的な硬さからエージェントごとのサブステップ数を決める
+//   重なりかけた相手との分離力 k_sep (vr - d)/(d + ε) は d が小さいほど硬く
+//   （剛性 ~ k_sep vr/(d + ε)²），全体の dt をそれに合わせると疎な群れまで遅くなる．
+//   近傍から次の 3 つを見積もり，いちばん厳しい条件で n = ⌈dt/h⌉ を選ぶ．
+//     omega2   最大剛性 / M            → ω h ≤ courant
+//     closing  接近速度 / 距離 [1/s]   → closing h ≤ gap
+//     accel    |a| / 最接近距離 [1/s²] → accel h² ≤ gap
+//   穏やかな個体は n = 1 のまま大きな dt で進み，混み合った個体だけが刻む．
+// ------------------------------------------------------------
+#ifndef __BOIDS_SUBSTEP_HPP__
+#define __BOIDS_SUBSTEP_HPP__
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+// 1 個体ぶんの硬さの見積もり（Agent::stiffness が近傍から作る）
+struct Stiffness {
+    float omega2  = 0.f;
+    float closing = 0.f;
+    float accel   = 0.f;
+};
+
+class AdaptiveStep {
+public:
+    bool  enabled     = false;
+    int   maxSubsteps = 16;
+    float courant     = 0.5f;
+    float gap         = 0.25f;
+
+    struct Stats {
+        uint64_t agentTicks = 0;   // 評価した (個体, ティック) の数
+        uint64_t substeps   = 0;   // その合計サブステップ数
+        uint64_t refined    = 0;   // n > 1 になった (個体, ティック) の数
+        int      maxUsed    = 0;
+    };
+
+    int substeps(float dt, const Stiffness& s) const {
+        float n = 1.f;
+        n = std::max(n, dt * std::sqrt(s.omega2) / courant);
+        n = std::max(n, dt * s.closing / gap);
+        n = std::max(n, dt * std::sqrt(s.accel / gap));
+        return std::clamp((int)std::ceil(n), 1, maxSubsteps);
+    }
+
+    void record(int n) {
+        ++stats_.agentTicks;
+        stats_.substeps += n;
+        if (n > 1) ++stats_.refined;
+        stats_.maxUsed = std::max(stats_.maxUsed, n);
+    }
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = {}; }
+
+private:
+    Stats stats_;
+};
+
+#endif // __BOIDS_SUBSTEP_HPP__
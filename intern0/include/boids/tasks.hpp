@@ -0,0 +1,330 @@
+// ------------------------------------------------------------
+// 周期タスクのコルーチンスケジューラ（C++20）
+//   物理 100 Hz・入力 1 kHz・ログ 10 Hz・メトリクス 1 Hz のように周期の違う仕事を，
+//   1 本のスレッドでそれぞれ自分の期限まで眠らせて回す
+//     PeriodicTask  コルーチンの型．TaskLoop::spawn() に渡すと loop が持ち，終わったら破棄する
+//     Ticker        every(name, period) で作る．co_await t.next() が次の期限まで眠り，
+//                   ループが止まるときは false を返す（for (...; co_await t.next(); ) { ... }）
+//     TimerWheel    期限の入れ物（1 ms 刻み × 1024 枠のハッシュ化タイマーホイール）．
+//                   ノードは Ticker（＝コルーチンのフレーム）の中に置くので，差し込みで確保しない
+//     TaskLoop      いちばん早い期限まで sleep_until で眠り，期限の来たタスクを期限順に再開する．
+//                   スピンはしない（Linux ではタイマースラックを 1 ns にして起床の遅れを詰める）
+//   期限は位相を保つ（前の期限 + 周期．realign() で外の時刻に揃え直せる）．
+//   1 周期以上遅れたら溜めずに飛ばし，missed に数える．
+//   タスクごとに遅れ（期限から再開まで）と仕事の時間（再開から次の co_await まで）を記録する
+//   注意：コルーチンにしたラムダは，ループが終わるまで生きている名前付きの変数に置くこと
+//   （キャプチャはラムダ本体に残るので，一時オブジェクトから作るとぶら下がる）
+// ------------------------------------------------------------
+#ifndef __BOIDS_TASKS_HPP__
+#define __BOIDS_TASKS_HPP__
+
+#include <coroutine>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <exception>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+struct TimerNode {
+    std::chrono::steady_clock::time_point deadline{};
+    std::coroutine_handle<> h{};
+    int64_t    slotTick = 0;              // 入れた枠の通し番号（1 周より先の期限を見分ける）
+    int        order    = 0;              // 同じ期限どうしの順（spawn した順）
+    TimerNode* next     = nullptr;
+};
+
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int kSlots = 1024;
+    static constexpr Clock::duration kTick = std::chrono::milliseconds(1);
+
+    explicit TimerWheel(Clock::time_point origin = Clock::now()) : origin_(origin) {}
+
+    bool empty() const { return size_ == 0; }
+    int  size()  const { return size_; }
+
+    void insert(TimerNode* n) {
+        n->slotTick = std::max(tickOf(n->deadline), cursor_);   // 過ぎた期限は今の枠へ
+        TimerNode*& head = slots_[n->slotTick % kSlots];
+        n->next = head;
+        head = n;
+        ++size_;
+    }
+
+    // いちばん早い期限．今の枠から 1 周ぶんを順に見て，最初に当たった枠の最小
+    // （1 周より先にしかなければ全部を見る．空なら time_point::max()）
+    Clock::time_point next() const {
+        for (int k = 0; k < kSlots; ++k) {
+            const int64_t t = cursor_ + k;
+            Clock::time_point best = Clock::time_point::max();
+            for (const TimerNode* n = slots_[t % kSlots]; n; n = n->next)
+                if (n->slotTick == t) best = std::min(best, n->deadline);
+            if (best != Clock::time_point::max()) return best;
+        }
+        Clock::time_point best = Clock::time_point::max();
+        for (const TimerNode* head : slots_)
+            for (const TimerNode* n = head; n; n = n->next) best = std::min(best, n->deadline);
+        return best;
+    }
+
+    // now までに期限の来たノードを外し，(期限, order) の順に並べて返す（ready の連結リスト）
+    TimerNode* expire(Clock::time_point now) {
+        const int64_t last = tickOf(now);
+        TimerNode* ready = nullptr;
+        for (int64_t t = cursor_; t <= last && t < cursor_ + kSlots; ++t) {
+            TimerNode** link = &slots_[t % kSlots];
+            while (TimerNode* n = *link) {
+                if (n->slotTick <= last && n->deadline <= now) {
+                    *link = n->next;
+                    --size_;
+                    TimerNode** at = &ready;                    // 起きるのは数個なので挿入ソート
+                    while (*at && ((*at)->deadline < n->deadline ||
+                                   ((*at)->deadline == n->deadline && (*at)->order < n->order)))
+                        at = &(*at)->next;
+                    n->next = *at;
+                    *at = n;
+                } else {
+                    link = &n->next;
+                }
+            }
+        }
+        cursor_ = std::max(cursor_, last);             // 今の枠にはまだ先の期限が残りうる
+        return ready;
+    }
+
+    // 残っているノードを全部外す（止めるとき）
+    TimerNode* drain() {
+        TimerNode* all = nullptr;
+        for (TimerNode*& head : slots_)
+            while (TimerNode* n = head) { head = n->next; n->next = all; all = n; }
+        size_ = 0;
+        return all;
+    }
+
+private:
+    Clock::time_point origin_;
+    int64_t    cursor_{0};
+    int        size_{0};
+    TimerNode* slots_[kSlots] = {};
+
+    int64_t tickOf(Clock::time_point t) const {
+        return t <= origin_ ? 0 : (int64_t)((t - origin_) / kTick);
+    }
+};
+
+struct PeriodicTask {
+    struct promise_type {
+        PeriodicTask get_return_object() { return PeriodicTask{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }   // 走らせ始めるのは TaskLoop::run()
+        std::suspend_always final_suspend() noexcept { return {}; }     // 破棄するのも TaskLoop
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit PeriodicTask(std::coroutine_handle<promise_type> h) : h_(h) {}
+    PeriodicTask(PeriodicTask&& o) noexcept : h_(o.h_) { o.h_ = {}; }
+    PeriodicTask(const PeriodicTask&) = delete;
+    PeriodicTask& operator=(const PeriodicTask&) = delete;
+    ~PeriodicTask() { if (h_) h_.destroy(); }
+
+    std::coroutine_handle<promise_type> release() { auto h = h_; h_ = {}; return h; }
+
+private:
+    std::coroutine_handle<promise_type> h_;
+};
+
+class TaskLoop;
+
+// タスクごとの記録（遅れ・仕事の時間はマイクロ秒）
+struct TaskStats {
+    static constexpr int kBuckets = 24;            // 遅れのヒストグラム：[2^(k-1), 2^k) µs
+
+    const char* name = "";
+    std::chrono::steady_clock::duration period{};
+    uint64_t runs = 0, missed = 0;
+    double   lateSumUs = 0, lateMaxUs = 0;
+    double   busySumUs = 0, busyMaxUs = 0;
+    uint64_t hist[kBuckets] = {};
+
+    void record(double lateUs) {
+        ++runs;
+        lateSumUs += lateUs;
+        lateMaxUs  = std::max(lateMaxUs, lateUs);
+        int b = 0;
+        for (double v = lateUs; v >= 1.0 && b < kBuckets - 1; v *= 0.5) ++b;
+        ++hist[b];
+    }
+    void work(double busyUs) {
+        busySumUs += busyUs;
+        busyMaxUs  = std::max(busyMaxUs, busyUs);
+    }
+    double hz() const { return 1.0 / std::chrono::duration<double>(period).count(); }
+    double lateMeanUs() const { return runs ? lateSumUs / runs : 0.0; }
+    double busyMeanUs() const { return runs ? busySumUs / runs : 0.0; }
+    // 分位点（ヒストグラムの枠の上端なので高めに出る．ただし最大は超えない）
+    double latePercentileUs(double q) const {
+        const uint64_t want = (uint64_t)(q * runs);
+        uint64_t acc = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            acc += hist[b];
+            if (acc > want) return std::min(b == 0 ? 1.0 : (double)(1u << b), lateMaxUs);
+        }
+        return lateMaxUs;
+    }
+};
+
+class Ticker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Ticker(TaskLoop& loop, TaskStats& stats, Clock::time_point first, int order)
+        : loop_(&loop), stats_(&stats), deadline_(first), resumed_(first) { node_.order = order; }
+    Ticker(const Ticker&) = delete;
+    Ticker& operator=(const Ticker&) = delete;
+
+    struct Awaiter {
+        Ticker& t;
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> h) noexcept;
+        bool await_resume() noexcept;
+    };
+    // 次の期限まで眠る．ループが止まるなら false
+    Awaiter next() { return Awaiter{ *this }; }
+    Clock::time_point deadline() const { return deadline_; }
+    // 位相を合わせ直す：次の期限を anchor + 周期にする（垂直同期で戻った時刻に描画を揃えるなど）
+    void realign(Clock::time_point anchor) { deadline_ = anchor; }
+
+private:
+    TaskLoop*  loop_;
+    TaskStats* stats_;
+    TimerNode  node_;
+    Clock::time_point deadline_;                   // 次に起きる期限
+    Clock::time_point resumed_;                    // 前に再開した時刻（仕事の時間用）
+    bool       started_ = false;
+};
+
+class TaskLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TaskLoop() : origin_(Clock::now()), wheel_(origin_) {}
+    ~TaskLoop() { for (auto h : tasks_) h.destroy(); }
+    TaskLoop(const TaskLoop&) = delete;
+    TaskLoop& operator=(const TaskLoop&) = delete;
+
+    // 周期 period の Ticker（最初の期限はループの開始時刻）
+    template<class Rep, class Per>
+    Ticker every(const char* name, std::chrono::duration<Rep, Per> period) {
+        stats_.emplace_back();
+        TaskStats& s = stats_.back();
+        s.name   = name;
+        s.period = std::max<Clock::duration>(std::chrono::duration_cast<Clock::duration>(period), Clock::duration(1));
+        return Ticker(*this, s, origin_, (int)stats_.size() - 1);
+    }
+    void spawn(PeriodicTask&& t) { tasks_.push_back(t.release()); }
+    void stop() { stopping_ = true; }
+    bool stopping() const { return stopping_; }
+
+    const std::deque<TaskStats>& stats() const { return stats_; }
+    uint64_t sleeps() const { return sleeps_; }
+    uint64_t wakes()  const { return wakes_; }
+    double   seconds() const { return seconds_; }
+
+    // 全タスクが終わるか stop() まで回す
+    void run() {
+#ifdef __linux__
+        const int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+        prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);        // 既定 50 µs の起床の遅れを詰める
+#endif
+        const auto t0 = Clock::now();
+        origin_ = t0;
+        for (auto h : tasks_) if (!h.done()) h.resume();   // 最初の co_await まで（Ticker を作って眠る）
+        while (!stopping_ && !wheel_.empty()) {
+            const Clock::time_point when = wheel_.next();
+            Clock::time_point now = Clock::now();
+            if (when > now) {
+                std::this_thread::sleep_until(when);
+                ++sleeps_;
+                now = Clock::now();
+            }
+            TimerNode* ready = wheel_.expire(now);
+            while (ready) {
+                TimerNode* n = ready;
+                ready = n->next;
+                ++wakes_;
+                n->h.resume();
+            }
+        }
+        stopping_ = true;
+        for (TimerNode* n = wheel_.drain(); n; ) {     // 眠っているタスクに false を返して終わらせる
+            TimerNode* nx = n->next;
+            n->h.resume();
+            n = nx;
+        }
+        seconds_ = std::chrono::duration<double>(Clock::now() - t0).count();
+#ifdef __linux__
+        if (slack > 0) prctl(PR_SET_TIMERSLACK, (unsigned long)slack, 0, 0, 0);
+#endif
+    }
+
+    // タスクごとの表
+    void report(std::FILE* out) const {
+        std::fprintf(out, "tasks (%.1f s, %llu sleeps, %llu wakes):\n", seconds_,
+                     (unsigned long long)sleeps_, (unsigned long long)wakes_);
+        std::fprintf(out, "  %-10s %8s %8s %7s %12s %12s %12s %12s\n",
+                     "task", "Hz", "runs", "missed", "late mean", "late p99", "late max", "work mean");
+        for (const TaskStats& s : stats_)
+            std::fprintf(out, "  %-10s %8.0f %8llu %7llu %9.1f us %9.0f us %9.1f us %9.1f us\n",
+                         s.name, s.hz(), (unsigned long long)s.runs, (unsigned long long)s.missed,
+                         s.lateMeanUs(), s.latePercentileUs(0.99), s.lateMaxUs, s.busyMeanUs());
+    }
+
+private:
+    friend struct Ticker::Awaiter;
+    Clock::time_point origin_;
+    TimerWheel wheel_;
+    std::vector<std::coroutine_handle<>> tasks_;
+    std::deque<TaskStats> stats_;                  // Ticker が指すので deque（伸ばしても動かない）
+    bool     stopping_ = false;
+    uint64_t sleeps_ = 0, wakes_ = 0;
+    double   seconds_ = 0;
+};
+
+inline bool Ticker::Awaiter::await_ready() const noexcept { return t.loop_->stopping_; }
+
+inline void Ticker::Awaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    const auto now = Clock::now();
+    if (!t.started_) {
+        t.started_  = true;                        // 最初の期限はループの開始時刻
+        t.deadline_ = t.loop_->origin_;
+    } else {
+        t.stats_->work(1e6 * std::chrono::duration<double>(now - t.resumed_).count());
+        t.deadline_ += t.stats_->period;
+        if (now >= t.deadline_ + t.stats_->period) {   // 1 周期以上遅れた：溜めずに飛ばす
+            const auto skip = (now - t.deadline_) / t.stats_->period;
+            t.deadline_ += skip * t.stats_->period;
+            t.stats_->missed += (uint64_t)skip;
+        }
+    }
+    t.node_.deadline = t.deadline_;
+    t.node_.h        = h;
+    t.loop_->wheel_.insert(&t.node_);
+}
+
+inline bool Ticker::Awaiter::await_resume() noexcept {
+    if (t.loop_->stopping_) return false;
+    const auto now = Clock::now();
+    t.stats_->record(1e6 * std::chrono::duration<double>(now - t.deadline_).count());
+    t.resumed_ = now;
+    return true;
+}
+
+#endif // __BOIDS_TASKS_HPP__
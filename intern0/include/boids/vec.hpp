@@ -0,0 +1,114 @@
+// ------------------------------------------------------------
+// Vec<D> & helpers（kadai_2C と boids/ 以下のサブシステムで共用）
+//   D = 2, 3 をメンバ名つき（x, y[, z]）で特殊化し，演算はすべて
+//   コンパイル時に展開されるので Vec2 は従来の手書き版と同じコードになる．
+//   次元に依らない処理は v[k] と D で書く．
+// ------------------------------------------------------------
+#ifndef __BOIDS_VEC_HPP__
+#define __BOIDS_VEC_HPP__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BOIDS_VEC_SSE 1
+#include <xmmintrin.h>
+#else
+#define BOIDS_VEC_SSE 0
+#endif
+
+// 小さな演算は必ず展開させる（実体化が増えると -O2 の展開上限に当たり，
+// 近傍ループ内の +=, norm が関数呼び出しのまま残ることがある）
+#if defined(_MSC_VER)
+#define BOIDS_INLINE __forceinline
+#else
+#define BOIDS_INLINE inline __attribute__((always_inline))
+#endif
+
+template<int D> struct Vec;
+
+template<> struct Vec<2> {
+    static constexpr int dim = 2;
+    float x{0}, y{0};
+    Vec() = default;
+    Vec(float X, float Y): x(X), y(Y) {}
+    BOIDS_INLINE float& operator[](int k)       { return k == 0 ? x : y; }
+    BOIDS_INLINE float  operator[](int k) const { return k == 0 ? x : y; }
+};
+
+template<> struct Vec<3> {
+    static constexpr int dim = 3;
+    float x{0}, y{0}, z{0};
+    Vec() = default;
+    Vec(float X, float Y, float Z): x(X), y(Y), z(Z) {}
+    BOIDS_INLINE float& operator[](int k)       { return k == 0 ? x : (k == 1 ? y : z); }
+    BOIDS_INLINE float  operator[](int k) const { return k == 0 ? x : (k == 1 ? y : z); }
+};
+
+using Vec2 = Vec<2>;
+using Vec3 = Vec<3>;
+
+// 成分ごとの演算（D はコンパイル時定数なので for は展開される）
+template<int D> BOIDS_INLINE Vec<D> operator+(Vec<D> a, const Vec<D>& b){ for (int k=0;k<D;++k) a[k]+=b[k]; return a; }
+template<int D> BOIDS_INLINE Vec<D> operator-(Vec<D> a, const Vec<D>& b){ for (int k=0;k<D;++k) a[k]-=b[k]; return a; }
+template<int D> BOIDS_INLINE Vec<D> operator*(Vec<D> a, float s)        { for (int k=0;k<D;++k) a[k]*=s;    return a; }
+template<int D> BOIDS_INLINE Vec<D>& operator+=(Vec<D>& a, const Vec<D>& b){ for (int k=0;k<D;++k) a[k]+=b[k]; return a; }
+template<int D> BOIDS_INLINE Vec<D>& operator-=(Vec<D>& a, const Vec<D>& b){ for (int k=0;k<D;++k) a[k]-=b[k]; return a; }
+
+template<int D> BOIDS_INLINE float dot(const Vec<D>&a,const Vec<D>&b){ float s=0; for (int k=0;k<D;++k) s+=a[k]*b[k]; return s; }
+
+// ------------------------------------------------------------
+// norm / normalize の精度段階
+//   Exact   std::sqrt と除算（従来どおり）
+//   Newton  近似逆平方根 + ニュートン 1 回（相対誤差 ~1e-7）
+//   Approx  近似逆平方根のみ（x86: rsqrtss で ~4e-4，他: ビット演算 + 1 回で ~2e-3）
+// 既定はコンパイル時に -DBOIDS_PRECISION=Precision::Newton などで選べる．
+// 起動時の切り替えは Behavior に Tier<P> を入れた実体化を選ぶ（kadai_2C --precision）
+// ------------------------------------------------------------
+enum class Precision { Exact, Newton, Approx };
+
+#ifndef BOIDS_PRECISION
+#define BOIDS_PRECISION Precision::Exact
+#endif
+
+// 1/sqrt(x)（x > 0）
+template<Precision P>
+BOIDS_INLINE float rsqrt(float x) {
+    if constexpr (P == Precision::Exact) {
+        return 1.0f / std::sqrt(x);
+    } else {
+#if BOIDS_VEC_SSE
+        float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+        if constexpr (P == Precision::Newton) y = y * (1.5f - 0.5f * x * y * y);
+        return y;
+#else
+        float y;
+        uint32_t i;
+        std::memcpy(&i, &x, 4);
+        i = 0x5f375a86u - (i >> 1);
+        std::memcpy(&y, &i, 4);
+        y = y * (1.5f - 0.5f * x * y * y);
+        if constexpr (P == Precision::Newton) y = y * (1.5f - 0.5f * x * y * y);
+        return y;
+#endif
+    }
+}
+
+template<Precision P = BOIDS_PRECISION, int D>
+BOIDS_INLINE float norm(const Vec<D>&a){
+    const float r2 = dot(a,a);
+    if constexpr (P == Precision::Exact) return std::sqrt(r2);
+    else return (r2 > 0.f) ? r2 * rsqrt<P>(r2) : 0.f;
+}
+template<Precision P = BOIDS_PRECISION, int D>
+BOIDS_INLINE Vec<D> normalize(const Vec<D>&a){
+    if constexpr (P == Precision::Exact) {
+        float n=norm<P>(a); return (n>1e-6f)? a*(1.0f/n):Vec<D>{};
+    } else {
+        const float r2 = dot(a,a);
+        return (r2 > 1e-12f) ? a * rsqrt<P>(r2) : Vec<D>{};
+    }
+}
+
+#endif // __BOIDS_VEC_HPP__
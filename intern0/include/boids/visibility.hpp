@@ -0,0 +1,119 @@
+// ------------------------------------------------------------
+// Visibility：近傍知覚の見通し判定（遮蔽）
+//   i→j の視線を格子上で DDA 走査し，
+//     - FlowField の障害物セル
+//     - SpatialGrid の通過セルにいる他エージェント（円と線分の交差）
+//   に遮られたら見えないとする．
+//   判定はエージェントごとに候補をまとめて filter() に渡し，
+//   結果は無向ペアで直写像キャッシュに ttl ティック保持する
+//   （同じティック内なら j 側の判定は i 側の結果をそのまま使う）．
+//   キャッシュ（既定 2^18 件）は enabled で最初に beginTick() したときに確保する
+//   ※ 通過セル外に中心がありはみ出している円は見落とす（半径 ≪ セル幅が前提）
+// ------------------------------------------------------------
+#ifndef __BOIDS_VISIBILITY_HPP__
+#define __BOIDS_VISIBILITY_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "vec.hpp"
+#include "grid.hpp"
+#include "flowfield.hpp"
+
+class Visibility {
+public:
+    struct Stats { long rays{0}, hits{0}, blocked{0}; };
+
+    explicit Visibility(int cacheBits = 18)
+        : mask_((1u << cacheBits) - 1) {}
+
+    bool enabled       = false;
+    bool agentsOcclude = true;    // 他エージェントも遮蔽物にする
+    int  ttl           = 4;       // キャッシュ有効ティック数（0 で無効）
+
+    void  beginTick(uint32_t tick) {
+        tick_ = tick;
+        if (enabled && cache_.empty()) cache_.assign((size_t)mask_ + 1, Entry{});   // 遮蔽を使い始めたときだけ
+    }
+    // 個体の番号が付け替わったら呼ぶ（キャッシュは番号の対で引くので全部捨てる）
+    void  invalidate() { std::fill(cache_.begin(), cache_.end(), Entry{}); }
+    const Stats& stats() const { return stats_; }
+    void  resetStats() { stats_ = {}; }
+
+    // self から見える候補だけを cand に残す（順序は保つ）
+    template<class PosFn, class RadFn>
+    void filter(int self, std::vector<int>& cand, const SpatialGrid& grid,
+                const FlowField* flow, PosFn&& pos, RadFn&& rad)
+    {
+        const Vec2 a = pos(self);
+        size_t keep = 0;
+        for (int j : cand) {
+            const uint64_t key = pairKey(self, j);
+            Entry& e = cache_[slot(key)];
+            bool vis;
+            if (ttl > 0 && e.key == key && tick_ - e.tick < (uint32_t)ttl) {
+                vis = e.visible;
+                ++stats_.hits;
+            } else {
+                vis = castRay(self, j, a, pos(j), grid, flow, pos, rad);
+                e = Entry{key, tick_, vis};
+                ++stats_.rays;
+                if (!vis) ++stats_.blocked;
+            }
+            if (vis) cand[keep++] = j;
+        }
+        cand.resize(keep);
+    }
+
+private:
+    struct Entry { uint64_t key{~0ull}; uint32_t tick{0}; bool visible{true}; };
+
+    uint32_t mask_;
+    std::vector<Entry> cache_;
+    uint32_t tick_{0};
+    Stats stats_;
+
+    static uint64_t pairKey(int i, int j) {
+        uint32_t lo = (uint32_t)std::min(i, j), hi = (uint32_t)std::max(i, j);
+        return ((uint64_t)hi << 32) | lo;
+    }
+    uint32_t slot(uint64_t key) const {
+        key *= 0x9E3779B97F4A7C15ull;
+        return (uint32_t)(key >> 32) & mask_;
+    }
+
+    template<class PosFn, class RadFn>
+    bool castRay(int i, int j, const Vec2& a, const Vec2& b, const SpatialGrid& grid,
+                 const FlowField* flow, PosFn& pos, RadFn& rad) const
+    {
+        if (flow) {
+            const int fc = flow->cols();
+            const int ia = flow->cellOf(a), ib = flow->cellOf(b);
+            bool clear = traverseDDA(a, b, flow->cellSize(), fc, flow->rows(), [&](int cx, int cy){
+                int c = cy*fc + cx;
+                return c == ia || c == ib || !flow->blocked(c);
+            });
+            if (!clear) return false;
+        }
+        if (!agentsOcclude) return true;
+
+        const Vec2  d  = b - a;
+        const float dd = dot(d, d);
+        if (dd < 1e-8f) return true;
+        return grid.traverse(a, b, [&](int cx, int cy){
+            for (const int* it = grid.cellBegin(cx, cy); it != grid.cellEnd(cx, cy); ++it) {
+                const int k = *it;
+                if (k == i || k == j) continue;
+                const Vec2  c = pos(k) - a;
+                const float t = dot(c, d) / dd;
+                if (t <= 0.f || t >= 1.f) continue;
+                const Vec2  off = c - d * t;
+                const float r = rad(k);
+                if (dot(off, off) < r*r) return false;
+            }
+            return true;
+        });
+    }
+};
+
+#endif // __BOIDS_VISIBILITY_HPP__
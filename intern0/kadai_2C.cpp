@@ -1,6 +1,42 @@
 // ------------------------------------------------------------
 // Boids with mass-damper (no external input u)
-// Agent: a->v->p integrate, Renderer: draw, main: loop
+// Agent: a->v->p integrate, World: perception + step,
+// Renderer: draw, main: loop
+//   ./kadai_2C [--3d] [--headless] [--steps N] [--agents N] [--predators N]
+//              [--integrator euler|verlet|rk4] [--dt T] [--adaptive] [--goal] [--occlusion] [--contact] [--soa]
+//              [--multirate K] [--precision exact|newton|approx] [--morton K] [--threads T]
+//              [--deterministic] [--checkpoint K] [--checkpoint-dir D] [--snapshots M] [--params FILE]
+//              [--compact]
+//                                    ウィンドウ表示 / 3D / ヘッドレス
+//   ./kadai_2C --bench-perception [N] 遮蔽あり/なしの知覚コスト計測
+//   ./kadai_2C --bench-contact [N]    接触ソルバの残差・スレッド数依存性
+//   ./kadai_2C --bench-species [N]    種の数を増やしたときのティック時間
+//   ./kadai_2C --bench-integrators [N] 積分器ごとの精度とコスト（dt を変えて）
+//   ./kadai_2C --bench-substep [N]    固定 dt と適応サブステップの誤差・コスト
+//   ./kadai_2C --bench-multirate [N]  落ち着いた個体を間引いたときの省略率と誤差
+//   ./kadai_2C --bench-behavior [N]   力の項をコンパイル時に選んだときの速度
+//   ./kadai_2C --bench-fixed          小さな群れ（N=8..64）の 1 ステップ遅延
+//   ./kadai_2C --bench-tail [N]       積分・制限・壁の後処理：AoS 分岐あり vs SoA 分岐なし
+//   ./kadai_2C --check-precision [N]  norm の精度段階ごとの 10,000 ステップの軌道のずれ
+//   ./kadai_2C --bench-morton [N]     Morton 順の並べ替えあり/なしのティック時間・キャッシュミス
+//   ./kadai_2C --bench-population [N] 毎ティック生成・消滅させたときのコストとハンドルの検査
+//   ./kadai_2C --check-alloc [N]      定常ループ（100 Hz）で operator new が呼ばれないことの検査（-DBOIDS_COUNT_ALLOC=1 で組む）
+//   ./kadai_2C --bench-compact [N]    量子化した詰めた状態と float 状態・World（近傍の群れ）のバイト数・速度・誤差
+//   ./kadai_2C --bench-steal [N]      固まった群れの知覚：静的分割とワークスティーリングの不均衡・盗んだ数
+//   ./kadai_2C --check-determinism [N] 決定的モードがスレッド数・実行に依らず一致するかと，そのコスト
+//   ./kadai_2C --check-placement [N]  NUMA ノード・スレッド固定・huge page の起動ログと first-touch 後の整合
+//   ./kadai_2C --domain RANK SIZE [--transport shm|tcp] [--port P] [--hosts a,b,...] [--agents N] [--steps K]
+//                        [--rebalance] [--budget-ms B]
+//                                    領域分割の 1 rank（x 方向の短冊．rank ごとに別プロセスで起動）
+//   ./kadai_2C --check-domain [N]     2〜4 プロセス（共有メモリ・TCP）の結果が 1 プロセスと一致するか
+//   ./kadai_2C --bench-rebalance [N]  群れが偏ったとき：固定の短冊と境界を動かす場合の不均衡・移住量
+//   ./kadai_2C --stream DIR [--agents N] [--chunks-of K] [--steps S] [--drop-cache] [--keep]
+//                                    RAM に載らない群れ：ディスク上のチャンクを順に流すヘッドレス実行
+//   ./kadai_2C --check-stream [N]     外部記憶モードの 1 プロセスとの一致と，ディスク帯域あたりのスループット
+//   ./kadai_2C --check-checkpoint [N] fork の COW チェックポイント：止まる時間・遅延・COW フォールトと読み戻し，復元して続けた結果の一致
+//   ./kadai_2C --check-reload [N]     JSON パラメータの差し替え：途中の値が混ざらないか・反映までの遅延・ティックへの影響
+//   ./kadai_2C --check-tasks [SEC]    周期タスク（物理 100 Hz・入力 1 kHz・ログ 10 Hz・メトリクス 1 Hz）の遅れと CPU
+//   ./kadai_2C --check-flowfield [R]  フローフィールドの差分更新が毎回の全面再計算と同じ距離になるか
 // ------------------------------------------------------------
 #include <GLFW/glfw3.h>
 #include <vector>
@@ -9,141 +45,818 @@
 #include <thread>
 #include <cstdlib>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <span>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <deque>
+#include <type_traits>
+#include <algorithm>
+#include <numeric>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "boids/vec.hpp"
+#include "boids/flowfield.hpp"
+#include "boids/grid.hpp"
+#include "boids/visibility.hpp"
+#include "boids/parallel.hpp"
+#include "boids/contact.hpp"
+#include "boids/species.hpp"
+#include "boids/integrator.hpp"
+#include "boids/behavior.hpp"
+#include "boids/substep.hpp"
+#include "boids/multirate.hpp"
+#include "boids/fixedflock.hpp"
+#include "boids/soa.hpp"
+#include "boids/morton.hpp"
+#include "boids/slotmap.hpp"
+#include "boids/arena.hpp"
+#include "boids/steal.hpp"
+#include "boids/determinism.hpp"
+#include "boids/numa.hpp"
+#include "boids/domain.hpp"
+#include "boids/stream.hpp"
+#include "boids/snapshot.hpp"
+#include "boids/hotreload.hpp"
+#include "boids/tasks.hpp"
+#include "boids/compact.hpp"
 
-constexpr float PI = 3.1415926535f;
+// ------------------------------------------------------------
+// グローバル operator new の置き換え：呼び出し回数を AllocCounter に数える
+//   （--check-alloc が定常ループの確保回数を見る）．デバッグ用なので既定では外してあり，
+//   -DBOIDS_COUNT_ALLOC=1（CMake では -DBOIDS_COUNT_ALLOC=ON）で組んだときだけ入る
+// ------------------------------------------------------------
+#ifndef BOIDS_COUNT_ALLOC
+#define BOIDS_COUNT_ALLOC 0
+#endif
+#if BOIDS_COUNT_ALLOC
+// 境界つきの確保は MSVC では _aligned_malloc で取り，_aligned_free で返す（free では返せない）
+static void* countedAlloc(std::size_t n, std::size_t align = 0) {
+    AllocCounter::count();
+    if (n == 0) n = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(n);
+#ifdef _MSC_VER
+    return _aligned_malloc(n, align);
+#else
+    return std::aligned_alloc(align, (n + align - 1) / align * align);
+#endif
+}
+static void countedFreeAligned(void* p) {
+#ifdef _MSC_VER
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+void* operator new  (std::size_t n) { if (void* p = countedAlloc(n)) return p; throw std::bad_alloc(); }
+void* operator new[](std::size_t n) { if (void* p = countedAlloc(n)) return p; throw std::bad_alloc(); }
+void* operator new  (std::size_t n, std::align_val_t a) { if (void* p = countedAlloc(n, (std::size_t)a)) return p; throw std::bad_alloc(); }
+void* operator new[](std::size_t n, std::align_val_t a) { if (void* p = countedAlloc(n, (std::size_t)a)) return p; throw std::bad_alloc(); }
+void* operator new  (std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return countedAlloc(n); }
+// 置き換えた new と組なので malloc/free で合っている（GCC はインライン展開後に誤検出する）
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete  (void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete  (void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete  (void* p, std::align_val_t a) noexcept { if ((std::size_t)a <= alignof(std::max_align_t)) std::free(p); else countedFreeAligned(p); }
+void operator delete[](void* p, std::align_val_t a) noexcept { if ((std::size_t)a <= alignof(std::max_align_t)) std::free(p); else countedFreeAligned(p); }
+void operator delete  (void* p, std::size_t, std::align_val_t a) noexcept { ::operator delete(p, a); }
+void operator delete[](void* p, std::size_t, std::align_val_t a) noexcept { ::operator delete[](p, a); }
+void operator delete  (void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
 
-// -------- Vec2 & helpers --------
-struct Vec2 {
-    float x{0}, y{0};
-    Vec2() = default;
-    Vec2(float X, float Y): x(X), y(Y) {}
-    Vec2 operator+(const Vec2& o) const { return {x+o.x, y+o.y}; }
-    Vec2 operator-(const Vec2& o) const { return {x-o.x, y-o.y}; }
-    Vec2 operator*(float s)       const { return {x*s, y*s}; }
-    Vec2& operator+=(const Vec2& o){ x+=o.x; y+=o.y; return *this; }
-    Vec2& operator-=(const Vec2& o){ x-=o.x; y-=o.y; return *this; }
-};
-static inline float dot(const Vec2&a,const Vec2&b){ return a.x*b.x + a.y*b.y; }
-static inline float norm(const Vec2&a){ return std::sqrt(dot(a,a)); }
-static inline Vec2  normalize(const Vec2&a){ float n=norm(a); return (n>1e-6f)? a*(1.0f/n):Vec2{}; }
+constexpr float PI = 3.1415926535f;
 
 // ============================================================
 // ① Agent：物理特性 + Boids（自前の加速度 a_ を保持）
+//   D = 2（平面）/ 3（空間）で同じ力モデルを共有する
+//   ゲイン・制限は種ごと（SpeciesTable），エージェントは種番号だけ持つ
+//   力の項は Behavior<...>（boids/behavior.hpp）でコンパイル時に選ぶ
 // ============================================================
-class Agent {
+template<int D, class Behavior = FullBoids>
+class BasicAgent {
 public:
-    Agent(const Vec2& p0, const Vec2& v0, float radius, float viewRadius)
-        : p_(p0), v_(v0), radius_(radius), viewRad_(viewRadius) {}
+    using VecD = Vec<D>;
+    using behavior = Behavior;
+
+    BasicAgent(const VecD& p0, const VecD& v0, float radius, float viewRadius, int species = 0)
+        : p_(p0), v_(v0), radius_(radius), viewRad_(viewRadius), species_(species) {}
 
-    Vec2 randomForce(float strength) {
-        float ang = ((float)std::rand() / RAND_MAX) * 2.f * PI;
-        return Vec2{ std::cos(ang), std::sin(ang) } * strength;
+    // ランダムな単位ベクトル（3D は球面上で一様：z を一様に取り残りを円周に配る）
+    // u は一様乱数の引き口（既定は std::rand，決定的モードはカウンタ型）
+    static VecD randomDir(RandomDraw u = {}) {
+        float ang = u() * 2.f * PI;
+        if constexpr (D == 2) {
+            return VecD{ std::cos(ang), std::sin(ang) };
+        } else {
+            float z = u() * 2.f - 1.f;
+            float s = std::sqrt(std::max(0.f, 1.f - z*z));
+            return VecD{ s*std::cos(ang), s*std::sin(ang), z };
+        }
+    }
+
+    VecD randomForce(float strength, RandomDraw u = {}) {
+        return randomDir(u) * strength;
     }
 
     // マスダンパ系： M a + D v = F_boids + F_wall
-    void drive(float dt, const std::vector<Agent>& all, float worldW, float worldH)
+    // nbrs: all のうち知覚できた相手の番号（World::perceive が作る）
+    // world: 各軸のワールド幅．flow は 2D のみ（3D では nullptr）
+    // Integrator: 積分器ポリシー（boids/integrator.hpp）．近傍はティック中凍結
+    // substeps: dt を何回に刻むか（AdaptiveStep が決める．近傍は各刻みの時刻へ外挿）
+    // rnd: 乱数の引き口（World が決定的モードならカウンタ型を渡す）
+    template<class Integrator = SemiImplicitEuler>
+    void drive(float dt, std::span<const BasicAgent> all, std::span<const int> nbrs,
+               const SpeciesTable& species, const VecD& world, const FlowField* flow = nullptr,
+               int substeps = 1, RandomDraw rnd = {})
     {
-        Vec2 u_s{0,0};
-        Vec2 u_c{0,0};
-        Vec2 u_a{0,0};
-        Vec2 u_wall{0,0};
-
-        // --- Boids: 近傍統計 ---
-        Vec2 v_avg{0,0}, p_avg{0,0};
-        int cnt = 0;
-        for (const auto& o : all) {
-            if (&o == this) continue;
-            Vec2 rij = o.p_ - p_;
-            float d = norm(rij);
-            if (d < viewRad_) {
-                if (d > 1e-4f) {
-                    float overlap = viewRad_ - d;
-                    // 分離（反発）：相手と逆向き
-                    u_s -= normalize(rij) * (k_sep_ * overlap / (d + 1e-3f));
-                }
-                v_avg += o.v_;
-                p_avg += o.p_;
-                ++cnt;
-            }
-        }
-        if (cnt > 0) {
-            v_avg = v_avg * (1.0f/cnt);
-            p_avg = p_avg * (1.0f/cnt);
-            u_a += (v_avg - v_) * k_ali_;   // 整列
-            u_c += (p_avg - p_) * k_coh_;   // 凝集
+        const SpeciesParams& P = species.params(species_);
+        VecD u_ran{};
+        if constexpr (Behavior::random)
+            u_ran = randomForce(30.f, rnd)* P.k_ran;            // strength=30（ティック中は一定）
+
+        const float h = dt / substeps;
+        for (int s = 0; s < substeps; ++s) {
+            const float t0 = s * h;
+            Integrator::step(p_, v_, a_, h,
+                [&](const VecD& p, const VecD& v, float tau){
+                    return accel(p, v, t0 + tau, u_ran, all, nbrs, species, world, flow);
+                },
+                [&](VecD& v){ clipVec(v, P.Vmax); });
+            clampInto(world);
         }
+    }
 
+    // 休止中（Multirate）：保持した加速度 a で外挿するだけ（知覚・力計算なし）
+    void coast(float dt, const VecD& a, const SpeciesTable& species, const VecD& world) {
+        v_ += a * dt;
+        clipVec(v_, species.params(species_).Vmax);
+        p_ += v_ * dt;
+        clampInto(world);
+    }
 
-        Vec2 u_ran = randomForce(30.f)* k_ran_;  // strength=30
+    // 近傍から局所的な硬さを見積もる（AdaptiveStep::substeps の入力）
+    //   omega2: 分離バネ |d/dd k_sep (vr-d)/(d+ε)| と種間ゲインの最大値 / M
+    //   closing: 近づいてくる相手の (接近速度 / 距離) の最大値
+    //   accel: 前ティックの |a| / 最接近距離
+    Stiffness stiffness(std::span<const BasicAgent> all, std::span<const int> nbrs,
+                        const SpeciesTable& species) const
+    {
+        const SpeciesParams& P = species.params(species_);
+        Stiffness s;
+        float dmin = viewRad_;
+        for (int j : nbrs) {
+            const BasicAgent& o = all[j];
+            const VecD  rij = o.p_ - p_;
+            const float d   = norm(rij);
+            if (d >= viewRad_) continue;
+            dmin = std::min(dmin, d);
+            if (species.flocks(species_, o.species_)) {
+                const float e = d + 1e-3f;
+                s.omega2 = std::max(s.omega2, P.k_sep * (viewRad_ + 1e-3f) / (e*e));
+            }
+            const float k = species.interact(species_, o.species_);
+            if (k != 0.f) s.omega2 = std::max(s.omega2, std::fabs(k) / viewRad_);
+            const float approach = -dot(o.v_ - v_, rij) / (d*d + 1e-6f);
+            s.closing = std::max(s.closing, approach);
+        }
+        s.omega2 /= P.M;
+        s.accel = norm(a_) / std::max(dmin, 1e-3f);
+        return s;
+    }
 
+    // 状態 (p, v) での加速度 a = (F_boids - D v)/M
+    // 近傍 all[nbrs] はティック先頭の状態から tau 秒ぶん等速で外挿する
+    VecD accel(const VecD& p, const VecD& v, float tau, const VecD& u_ran,
+               std::span<const BasicAgent> all, std::span<const int> nbrs,
+               const SpeciesTable& species, const VecD& world, const FlowField* flow) const
+    {
+        const SpeciesParams& P = species.params(species_);
+        VecD F_boids = force(p, v, tau, u_ran, all, nbrs, species, world, flow);
 
-        // --- 壁：やわらかバネで内側へ ---
-        const float margin = 10.f;
-        if (p_.x < margin)        u_wall.x += k_wall_ * (margin - p_.x);
-        if (p_.x > worldW-margin) u_wall.x -= k_wall_ * (p_.x - (worldW-margin));
-        if (p_.y < margin)        u_wall.y += k_wall_ * (margin - p_.y);
-        if (p_.y > worldH-margin) u_wall.y -= k_wall_ * (p_.y - (worldH-margin));
+        // --- マスダンパ系から加速度を計算： a = (F - D v)/M ---
+        VecD a = (F_boids - v * P.D) * (1.0f / P.M);
+        clipAce(a, P.Amax);
+        return a;
+    }
 
-        //要素の合成
-        Vec2 F_boids = u_s + u_a + u_c + u_wall + u_ran;
+    // 合力 F_boids（WithWall = false なら壁バネを除く：SoATail が後で足す）
+    template<bool WithWall = true>
+    VecD force(const VecD& p, const VecD& v, float tau, const VecD& u_ran,
+               std::span<const BasicAgent> all, std::span<const int> nbrs,
+               const SpeciesTable& species, const VecD& world, const FlowField* flow) const
+    {
+        const SpeciesParams& P = species.params(species_);
+        ForceAcc<D> f;
 
-        // --- マスダンパ系から加速度を計算： a = (F - D v)/M ---
-        a_ = (F_boids - v_ * D_) * (1.0f / M_);
-        clipAce(a_, Amax_);
+        // --- 近傍：含まれる項の pair() を 1 本のループで ---
+        if constexpr (Behavior::pairwise) {
+            for (int j : nbrs) {
+                const BasicAgent& o = all[j];
+                const VecD pj = (tau == 0.f) ? o.p_ : o.p_ + o.v_ * tau;
+                const VecD rij = pj - p;
+                float d, invD;
+                if (!inView(dot(rij, rij), d, invD)) continue;
+                Neighbor<D> nb{ rij, pj, o.v_, d, invD, viewRad_, false, 0.f };
+                if constexpr (Behavior::needsFlock)
+                    nb.flock = species.flocks(species_, o.species_);
+                if constexpr (Behavior::template has<Interaction>)
+                    nb.k = species.interact(species_, o.species_);
+                if constexpr (Behavior::flockStats) {
+                    if (nb.flock) { f.vSum += o.v_; f.pSum += pj; ++f.cnt; }
+                }
+                Behavior::pair(f, nb, P);
+            }
+        }
 
-        // --- 半陰的オイラー（安定）： v ← v + a dt, p ← p + v dt ---
-        v_ += a_ * dt;
-        clipVec(v_, Vmax_);
-        p_ += v_ * dt;
+        // --- 自分の状態だけで決まる項（整列・凝集の仕上げ，壁，乱数，ゴール） ---
+        //   ループの累積 f はレジスタに置いたままにしたいので，コピーに足し込む
+        ForceAcc<D> g = f;
+        Behavior::self(g, SelfState<D>{ p, v, world, u_ran, flow }, P);
+
+        //要素の合成
+        if constexpr (!WithWall) g.wall = VecD{};
+        return Behavior::total(g);
+    }
 
-        // --- 画面内にクランプ（半径ぶん内側） ---
-        if (p_.x < radius_)   p_.x = radius_;
-        if (p_.x > worldW-radius_) p_.x = worldW - radius_;
-        if (p_.y < radius_)   p_.y = radius_;
-        if (p_.y > worldH-radius_) p_.y = worldH - radius_;
+    // SoA 後処理用：乱数を引き，ティック先頭の状態で壁以外の合力を返す
+    // （a, 制限, 積分, 壁, クランプは SoATail がまとめて行い setState で戻す）
+    VecD gather(std::span<const BasicAgent> all, std::span<const int> nbrs,
+                const SpeciesTable& species, const VecD& world, const FlowField* flow,
+                RandomDraw rnd = {})
+    {
+        VecD u_ran{};
+        if constexpr (Behavior::random)
+            u_ran = randomForce(30.f, rnd)* species.params(species_).k_ran;
+        return force<false>(p_, v_, 0.f, u_ran, all, nbrs, species, world, flow);
     }
+    void setState(const VecD& p, const VecD& v, const VecD& a) { p_ = p; v_ = v; a_ = a; }
 
     // 描画用の読み取り
-    Vec2  pos()     const { return p_; }
+    VecD  pos()     const { return p_; }
+    VecD  vel()     const { return v_; }
+    VecD  acc()     const { return a_; }
     float radius()  const { return radius_; }
+    float viewRadius() const { return viewRad_; }
+    int   species() const { return species_; }
+    void  setPos(const VecD& p) { p_ = p; }    // 接触ソルバの押し戻し用
 
 private:
     // 状態
-    Vec2  p_{0,0};
-    Vec2  v_{0,0};
-    Vec2  a_{0,0};
+    VecD  p_{};
+    VecD  v_{};
+    VecD  a_{};
 
     // 見た目・近傍
     float radius_{3.f};
     float viewRad_{200.f};
 
-    // 物理パラメータ（マス・ダンパ）
-    float M_ = 1.0f;   // 質量
-    float D_ = 1.0f;   // 粘性係数（減衰）
-
-    // Boids ゲイン
-    float k_sep_  = 4.f;
-    float k_ali_  = 10.f;
-    float k_coh_  = 2.f;
-    float k_wall_ = 2.f;
-    float k_ran_ = 10.f;
+    // 種（ゲイン・制限は SpeciesTable 側）
+    int   species_{0};
 
-    // 制限
-    float Vmax_ = 100.f;
-    float Amax_ = 100.f;
+    // --- 画面内にクランプ（半径ぶん内側） ---
+    void clampInto(const VecD& world) {
+        for (int k = 0; k < D; ++k) {
+            if (p_[k] < radius_)          p_[k] = radius_;
+            if (p_[k] > world[k]-radius_) p_[k] = world[k] - radius_;
+        }
+    }
+    static constexpr Precision PREC = Behavior::precision;
 
-    static void clipVec(Vec2& v, float vmax){
-        float vn = norm(v);
+    // r2 = |rij|² が視野内なら距離とその逆数を返す（精度段階 PREC）
+    bool inView(float r2, float& d, float& invD) const {
+        if constexpr (PREC == Precision::Exact) {
+            d = std::sqrt(r2);
+            if (d >= viewRad_) return false;
+            invD = 1.0f / d;
+        } else {
+            if (r2 >= viewRad_ * viewRad_) return false;
+            invD = (r2 > 0.f) ? rsqrt<PREC>(r2) : 0.f;
+            d = r2 * invD;
+        }
+        return true;
+    }
+    static void clipVec(VecD& v, float vmax){
+        float vn = norm<PREC>(v);
         if (vn > vmax) v = v * (vmax / (vn + 1e-6f));
     }
-    static void clipAce(Vec2& a, float amax){
-        float n = norm(a);
+    static void clipAce(VecD& a, float amax){
+        float n = norm<PREC>(a);
         if (n > amax) a = a * (amax / (n + 1e-6f));
     }
 };
 
+using Agent  = BasicAgent<2>;
+using Agent3 = BasicAgent<3>;
+template<class... Terms> using AgentOf = BasicAgent<2, Behavior<Terms...>>;   // 例：AgentOf<Separation, Alignment, Wall>
+
+// ============================================================
+// ② World：近傍格子・遮蔽・フローフィールドを持ち，1 ティック進める
+//   遮蔽とフローフィールドは 2D のみ（3D では持たない）
+//   積分器と力の項（Behavior）はテンプレート引数（実行時の切り替えは main で実体化を選ぶ）
+// ============================================================
+template<int D, class Integrator = SemiImplicitEuler, class Behavior = FullBoids>
+class BasicWorld {
+public:
+    static constexpr int dim = D;
+    using integrator = Integrator;
+    using VecD   = Vec<D>;
+    using AgentD = BasicAgent<D, Behavior>;
+    using Agents = SlotMap<AgentD, HugePageAllocator<AgentD>>;   // 大きな群れは huge page に
+
+    BasicWorld(const VecD& world, float flowCell, float viewRadius, int threads = 0)
+        : world_(world),
+          flow_(makeFlow(world, flowCell)),
+          grid_(world, viewRadius * 0.5f),
+          pool_(threads) {
+        placement_.pin(pool_);                     // ノードが 2 つ以上のときだけ固定
+        // 並列の速いモードの乱数の種は実行ごとに変える（std::rand の列は spawn 用に残す）
+        fastRng_.seed = Deterministic::mix((uint64_t)std::chrono::steady_clock::now().time_since_epoch().count()
+                                           ^ (uint64_t)(uintptr_t)this);
+    }
+    BasicWorld(float worldW, float worldH, float flowCell, float viewRadius, int threads = 0)
+        requires (D == 2)
+        : BasicWorld(VecD{worldW, worldH}, flowCell, viewRadius, threads) {}
+
+    // 走査用の詰めた配列（番号は spawn / despawn / 並べ替えで変わる）
+    const typename Agents::Vector& agents() const { return agents_.dense(); }
+    FlowField&  flow()       requires (D == 2) { return flow_; }
+    Visibility& visibility() requires (D == 2) { return vis_; }
+    BasicContactSolver<D>& contact() { return contact_; }
+    SpeciesTable& species() { return species_; }
+    AdaptiveStep& substep() { return substep_; }
+    Multirate&    multirate() { return multirate_; }
+    SoATail<D, Behavior::precision>& soa() { return soa_; }
+    MortonOrder<D>& morton() { return morton_; }
+    StealScheduler& scheduler() { return sched_; }
+    Deterministic&  deterministic() { return det_; }
+#ifdef __linux__
+    ForkCheckpoint& checkpoint() { return ckpt_; }
+#endif
+    HotParams&      params() { return params_; }
+    const FrameArena& arena() const { return arena_; }
+    const Placement&  placement() const { return placement_; }
+    void logPlacement(std::FILE* out) const {
+        placement_.describe(out, pool_.size(), "agent array", agents_.capacity() * sizeof(AgentD));
+        placement_.region(out, "snapshot arena", arena_.capacity(), arena_.kind());
+    }
+    int threads() const { return pool_.size(); }
+    const VecD& extent() const { return world_; }
+    float width()  const { return world_[0]; }
+    float height() const { return world_[1]; }
+
+    // 個体の追加・削除（ティックの間に呼ぶ）．外から持つのは Handle だけにする
+    //   despawn は末尾の個体をその位置へ移して詰め，番号で持つ状態も同じように動かす
+    template<class... A>
+    Handle spawn(A&&... args) { return agents_.emplace(std::forward<A>(args)...); }
+    bool despawn(Handle h) {
+        const int i = agents_.indexOf(h);
+        if (i < 0) return false;
+        hold_.resize(agents_.size());                  // 前のティック後に増えた個体の分も
+        multirate_.resize(agents_.size());
+        agents_.erase(h);
+        hold_[i] = hold_.back();
+        hold_.pop_back();
+        multirate_.erase(i);
+        renumbered_ = true;
+        return true;
+    }
+    // n 体・1 体あたり近傍 neighborsPerAgent 件までは，ティック中にヒープ確保しない容量を先に取る
+    void reserve(int n, int neighborsPerAgent = 32) {
+        arena_.reserve(2 * n * sizeof(AgentD));        // 個体配列より先に（起動ログの huge page 種別が個体配列のものになる）
+        agents_.reserve(n); sortTmp_.reserve(n); hold_.reserve(n);
+        // 個体配列は parallelFor の区間ごとに担当スレッドが最初に触る（そのノードに載る）
+        placement_.firstTouch(agents_.dense().data(), agents_.capacity() * sizeof(AgentD), pool_);
+        placement_.firstTouch(sortTmp_.data(), sortTmp_.capacity() * sizeof(AgentD), pool_);
+        touchArena(n);
+        cand_.resize(pool_.size());
+        for (auto& c : cand_) c.reserve(n);
+        nbrOf_.reserve(n); nbrOff_.reserve(n);
+        nbrBuf_.resize(1);
+        nbrBuf_[0].reserve((size_t)n * neighborsPerAgent);
+        pos_.reserve(n); rad_.reserve(n);
+        contact_.reserve(n);
+    }
+    int  population() const { return agents_.size(); }
+    AgentD*       get(Handle h)       { return agents_.get(h); }
+    const AgentD* get(Handle h) const { return agents_.get(h); }
+    Handle handleAt(int i) const { return agents_.handleAt(i); }
+    int    indexOf(Handle h) const { return agents_.indexOf(h); }
+    int    freeSlots() const { return agents_.freeCount(); }     // 次の spawn で使い回すスロットの数
+
+    std::span<const int> neighbors(int i) const {
+        return nbrOf_[i];
+    }
+
+    // 知覚：格子で視野内の候補を集め，遮蔽が有効なら見通しで絞る
+    //   格子は (セル, 種) 順に並べ，自分が相手にする種の層だけを走査する
+    void perceive() {
+        const auto t0 = std::chrono::steady_clock::now();
+        const int n = (int)snap_.size();
+        auto pos = [&](int k){ return snap_[k].pos(); };
+        const int S = species_.count();
+        if (grid_.layers() != S) grid_.setLayers(S);
+        masks_.resize(S);
+        for (int s = 0; s < S; ++s) masks_[s] = species_.mask(s);
+        grid_.build(n, pos, [&](int k){ return snap_[k].species(); });
+        if constexpr (D == 2) vis_.beginTick(tick_);
+
+        nbrOf_.resize(n);
+        nbrOff_.resize(n);
+        cand_.resize(pool_.size());
+        bool serial = pool_.size() == 1;
+        if constexpr (D == 2) serial |= vis_.enabled;  // 遮蔽キャッシュはスレッド間で共有できない
+        if (serial) {
+            sched_.clearLast();
+            if (nbrBuf_.empty()) nbrBuf_.resize(1);
+            nbrBuf_[0].clear();
+            for (int i = 0; i < n; ++i) perceiveOne(i, cand_[0], nbrBuf_[0]);
+            for (int i = 0; i < n; ++i) seal(i, nbrBuf_[0]);
+        } else {
+            // 格子のセル区間をタスクに．見積もりはセルの個体数の 2 乗（近傍対の数に比例）
+            sched_.plan(grid_.size(), pool_.size(), [&](int c){
+                const double m = (double)(grid_.cellEnd(c) - grid_.cellBegin(c));
+                return m * m;
+            });
+            const auto& tasks = sched_.tasks();
+            if (nbrBuf_.size() < tasks.size()) nbrBuf_.resize(tasks.size());
+            sched_.run(pool_, [&](int t, int task, int cb, int ce) -> uint64_t {
+                std::vector<int>& out = nbrBuf_[task];
+                out.clear();
+                uint64_t work = 0;
+                for (int c = cb; c < ce; ++c)
+                    for (const int* it = grid_.cellBegin(c); it != grid_.cellEnd(c); ++it)
+                        work += perceiveOne(*it, cand_[t], out);
+                for (int c = cb; c < ce; ++c)
+                    for (const int* it = grid_.cellBegin(c); it != grid_.cellEnd(c); ++it) seal(*it, out);
+                return work;
+            });
+        }
+        perceiveSec_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // 個体 i の近傍を out の末尾に足す（位置は nbrOff_ に）．見た候補の数を返す
+    uint64_t perceiveOne(int i, std::vector<int>& cand, std::vector<int>& out) {
+        const int off = (int)out.size();
+        nbrOff_[i] = { off, off };
+        if (!multirate_.due(i, tick_)) return 0;       // 休止中は近傍を作らない
+        const VecD  p  = snap_[i].pos();
+        const float vr = snap_[i].viewRadius();
+        uint64_t seen = 0;
+        cand.clear();
+        grid_.query(p, vr, masks_[snap_[i].species()], [&](int j){
+            ++seen;
+            if (j == i) return;
+            VecD r = snap_[j].pos() - p;
+            if (dot(r, r) < vr*vr) cand.push_back(j);
+        });
+        if constexpr (D == 2) {
+            if (vis_.enabled) vis_.filter(i, cand, grid_, &flow_,
+                                          [&](int k){ return snap_[k].pos(); }, [&](int k){ return snap_[k].radius(); });
+        }
+        out.insert(out.end(), cand.begin(), cand.end());
+        nbrOff_[i].second = (int)out.size();
+        return seen;
+    }
+    // スナップショットの載る先頭 n 体ぶんを，step のコピーと同じ区間で各スレッドが最初に触る
+    void touchArena(int n) {
+        placement_.firstTouch(arena_.data(), std::min(arena_.capacity(), (size_t)n * sizeof(AgentD)), pool_);
+        arenaRegrows_ = arena_.regrows();
+    }
+    // out を書き終えてから近傍の区間を固定する（書いている間は再確保で動くので）
+    void seal(int i, const std::vector<int>& out) {
+        nbrOf_[i] = { out.data() + nbrOff_[i].first, out.data() + nbrOff_[i].second };
+    }
+
+    void step(float dt) {
+        const FlowField* flow = nullptr;
+        if constexpr (D == 2) {
+            flow_.update();                            // 変更のあった範囲だけ再計算
+            flow = flow_.hasGoal() ? &flow_ : nullptr;     // ゴールがなければ steer() は 0 なので引かない
+        }
+        params_.apply(species_);                       // 見張っているファイルの新しい版（ティックの境目で）
+        multirate_.resize(agents_.size());
+        hold_.resize(agents_.size());
+        if (morton_.due(tick_)) reorder();             // 空間的に近い個体を配列でも近くに
+        if constexpr (D == 2) {                        // 遮蔽キャッシュは番号の対で引く
+            if (renumbered_ && vis_.enabled) { vis_.invalidate(); renumbered_ = false; }
+        }
+        arena_.reset();                                // ティック内の一時領域はここから
+        if (arena_.regrows() != arenaRegrows_) touchArena(agents_.size());   // まとめ直したブロックも
+        snap_ = arena_.copy(std::span<const AgentD>(agents_.dense()), pool_);   // 同時刻参照（区間ごとに並列）
+        perceive();
+        const auto t0 = std::chrono::steady_clock::now();
+        // 半陰的オイラーで個体ごとの刻み・間引きがなければ後処理を SoA で
+        const bool soa = std::is_same_v<Integrator, SemiImplicitEuler>
+                      && soa_.enabled && !substep_.enabled && !multirate_.enabled;
+        if (soa) driveSoA(dt, flow);
+        else if (parallelDrive()) {                    // 個体ごとに独立（近傍はティック先頭の snap_）
+            pool_.parallelFor(agents_.size(), [&](int b, int e){
+                for (int i = b; i < e; ++i)
+                    agents_[i].template drive<Integrator>(dt, snap_, neighbors(i), species_, world_, flow, 1, draw(i));
+            });
+        }
+        else for (int i = 0; i < (int)agents_.size(); ++i) {
+            if (!multirate_.due(i, tick_)) {           // 落ち着いた個体は外挿だけ
+                agents_[i].coast(dt, hold_[i], species_, world_);
+                multirate_.count(false);
+                continue;
+            }
+            int n = 1;
+            if (substep_.enabled) {                    // 混み合った個体だけ刻む
+                n = substep_.substeps(dt, snap_[i].stiffness(snap_, neighbors(i), species_));
+                substep_.record(n);
+            }
+            agents_[i].template drive<Integrator>(dt, snap_, neighbors(i), species_, world_, flow, n, draw(i)); // ★uは使わない
+            if (multirate_.enabled) settle(i, dt, flow);
+        }
+        driveSec_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (contact_.enabled) resolveContacts();
+        ++tick_;
+#ifdef __linux__
+        if (ckpt_.enabled) {                           // ティックの合間（作業スレッドは止まっている）
+            ckpt_.poll(false);
+            if (ckpt_.due(tick_)) ckpt_.begin(tick_, [&](SnapshotWriter& w){ return writeSnapshot(w); });
+        }
+#endif
+    }
+
+#ifdef __linux__
+    // チェックポイントの中身：ヘッダ，詰めた個体配列，各個体のハンドル，空きリストのハンドル
+    bool writeSnapshot(SnapshotWriter& w) const {
+        SnapshotHeader h;
+        h.dim = D;
+        h.tick = tick_;
+        h.count = (uint64_t)agents_.size();
+        h.agentBytes = sizeof(AgentD);
+        h.freeSlots = (uint64_t)agents_.freeCount();
+        bool ok = w.put(&h, sizeof(h));
+        ok = ok && w.put(agents_.dense().data(), agents_.size() * sizeof(AgentD));
+        for (int i = 0; ok && i < agents_.size(); ++i) {
+            const Handle hd = agents_.handleAt(i);
+            ok = w.put(&hd, sizeof(hd));
+        }
+        agents_.forEachFree([&](Handle hd){ ok = ok && w.put(&hd, sizeof(hd)); });
+        return ok;
+    }
+    // 空の World にチェックポイントを読み込む．保存した順に並べ，ハンドルと空きリストも
+    // 保存元のとおりに付け直す（乱数の流れはハンドルで決まるので，決定的モードなら続きがビット単位で同じ）
+    bool restore(const char* path) {
+        if (agents_.size() != 0) { std::fprintf(stderr, "restore: world is not empty\n"); return false; }
+        std::FILE* f = std::fopen(path, "rb");
+        if (!f) { std::perror(path); return false; }
+        SnapshotHeader h;
+        bool ok = std::fread(&h, sizeof(h), 1, f) == 1 && h.valid() && h.dim == (uint32_t)D && h.agentBytes == sizeof(AgentD)
+               && h.count < (1ull << 31) && h.freeSlots < (1ull << 31);
+        if (ok) {
+            static_assert(std::is_trivially_copyable_v<AgentD>, "checkpoints store raw agent bytes");
+            reserve((int)h.count);
+            alignas(AgentD) unsigned char raw[sizeof(AgentD)];
+            for (uint64_t i = 0; ok && i < h.count; ++i) {
+                ok = std::fread(raw, sizeof(AgentD), 1, f) == 1;
+                if (ok) agents_.dense().push_back(*reinterpret_cast<const AgentD*>(raw));
+            }
+            std::vector<Handle> live(ok ? h.count : 0), freeList(ok ? h.freeSlots : 0);
+            ok = ok && std::fread(live.data(), sizeof(Handle), live.size(), f) == live.size()
+                    && std::fread(freeList.data(), sizeof(Handle), freeList.size(), f) == freeList.size();
+            ok = ok && agents_.rebuild(live, freeList);
+            tick_ = (uint32_t)h.tick;
+        }
+        std::fclose(f);
+        if (!ok) {
+            agents_.rebuild({}, {});                   // 途中まで読んだ個体を捨てて空に戻す
+            std::fprintf(stderr, "restore: %s is not a %dD checkpoint of this build\n", path, D);
+        }
+        return ok;
+    }
+#endif
+
+    // 積分後の重なりを接触ソルバで解消（残差は contact().last()）
+    void resolveContacts() {
+        const int n = (int)agents_.size();
+        pos_.resize(n);
+        rad_.resize(n);
+        for (int i = 0; i < n; ++i) { pos_[i] = agents_[i].pos(); rad_[i] = agents_[i].radius(); }
+        contact_.solve(pos_, rad_, world_, pool_);
+        for (int i = 0; i < n; ++i) agents_[i].setPos(pos_[i]);
+    }
+
+    // 群れ全体の統計（重心・平均の速さ・重心からの平均距離）．
+    // 決定的モードなら固定ブロックの木で足すのでスレッド数に依らない
+    struct Metrics { VecD centroid{}; float meanSpeed = 0, spread = 0; };
+    Metrics metrics() {
+        const int n = agents_.size();
+        if (n == 0) return {};
+        const bool fixed = det_.enabled;
+        const PosSpeed s = sumPS_.run(pool_, n, fixed, det_.block, [&](int i){
+            return PosSpeed{ agents_[i].pos(), norm(agents_[i].vel()) };
+        });
+        Metrics m;
+        m.centroid  = s.p * (1.f / n);
+        m.meanSpeed = s.speed / n;
+        m.spread    = sumF_.run(pool_, n, fixed, det_.block, [&](int i){
+            return norm(agents_[i].pos() - m.centroid);
+        }) / n;
+        return m;
+    }
+
+    double perceiveSeconds() const { return perceiveSec_; }
+    double driveSeconds()    const { return driveSec_; }
+    void   resetTimers() {
+        perceiveSec_ = 0;
+        driveSec_    = 0;
+        substep_.resetStats();
+        multirate_.resetStats();
+        morton_.resetStats();
+        if constexpr (D == 2) vis_.resetStats();
+    }
+
+private:
+    struct None {};
+    using FlowMap = std::conditional_t<D == 2, FlowField, None>;
+    using VisMap  = std::conditional_t<D == 2, Visibility, None>;
+
+    static FlowMap makeFlow(const VecD& world, float cell) {
+        if constexpr (D == 2) return FlowField(world[0], world[1], cell);
+        else                  return None{};
+    }
+
+    // 半陰的オイラーの 1 ティックを 2 パスで：個体ごとに合力を集め（AoS），
+    // その後の後処理は成分ごとの配列に詰めて SoATail で分岐なしにまとめて行う
+    void driveSoA(float dt, const FlowField* flow) {
+        const int n = (int)agents_.size();
+        soa_.resize(n);
+        auto pack = [&](int i) {
+            AgentD& a = agents_[i];
+            const VecD F = a.gather(snap_, neighbors(i), species_, world_, flow, draw(i));
+            const VecD p = a.pos(), v = a.vel();
+            const SpeciesParams& P = species_.params(a.species());
+            for (int k = 0; k < D; ++k) { soa_.p[k][i] = p[k]; soa_.v[k][i] = v[k]; soa_.f[k][i] = F[k]; }
+            soa_.invM[i]  = 1.0f / P.M;
+            soa_.damp[i]  = P.D;
+            soa_.vmax[i]  = P.Vmax;
+            soa_.amax[i]  = P.Amax;
+            soa_.kwall[i] = P.k_wall;
+            soa_.rad[i]   = a.radius();
+        };
+        if (parallelDrive()) pool_.parallelFor(n, [&](int b, int e){ for (int i = b; i < e; ++i) pack(i); });
+        else for (int i = 0; i < n; ++i) pack(i);
+        soa_.run(n, dt, world_, Behavior::template has<Wall>);
+        for (int i = 0; i < n; ++i) {
+            VecD p, v, acc;
+            for (int k = 0; k < D; ++k) { p[k] = soa_.p[k][i]; v[k] = soa_.v[k][i]; acc[k] = soa_.a[k][i]; }
+            agents_[i].setState(p, v, acc);
+        }
+    }
+
+    // 力の計算を個体ごとに並列にできるか（間引き・適応刻みは統計と起こす相手を共有するので直列）
+    //   並列のときは決定的モードでなくても乱数はカウンタ型（std::rand はスレッド安全と
+    //   決まっていない）．種が実行ごとに違うので，速いモードの結果は実行ごとに変わる
+    bool parallelDrive() const {
+        return pool_.size() > 1 && !multirate_.enabled && !substep_.enabled;
+    }
+    // 個体 i の乱数の引き口．系列はハンドル（並べ替え・詰め直しで変わらない）
+    //   直列の速いモードだけ std::rand（1 スレッドの軌道は従来どおり）
+    RandomDraw draw(int i) const {
+        if (!det_.enabled && !parallelDrive()) return {};
+        const Handle h = agents_.handleAt(i);
+        return RandomDraw{ det_.enabled ? &det_ : &fastRng_, ((uint64_t)h.gen << 32) | h.slot, tick_ };
+    }
+
+    // Morton 順に並べ替え，番号で持っている個体ごとの状態も同じ順列で動かす
+    //   ハンドルはそのまま有効
+    void reorder() {
+        const int n = agents_.size();
+        if (n == 0) return;
+        const std::vector<int>& ord = morton_.sort(n, [&](int i){ return agents_[i].pos(); }, world_, pool_);
+        agents_.permute(ord, sortTmp_);
+        holdTmp_.resize(n);
+        for (int i = 0; i < n; ++i) holdTmp_[i] = hold_[ord[i]];
+        hold_.swap(holdTmp_);
+        multirate_.permute(ord);
+        renumbered_ = true;
+    }
+
+    // 更新した個体の次の周期を決める：近くに相手・壁がなく，
+    // 乱数項を除いた加速度が小さければ period ティック休ませる．近い相手は起こす
+    void settle(int i, float dt, const FlowField* flow) {
+        const AgentD& a = agents_[i];
+        const VecD p = a.pos();
+        bool calm = true;
+        for (int k = 0; k < D; ++k)
+            if (p[k] < multirate_.wallDist || p[k] > world_[k] - multirate_.wallDist) calm = false;
+        const float nd2 = multirate_.nearDist * multirate_.nearDist;
+        for (int j : neighbors(i)) {
+            const VecD r = snap_[j].pos() - p;
+            if (dot(r, r) < nd2) { calm = false; multirate_.wake(j, tick_); }
+        }
+        if (calm) {
+            hold_[i] = a.accel(p, a.vel(), dt, VecD{}, snap_, neighbors(i), species_, world_, flow);
+            calm = norm(hold_[i]) < multirate_.accelThreshold;
+        }
+        multirate_.settle(i, tick_, calm);
+        multirate_.count(true);
+    }
+
+    VecD world_;
+    Agents              agents_;
+    std::span<const AgentD> snap_;                // ティック先頭の状態（arena_ 上）
+    typename Agents::Vector sortTmp_;             // 並べ替えの作業領域
+    FrameArena          arena_;
+    int                 arenaRegrows_{0};         // first-touch 済みのブロックの版
+    FlowMap       flow_;
+    BasicGrid<D>  grid_;
+    VisMap        vis_;
+    ThreadPool    pool_;
+    Placement     placement_;                     // NUMA ノードとスレッドの固定
+#ifdef __linux__
+    ForkCheckpoint ckpt_;                         // fork の COW で止まらないチェックポイント
+#endif
+    HotParams     params_;                        // 種のパラメータの差し替え（JSON + inotify）
+    BasicContactSolver<D> contact_;
+    SpeciesTable  species_;
+    AdaptiveStep  substep_;
+    Multirate     multirate_;
+    SoATail<D, Behavior::precision> soa_;
+    MortonOrder<D> morton_;
+    std::vector<VecD> hold_, holdTmp_;            // 休止中に使う加速度
+    bool renumbered_{false};                      // 遮蔽キャッシュを作った後に番号が付け替わった
+
+    StealScheduler sched_;                        // 知覚の並列化（セル区間タスク + 盗み）
+    Deterministic  det_;
+    Deterministic  fastRng_;                       // 並列の速いモードの乱数（種は実行ごと）
+    struct PosSpeed {
+        VecD p{}; float speed = 0;
+        PosSpeed operator+(const PosSpeed& o) const { return { p + o.p, speed + o.speed }; }
+    };
+    Reduction<PosSpeed> sumPS_;                   // metrics() の部分和
+    Reduction<float>    sumF_;
+    std::vector<std::vector<int>> nbrBuf_;        // 近傍リストの本体（タスクごと，直列なら [0] だけ）
+    std::vector<std::span<const int>> nbrOf_;     // 個体 i の近傍（nbrBuf_ の一部）
+    std::vector<std::pair<int,int>>   nbrOff_;    // 書き込み中の [off, end)
+    std::vector<std::vector<int>> cand_;          // スレッドごとの候補
+    std::vector<uint32_t> masks_;                 // 種ごとの知覚対象マスク
+    std::vector<VecD>  pos_;                      // 接触ソルバ用の作業配列
+    std::vector<float> rad_;
+    uint32_t tick_{0};
+    double   perceiveSec_{0};
+    double   driveSec_{0};
+};
+
+using World  = BasicWorld<2>;
+using World3 = BasicWorld<3>;
+
+// 送受信・ファイル用の 2D 個体 1 体ぶん（ID 付き．生のバイトで書き出せる）
+struct AgentRec {
+    uint64_t id;
+    Vec2     p, v, a;
+    float    radius, viewRad;
+    int32_t  species;
+
+    static AgentRec of(uint64_t id, const Agent& a) {
+        return AgentRec{ id, a.pos(), a.vel(), a.acc(), a.radius(), a.viewRadius(), a.species() };
+    }
+    Agent agent() const {
+        Agent g(p, v, radius, viewRad, species);
+        g.setState(p, v, a);
+        return g;
+    }
+};
+
+// ============================================================
+// ②' DomainWorld：短冊 1 本ぶんの 2D World（複数プロセスの領域分割．本体は boids/domain.hpp）
+// ============================================================
+template<class Transport, class Integrator = SemiImplicitEuler>
+using DomainWorld = BasicDomainWorld<Transport, AgentRec, Integrator>;
+
+#ifdef __linux__
+// ============================================================
+// ②'' StreamWorld：RAM に載らない群れをディスク上のチャンクで回す（本体は boids/stream.hpp）
+// ============================================================
+template<class Integrator = SemiImplicitEuler>
+using StreamWorld = BasicStreamWorld<AgentRec, Integrator>;
+#endif // __linux__
+
 // ============================================================
-// ② Renderer：GLFW初期化、背景色、エージェント描画
+// ③ Renderer：GLFW初期化、背景色、エージェント描画
 // ============================================================
 class Renderer {
 public:
@@ -156,6 +869,8 @@ public:
         window_ = glfwCreateWindow(W_, H_, title, nullptr, nullptr);
         if (!window_) { glfwTerminate(); ok_ = false; return; }
         glfwMakeContextCurrent(window_);
+        glfwSetWindowUserPointer(window_, this);
+        glfwSetMouseButtonCallback(window_, onMouseButton);
 
         glMatrixMode(GL_PROJECTION); glLoadIdentity();
         glOrtho(0, W_, H_, 0, -1, 1);
@@ -172,7 +887,8 @@ public:
 
     void beginFrame() const { glClearColor(bg_.r, bg_.g, bg_.b, 1.f); glClear(GL_COLOR_BUFFER_BIT); }
 
-    void drawAgent(const Agent& a) const {
+    template<class B>
+    void drawAgent(const BasicAgent<2, B>& a) const {
         const Vec2 p = a.pos();
         const float r = a.radius();
         glBegin(GL_TRIANGLE_FAN);
@@ -184,63 +900,2607 @@ public:
         }
         glEnd();
     }
-    void drawAgents(const std::vector<Agent>& agents) const {
-        glColor3f(0.9f, 0.1f, 0.1f);
-        for (const auto& a : agents) drawAgent(a);
+    template<class B, class A>
+    void drawAgents(const std::vector<BasicAgent<2, B>, A>& agents) const {
+        for (const auto& a : agents) {
+            const Color3& c = speciesColor(a.species());
+            glColor3f(c.r, c.g, c.b);
+            drawAgent(a);
+        }
+    }
+    // 3D：ワールド中心を通る鉛直(y)軸まわりに yaw 回した正射影．
+    // 奥から順に描き，奥ほど薄い色にする
+    template<class B, class A>
+    void drawAgents(const std::vector<BasicAgent<3, B>, A>& agents, const Vec3& world, float yaw) {
+        const float c = std::cos(yaw), s = std::sin(yaw);
+        const Vec3  mid = world * 0.5f;
+        const float span = std::max(std::sqrt(world.x*world.x + world.z*world.z), world.y);
+        const float scale = 0.95f * std::min(W_, H_) / span;
+        auto project = [&](const Vec3& p, float& depth){
+            const Vec3 q = p - mid;
+            depth = -q.x*s + q.z*c;
+            return Vec2{ W_*0.5f + (q.x*c + q.z*s) * scale, H_*0.5f + q.y * scale };
+        };
+
+        // 枠（立方体の 12 辺）
+        glColor3f(0.75f, 0.75f, 0.75f);
+        glBegin(GL_LINES);
+        for (int e = 0; e < 12; ++e) {
+            const int axis = e / 4, a = e % 4;   // axis 方向の辺，残り 2 軸の角 a
+            Vec3 p0{}, p1{};
+            const int o1 = (axis + 1) % 3, o2 = (axis + 2) % 3;
+            p0[o1] = p1[o1] = (a & 1) ? world[o1] : 0.f;
+            p0[o2] = p1[o2] = (a & 2) ? world[o2] : 0.f;
+            p0[axis] = 0.f; p1[axis] = world[axis];
+            float d;
+            const Vec2 q0 = project(p0, d), q1 = project(p1, d);
+            glVertex2f(q0.x, q0.y); glVertex2f(q1.x, q1.y);
+        }
+        glEnd();
+
+        order_.resize(agents.size());
+        depth_.resize(agents.size());
+        screen_.resize(agents.size());
+        for (size_t i = 0; i < agents.size(); ++i) {
+            screen_[i] = project(agents[i].pos(), depth_[i]);
+            order_[i] = (int)i;
+        }
+        std::sort(order_.begin(), order_.end(), [&](int a, int b){ return depth_[a] > depth_[b]; });
+        const float half = 0.5f * span;
+        for (int i : order_) {
+            const float t = std::clamp(0.5f + 0.5f * depth_[i] / half, 0.f, 1.f);  // 0 手前, 1 奥
+            const Color3& b = speciesColor(agents[i].species());
+            glColor3f(b.r + (1.f-b.r)*0.7f*t, b.g + (1.f-b.g)*0.7f*t, b.b + (1.f-b.b)*0.7f*t);
+            const Vec2  p = screen_[i];
+            const float r = agents[i].radius() * scale;
+            glBegin(GL_TRIANGLE_FAN);
+            glVertex2f(p.x, p.y);
+            const int seg = 12;
+            for (int k=0; k<=seg; ++k) {
+                float ang = 2.f*PI*k/seg;
+                glVertex2f(p.x + r*std::cos(ang), p.y + r*std::sin(ang));
+            }
+            glEnd();
+        }
+    }
+    // 障害物セル（灰）とゴール（緑）
+    void drawFlowField(const FlowField& f) const {
+        const float c = f.cellSize();
+        glColor3f(0.6f, 0.6f, 0.6f);
+        glBegin(GL_QUADS);
+        for (int i=0; i<f.size(); ++i) {
+            if (!f.blocked(i)) continue;
+            const Vec2 o = f.cellCenter(i) - Vec2{c*0.5f, c*0.5f};
+            glVertex2f(o.x, o.y);     glVertex2f(o.x+c, o.y);
+            glVertex2f(o.x+c, o.y+c); glVertex2f(o.x, o.y+c);
+        }
+        glEnd();
+        if (f.hasGoal()) {
+            const Vec2 g = f.cellCenter(f.goalCell());
+            glColor3f(0.1f, 0.7f, 0.2f);
+            glBegin(GL_TRIANGLE_FAN);
+            glVertex2f(g.x, g.y);
+            const int seg = 24;
+            for (int i=0; i<=seg; ++i) {
+                float ang = 2.f*PI*i/seg;
+                glVertex2f(g.x + 0.4f*c*std::cos(ang), g.y + 0.4f*c*std::sin(ang));
+            }
+            glEnd();
+        }
+    }
+    void endFrame() const { glfwSwapBuffers(window_); }     // イベントは入力タスクが pollInput() で取る
+
+    // 描画タスクの周期．スワップが垂直同期で待つ場合は，戻った時刻から kSwapLead 手前に
+    // 次の描画を置き直すので，ループが止まるのは 1 フレームあたり kSwapLead ほどで済む
+    static constexpr double kFrameHz = 60.0;
+    static constexpr auto   kSwapLead = std::chrono::milliseconds(2);
+
+    // ウィンドウのイベントとジョイスティック 1 の左スティック（不感帯 0.15，なければ 0）
+    void pollInput(Vec2& stick) const {
+        glfwPollEvents();
+        stick = Vec2{};
+        if (!glfwJoystickPresent(GLFW_JOYSTICK_1)) return;
+        int n = 0;
+        const float* ax = glfwGetJoystickAxes(GLFW_JOYSTICK_1, &n);
+        if (!ax || n < 2) return;
+        const Vec2 v{ ax[0], ax[1] };
+        if (std::fabs(v.x) > 0.15f || std::fabs(v.y) > 0.15f) stick = v;
+    }
+
+    // 種ごとの色（0: 赤 = 既定の群れ，1: 青 = 捕食者，…）
+    static const Color3& speciesColor(int s) {
+        static const Color3 palette[] = {
+            {0.9f, 0.1f, 0.1f}, {0.1f, 0.2f, 0.9f}, {0.1f, 0.6f, 0.2f},
+            {0.9f, 0.5f, 0.0f}, {0.6f, 0.1f, 0.7f}, {0.0f, 0.6f, 0.7f},
+        };
+        return palette[s % (int)(sizeof(palette)/sizeof(palette[0]))];
+    }
+
+    // 前フレーム以降のクリックを 1 つ取り出す（button: GLFW_MOUSE_BUTTON_*）
+    bool popClick(Vec2& p, int& button) {
+        if (clickButton_ < 0) return false;
+        p = click_; button = clickButton_;
+        clickButton_ = -1;
+        return true;
     }
-    void endFrame() const { glfwSwapBuffers(window_); glfwPollEvents(); }
 
 private:
     int W_, H_;
     bool ok_{true};
     GLFWwindow* window_{nullptr};
     Color3 bg_{1.f,1.f,1.f};
+    Vec2 click_{};
+    int  clickButton_{-1};
+    std::vector<int>   order_;    // 3D 描画の作業配列
+    std::vector<float> depth_;
+    std::vector<Vec2>  screen_;
+
+    static void onMouseButton(GLFWwindow* w, int button, int action, int){
+        if (action != GLFW_PRESS) return;
+        auto* self = static_cast<Renderer*>(glfwGetWindowUserPointer(w));
+        double x, y;
+        glfwGetCursorPos(w, &x, &y);
+        self->click_ = Vec2{(float)x, (float)y};
+        self->clickButton_ = button;
+    }
 };
 
 // ============================================================
-// ③ main：サンプリング・台数・領域・ループ
+// ④ main：サンプリング・台数・領域・ループ
 // ============================================================
-int main(){
-    const int   W   = 500;
-    const int   H   = 500;
-    const int   N   = 10;     // エージェント台数
-    const float R   = 5.f;    // 半径
-    const float VR  = 200.f;  // 視野半径
-    const double dt = 0.01;   // サンプリング [s]（100Hz）
 
-    std::srand((unsigned)std::time(nullptr));
+// 遮蔽なし / あり（キャッシュなし・あり）で知覚ステップの時間を比べる
+static int benchPerception(int N)
+{
+    const float W = 2000.f, H = 2000.f, VR = 100.f, CELL = 20.f;
+    const int   STEPS = 100;
+    std::printf("perception benchmark: N=%d, world=%.0fx%.0f, viewRad=%.0f, %d steps\n",
+                N, W, H, VR, STEPS);
+    std::printf("%-22s %12s %12s %12s %10s\n", "mode", "ms/tick", "rays/tick", "hits/tick", "blocked%");
 
-    Renderer renderer(W, H, "Boids (mass-damper, a->v->p)");
-    if (!renderer.good()) return -1;
-    renderer.setBackground(1.f, 1.f, 1.f);
+    struct Mode { const char* name; bool occl; int ttl; };
+    const Mode modes[] = {
+        {"occlusion off",        false, 0},
+        {"occlusion on, ttl=0",  true,  0},
+        {"occlusion on, ttl=1",  true,  1},
+        {"occlusion on, ttl=4",  true,  4},
+    };
+    for (const Mode& m : modes) {
+        std::srand(1);
+        World world(W, H, CELL, VR);
+        // 障害物：ランダムに 5% のセル
+        for (int c = 0; c < world.flow().size(); ++c)
+            if (std::rand() % 20 == 0) world.flow().setObstacle(c, true);
+        for (int i = 0; i < N; ++i) {
+            Vec2 p{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)H) };
+            Vec2 v{ (float)(std::rand() % 81 - 40), (float)(std::rand() % 81 - 40) };
+            world.spawn(p, v, 3.f, VR);
+        }
+        world.visibility().enabled = m.occl;
+        world.visibility().ttl     = m.ttl;
+
+        for (int s = 0; s < 10; ++s) world.step(0.01f);   // ウォームアップ
+        world.resetTimers();
+        for (int s = 0; s < STEPS; ++s) world.step(0.01f);
+
+        const auto& st = world.visibility().stats();
+        std::printf("%-22s %12.3f %12.0f %12.0f %9.1f%%\n", m.name,
+                    1e3 * world.perceiveSeconds() / STEPS,
+                    (double)st.rays / STEPS, (double)st.hits / STEPS,
+                    st.rays ? 100.0 * st.blocked / st.rays : 0.0);
+    }
+    return 0;
+}
+
+// 密に詰めた初期配置で接触ソルバを 1 回解き，反復回数ごとの残差と
+// スレッド数を変えたときの結果の一致（ビット単位）を確かめる
+static int benchContact(int N)
+{
+    const float W = 2000.f, H = 2000.f, R = 3.f;
+    const int   budgets[] = {1, 2, 4, 8, 16, 32};
+    const int   threads[] = {1, 2, 4, 8};
+    std::printf("contact benchmark: N=%d, r=%.0f, packed in %.0fx%.0f\n",
+                N, R, std::sqrt((float)N)*R*2.5f, std::sqrt((float)N)*R*2.5f);
+    std::printf("%6s %8s %10s %12s %12s %10s\n", "iters", "threads", "ms", "maxOverlap", "sumOverlap", "identical");
+
+    for (int iters : budgets) {
+        std::vector<Vec2> ref;
+        for (int T : threads) {
+            std::srand(1);
+            World world(W, H, 20.f, 50.f, T);
+            const float box = std::sqrt((float)N) * R * 2.5f;   // 充填率 ≒ 0.5
+            for (int i = 0; i < N; ++i) {
+                Vec2 p{ W*0.5f + ((float)std::rand()/RAND_MAX - 0.5f) * box,
+                        H*0.5f + ((float)std::rand()/RAND_MAX - 0.5f) * box };
+                world.spawn(p, Vec2{}, R, 50.f);
+            }
+            ContactSolver& cs = world.contact();
+            cs.iterations = iters;
+            cs.tolerance  = 0.f;
+
+            const auto t0 = std::chrono::steady_clock::now();
+            world.resolveContacts();
+            const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+            std::vector<Vec2> out;
+            for (const auto& a : world.agents()) out.push_back(a.pos());
+            bool same = true;
+            if (ref.empty()) ref = out;
+            else same = std::memcmp(ref.data(), out.data(), out.size()*sizeof(Vec2)) == 0;
+
+            const auto& r = cs.last();
+            std::printf("%6d %8d %10.3f %12.4f %12.2f %10s\n",
+                        iters, T, ms, r.maxOverlap, r.sumOverlap, same ? "yes" : "NO");
+        }
+    }
+    return 0;
+}
+
+// 総数 N を S 種に分けたときのティック時間．
+//   ring: 各種は自種 + 前後 1 種とだけ相互作用（走査する層は 3 つ）
+//   all : 全種どうしが相互作用（S=1 と同じ近傍数になる）
+static int benchSpecies(int N)
+{
+    const float W = 2000.f, H = 2000.f, VR = 100.f;
+    const int   STEPS = 100;
+    std::printf("species benchmark: N=%d, world=%.0fx%.0f, viewRad=%.0f, %d steps\n", N, W, H, VR, STEPS);
+    std::printf("%8s %8s %12s %12s %12s\n", "species", "matrix", "ms/tick", "perceive ms", "nbrs/agent");
+    for (int S : {1, 2, 4, 8, 16}) {
+        for (int full = 0; full < 2; ++full) {
+            if (S == 1 && full) continue;
+            std::srand(1);
+            World world(W, H, 20.f, VR, 1);
+            SpeciesTable& sp = world.species();
+            sp.resize(S);
+            for (int a = 0; a < S; ++a)
+                for (int b = 0; b < S; ++b) {
+                    if (a == b) continue;
+                    const bool ring = (b == (a+1)%S) || (a == (b+1)%S);
+                    if (full || ring) sp.setInteract(a, b, (b == (a+1)%S) ? 20.f : -20.f);
+                }
+            for (int i = 0; i < N; ++i) {
+                Vec2 p{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)H) };
+                world.spawn(p, Agent::randomDir() * 40.f, 3.f, VR, i % S);
+            }
+            for (int s = 0; s < 10; ++s) world.step(0.01f);
+            world.resetTimers();
+            long nb = 0;
+            const auto t0 = std::chrono::steady_clock::now();
+            for (int s = 0; s < STEPS; ++s) {
+                world.step(0.01f);
+                for (int i = 0; i < N; ++i) nb += (long)world.neighbors(i).size();
+            }
+            const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+            std::printf("%8d %8s %12.3f %12.3f %12.1f\n", S, full ? "all" : "ring", ms,
+                        1e3 * world.perceiveSeconds() / STEPS, (double)nb / N / STEPS);
+        }
+    }
+    return 0;
+}
+
+// 乱数項なし・接触なしの決定的な場面を T 秒積分し，最終位置を返す
+template<class I>
+static std::vector<Vec2> integrateScenario(int N, float dt, float T, double& ms)
+{
+    std::srand(7);
+    BasicWorld<2, I> world(1000.f, 1000.f, 20.f, 100.f, 1);
+    world.species().params(0).k_ran = 0.f;
+    for (int i = 0; i < N; ++i) {
+        Vec2 p{ 200.f + (std::rand() % 600), 200.f + (std::rand() % 600) };
+        world.spawn(p, Agent::randomDir() * (20.f + std::rand() % 40), 3.f, 100.f);
+    }
+    const int steps = (int)std::lround(T / dt);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) world.step(dt);
+    ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::vector<Vec2> out;
+    for (const auto& a : world.agents()) out.push_back(a.pos());
+    return out;
+}
+
+// 積分器 × dt ごとに，細かい刻みの RK4 を基準とした位置誤差と計算コストを比べる
+static int benchIntegrators(int N)
+{
+    const float T = 2.f, DT_REF = 0.0005f;
+    double ms;
+    const std::vector<Vec2> ref = integrateScenario<RK4>(N, DT_REF, T, ms);
+    std::printf("integrator benchmark: N=%d, T=%.1fs, reference RK4 dt=%g (%.0f ms)\n", N, T, DT_REF, ms);
+    std::printf("%-20s %8s %12s %12s %10s %12s\n", "integrator", "dt", "rms err", "max err", "ms", "force evals");
+
+    auto row = [&]<class I>(float dt) {
+        double t;
+        const std::vector<Vec2> p = integrateScenario<I>(N, dt, T, t);
+        double se = 0, me = 0;
+        for (size_t i = 0; i < p.size(); ++i) {
+            const double e = norm(p[i] - ref[i]);
+            se += e*e; me = std::max(me, e);
+        }
+        const long evals = (long)std::lround(T / dt) * I::evals * N;
+        std::printf("%-20s %8g %12.4f %12.4f %10.2f %12ld\n",
+                    I::name, dt, std::sqrt(se / p.size()), me, t, evals);
+    };
+    for (float dt : {0.005f, 0.01f, 0.02f, 0.04f, 0.08f}) {
+        row.template operator()<SemiImplicitEuler>(dt);
+        row.template operator()<VelocityVerlet>(dt);
+        row.template operator()<RK4>(dt);
+    }
+    return 0;
+}
+
+// 穏やか（疎に一様配置）/ 混雑（中心の小円に詰め込む）の場面を T 秒積分する
+//   adaptive なら局所的な硬さに応じてサブステップ，そうでなければ固定 dt
+static std::vector<Vec2> substepScenario(int N, bool crowd, float dt, bool adaptive, float T,
+                                         double& ms, AdaptiveStep::Stats& st)
+{
+    std::srand(11);
+    World world(1000.f, 1000.f, 20.f, 100.f, 1);
+    world.species().params(0).k_ran = 0.f;
+    world.substep().enabled = adaptive;
+    for (int i = 0; i < N; ++i) {
+        const Vec2 p = crowd ? Vec2{500.f, 500.f} + Agent::randomDir() * (15.f * (float)std::rand() / RAND_MAX)
+                             : Vec2{ 100.f + (std::rand() % 800), 100.f + (std::rand() % 800) };
+        world.spawn(p, Agent::randomDir() * (20.f + std::rand() % 40), 3.f, 100.f);
+    }
+    const int steps = (int)std::lround(T / dt);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) world.step(dt);
+    ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    st = world.substep().stats();
+
+    std::vector<Vec2> out;
+    for (const auto& a : world.agents()) out.push_back(a.pos());
+    return out;
+}
+
+// 固定 dt と適応サブステップを，細かい固定刻みを基準とした誤差とコストで比べる
+static int benchSubstep(int N)
+{
+    const float T = 1.f, DT_REF = 0.0005f;
+    std::printf("substep benchmark: N=%d, T=%.1fs, reference fixed dt=%g\n", N, T, DT_REF);
+    std::printf("%-6s %-9s %8s %10s %10s %9s %9s %8s %12s\n",
+                "scene", "stepping", "dt", "rms err", "max err", "ms", "subs/agt", "refined", "force evals");
+    for (int crowd = 0; crowd < 2; ++crowd) {
+        double ms;
+        AdaptiveStep::Stats st;
+        const std::vector<Vec2> ref = substepScenario(N, crowd, DT_REF, false, T, ms, st);
+        struct Mode { float dt; bool adaptive; };
+        for (Mode m : {Mode{0.0025f, false}, Mode{0.01f, false}, Mode{0.04f, false},
+                       Mode{0.01f, true}, Mode{0.04f, true}}) {
+            const std::vector<Vec2> p = substepScenario(N, crowd, m.dt, m.adaptive, T, ms, st);
+            double se = 0, me = 0;
+            for (size_t i = 0; i < p.size(); ++i) {
+                const double e = norm(p[i] - ref[i]);
+                se += e*e; me = std::max(me, e);
+            }
+            const long ticks = std::lround(T / m.dt);
+            const double subs = m.adaptive ? (double)st.substeps / st.agentTicks : 1.0;
+            const double refined = m.adaptive ? 100.0 * st.refined / st.agentTicks : 0.0;
+            const long evals = m.adaptive ? (long)st.substeps : ticks * N;
+            std::printf("%-6s %-9s %8g %10.4f %10.4f %9.2f %9.2f %7.1f%% %12ld\n",
+                        crowd ? "crowd" : "calm", m.adaptive ? "adaptive" : "fixed", m.dt,
+                        std::sqrt(se / p.size()), me, ms, subs, refined, evals);
+        }
+    }
+    return 0;
+}
+
+// 落ち着いた群れ（乱数項なし，ウォームアップ後）を毎ティック更新と
+// Multirate（周期 k）で進め，省いた更新の割合と軌道の誤差を比べる
+static int benchMultirate(int N)
+{
+    const float W = 2000.f, H = 2000.f, VR = 100.f, dt = 0.01f;
+    const int   WARMUP = 300, STEPS = 300;
+    std::printf("multirate benchmark: N=%d, world=%.0fx%.0f, viewRad=%.0f, %d warmup + %d steps\n",
+                N, W, H, VR, WARMUP, STEPS);
+    std::printf("%8s %10s %10s %12s %10s %10s %10s %10s\n",
+                "period", "threshold", "ms/tick", "perceive ms", "updated%", "wakes", "rms err", "max err");
+
+    struct Mode { int period; float threshold; };
+    std::vector<Vec2> ref;
+    for (Mode m : {Mode{1, 0.f}, Mode{2, 2.f}, Mode{4, 2.f}, Mode{8, 2.f}, Mode{4, 0.5f}, Mode{8, 0.5f}}) {
+        std::srand(5);
+        World world(W, H, 20.f, VR, 1);
+        world.species().params(0).k_ran = 0.f;
+        for (int i = 0; i < N; ++i) {
+            Vec2 p{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)H) };
+            world.spawn(p, Agent::randomDir() * 40.f, 3.f, VR);
+        }
+        for (int s = 0; s < WARMUP; ++s) world.step(dt);
+        Multirate& mr = world.multirate();
+        mr.enabled        = m.period > 1;
+        mr.period         = m.period;
+        mr.accelThreshold = m.threshold;
+        world.resetTimers();
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) world.step(dt);
+        const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+
+        std::vector<Vec2> p;
+        for (const auto& a : world.agents()) p.push_back(a.pos());
+        if (ref.empty()) ref = p;
+        double se = 0, me = 0;
+        for (size_t i = 0; i < p.size(); ++i) {
+            const double e = norm(p[i] - ref[i]);
+            se += e*e; me = std::max(me, e);
+        }
+        const auto& st = mr.stats();
+        const double upd = mr.enabled ? 100.0 * st.updated / st.agentTicks : 100.0;
+        std::printf("%8d %10g %10.3f %12.3f %9.1f%% %10llu %10.4f %10.4f\n",
+                    m.period, m.threshold, ms, 1e3 * world.perceiveSeconds() / STEPS, upd,
+                    (unsigned long long)st.wakes, std::sqrt(se / p.size()), me);
+    }
+    return 0;
+}
+
+// 力の項の組み合わせごとに，全項入り（使わない項のゲインを 0 にしただけ）と
+// Behavior<...> で項を選んだ実体化の力計算＋積分時間を比べる
+template<class B, class Enabled = B>
+static double behaviorDriveMs(int N, int steps)
+{
+    std::srand(3);
+    const float W = 2000.f, H = 2000.f, VR = 100.f;
+    BasicWorld<2, SemiImplicitEuler, B> world(W, H, 20.f, VR, 1);
+    SpeciesParams& P = world.species().params(0);
+    if (!Enabled::template has<Separation>) P.k_sep  = 0.f;
+    if (!Enabled::template has<Alignment>)  P.k_ali  = 0.f;
+    if (!Enabled::template has<Cohesion>)   P.k_coh  = 0.f;
+    if (!Enabled::template has<Wall>)       P.k_wall = 0.f;
+    if (!Enabled::template has<RandomWalk>) P.k_ran  = 0.f;
+    if (!Enabled::template has<Goal>)       P.k_goal = 0.f;
+    for (int i = 0; i < N; ++i) {
+        Vec2 p{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)H) };
+        world.spawn(p, Vec2{ (float)(std::rand() % 81 - 40), (float)(std::rand() % 81 - 40) }, 3.f, VR);
+    }
+    for (int s = 0; s < 5; ++s) world.step(0.01f);
+    world.resetTimers();
+    for (int s = 0; s < steps; ++s) world.step(0.01f);
+    return 1e3 * world.driveSeconds() / steps;
+}
+
+static int benchBehavior(int N)
+{
+    const int STEPS = 50;
+    std::printf("behavior benchmark: N=%d, %d steps, drive (forces + integration) ms/tick\n", N, STEPS);
+    std::printf("%-26s %12s %14s %9s\n", "terms", "runtime", "compile-time", "speedup");
+    auto row = [&]<class... T>(const char* name) {
+        // runtime: 全項入りのまま使わない項のゲインを 0 に（従来の Agent と同じ）
+        const double rt = behaviorDriveMs<FullBoids, Behavior<T...>>(N, STEPS);
+        const double ct = behaviorDriveMs<Behavior<T...>>(N, STEPS);
+        std::printf("%-26s %12.3f %14.3f %8.2fx\n", name, rt, ct, rt / ct);
+    };
+    row.template operator()<Separation, Alignment, Cohesion, Wall, RandomWalk, Goal, Interaction>("all");
+    row.template operator()<Separation, Alignment, Cohesion, Wall>("sep+ali+coh+wall");
+    row.template operator()<Separation, Alignment, Wall>("sep+ali+wall");
+    row.template operator()<Separation, Wall>("sep+wall");
+    row.template operator()<Alignment, Cohesion>("ali+coh");
+    return 0;
+}
+
+// 小さな群れの 1 ステップの遅延 [ns]：FixedFlock<N>（固定容量・全対・展開）と World
+// 乱数項なしで同じ初期状態から 100 ステップ進めたときの位置の差も出す（和の順序の違いだけ）
+template<int N>
+static void benchFixedRow()
+{
+    const float S = 500.f, VR = 200.f, dt = 0.01f;
+    const int   STEPS = 200000 / N;
+    std::srand(9);
+    FixedFlock<N> ff(Vec2{S, S}, 3.f, VR);
+    ff.params().k_ran = 0.f;
+    World world(S, S, 20.f, VR, 1);
+    world.species().params(0).k_ran = 0.f;
+    for (int i = 0; i < N; ++i) {
+        const Vec2 p{ 100.f + std::rand() % 300, 100.f + std::rand() % 300 };
+        const Vec2 v = Agent::randomDir() * (40.f + std::rand() % 60);
+        ff.set(i, p, v);
+        world.spawn(p, v, 3.f, VR);
+    }
+    for (int s = 0; s < 100; ++s) { ff.step(dt); world.step(dt); }
+    float dev = 0.f;
+    for (int i = 0; i < N; ++i) dev = std::max(dev, norm(ff.pos(i) - world.agents()[i].pos()));
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < STEPS; ++s) ff.step(dt);
+    const double nsFixed = 1e9 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+    t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < STEPS; ++s) world.step(dt);
+    const double nsWorld = 1e9 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+    std::printf("%4d %14.0f %14.0f %9.2fx %14.2e\n", N, nsFixed, nsWorld, nsWorld / nsFixed, dev);
+}
+
+static int benchFixed()
+{
+    std::printf("fixed-capacity benchmark: ns per step (all agents), 1 thread\n");
+    std::printf("%4s %14s %14s %10s %14s\n", "N", "FixedFlock", "World", "speedup", "max |dp| @100");
+    benchFixedRow<8>();
+    benchFixedRow<16>();
+    benchFixedRow<32>();
+    benchFixedRow<64>();
+    return 0;
+}
+
+// 後処理（壁・a・制限・積分・クランプ）だけの比較：
+//   AoS で個体ごとに if を使う従来の書き方と SoATail（SSE・分岐なし）を
+//   大きな配列で比べ（力はランダムで半分ほどが制限にかかる），World 全体でも比べる
+static int benchTail(int N)
+{
+    const int   M = 1 << 20, REPS = 20;
+    const float W = 2000.f, dt = 0.01f;
+    std::srand(4);
+    struct Row { Vec2 p, v, f; float invM, damp, vmax, amax, kwall, rad; };
+    std::vector<Row> aos(M);
+    SoATail<2> soa;
+    soa.resize(M);
+    for (int i = 0; i < M; ++i) {
+        Row& r = aos[i];
+        r.p = Vec2{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)W) };
+        r.v = Agent::randomDir() * (float)(std::rand() % 140);
+        r.f = Agent::randomDir() * (float)(std::rand() % 200);
+        r.invM = 1.f; r.damp = 1.f; r.vmax = 100.f; r.amax = 100.f; r.kwall = 2.f; r.rad = 3.f;
+        for (int k = 0; k < 2; ++k) { soa.p[k][i] = r.p[k]; soa.v[k][i] = r.v[k]; soa.f[k][i] = r.f[k]; }
+        soa.invM[i] = r.invM; soa.damp[i] = r.damp; soa.vmax[i] = r.vmax;
+        soa.amax[i] = r.amax; soa.kwall[i] = r.kwall; soa.rad[i] = r.rad;
+    }
+    auto aosPass = [&]{
+        const float margin = 10.f;
+        for (Row& r : aos) {
+            Vec2 F = r.f;
+            for (int k = 0; k < 2; ++k) {
+                if (r.p[k] < margin)     F[k] += r.kwall * (margin - r.p[k]);
+                if (r.p[k] > W - margin) F[k] -= r.kwall * (r.p[k] - (W - margin));
+            }
+            Vec2 a = (F - r.v * r.damp) * r.invM;
+            float an = norm(a);
+            if (an > r.amax) a = a * (r.amax / (an + 1e-6f));
+            r.v += a * dt;
+            float vn = norm(r.v);
+            if (vn > r.vmax) r.v = r.v * (r.vmax / (vn + 1e-6f));
+            r.p += r.v * dt;
+            for (int k = 0; k < 2; ++k) {
+                if (r.p[k] < r.rad)     r.p[k] = r.rad;
+                if (r.p[k] > W - r.rad) r.p[k] = W - r.rad;
+            }
+        }
+    };
+    auto time = [&](auto&& pass) {
+        pass();
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPS; ++r) pass();
+        return 1e9 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / REPS / M;
+    };
+    const double nsAos = time(aosPass);
+    const double nsSoa = time([&]{ soa.run(M, dt, Vec2{W, W}, true); });
+    // 1 体あたりに動かすバイト数（両方とも同じ数え方）：
+    //   読み p, v, f（2 成分ずつ 6 float）+ 定数 invM, damp, vmax, amax, kwall, rad（6 float）
+    //   書き AoS は p, v（4 float），SoA は p, v, a（6 float）
+    const double readBytes = (3*2 + 6) * sizeof(float);
+    const double bytesAos  = readBytes + 2*2 * sizeof(float);
+    const double bytesSoa  = readBytes + 3*2 * sizeof(float);
+    std::printf("tail pass: %d agents, %d reps\n", M, REPS);
+    std::printf("%-24s %10s %10s %10s\n", "layout", "ns/agent", "B/agent", "GB/s");
+    std::printf("%-24s %10.2f %10.0f %10.2f\n", "AoS, branches", nsAos, bytesAos, bytesAos / nsAos);
+    std::printf("%-24s %10.2f %10.0f %10.2f\n", "SoA, SSE branch-free", nsSoa, bytesSoa, bytesSoa / nsSoa);
+
+    std::printf("\nworld drive (forces + tail), N=%d, 100 steps, 1 thread\n", N);
+    std::printf("%-24s %10s\n", "tail", "ms/tick");
+    for (int on = 0; on < 2; ++on) {
+        std::srand(5);
+        World world(W, W, 20.f, 100.f, 1);
+        world.soa().enabled = on;
+        for (int i = 0; i < N; ++i) {
+            Vec2 p{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)W) };
+            world.spawn(p, Agent::randomDir() * 40.f, 3.f, 100.f);
+        }
+        for (int s = 0; s < 5; ++s) world.step(dt);
+        world.resetTimers();
+        for (int s = 0; s < 100; ++s) world.step(dt);
+        std::printf("%-24s %10.3f\n", on ? "SoA pass" : "per-agent (AoS)", 1e3 * world.driveSeconds() / 100);
+    }
+    return 0;
+}
+
+// ハードウェアのキャッシュミス計数（Linux の perf_event_open）．
+// 権限がない・仮想環境で使えないときは ok() が false で，計測値は出さない
+struct CacheMissCounter {
+    int fd = -1;
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr pe{};
+        pe.type   = PERF_TYPE_HARDWARE;
+        pe.size   = sizeof(pe);
+        pe.config = PERF_COUNT_HW_CACHE_MISSES;
+        pe.disabled = 1;
+        pe.exclude_kernel = 1;
+        pe.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+#endif
+    }
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+    bool ok() const { return fd >= 0; }
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_RESET, 0); ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+#endif
+    }
+    long long stop() {
+        long long c = 0;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &c, sizeof(c)) != (ssize_t)sizeof(c)) c = 0;
+        }
+#endif
+        return c;
+    }
+};
+
+// Morton 順の並べ替えあり/なしで，ランダムな順に並んだ群れのティック時間・
+// キャッシュミス・近傍の配列上の距離（|i - j| の平均）を比べる．
+// 乱数項なしで同じ初期状態から進め，並べ替え後もハンドルで同じ個体を追えることも確かめる
+static int benchMorton(int N)
+{
+    const float S = 4000.f, VR = 50.f, dt = 0.01f;
+    const int   WARMUP = 10, STEPS = 100;
+    CacheMissCounter pmc;
+    std::printf("morton benchmark: N=%d, world=%.0fx%.0f, viewRad=%.0f, %d steps, cache misses: %s\n",
+                N, S, S, VR, STEPS, pmc.ok() ? "perf_event" : "unavailable");
+    std::printf("%-10s %10s %12s %10s %10s %14s %12s\n",
+                "order", "ms/tick", "perceive ms", "drive ms", "sort ms", "misses/tick", "mean |i-j|");
+    std::vector<Vec2> ref;
+    float dev = 0.f;
+    bool idsOk = true;
+    for (int period : {0, 64, 16}) {
+        std::srand(17);
+        World world(S, S, 20.f, VR, 1);
+        world.species().params(0).k_ran = 0.f;
+        std::vector<Handle> hs;
+        for (int i = 0; i < N; ++i) {
+            Vec2 p{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) };
+            hs.push_back(world.spawn(p, Agent::randomDir() * 40.f, 3.f, VR));
+        }
+        world.morton().enabled = period > 0;
+        world.morton().period  = period;
+        for (int s = 0; s < WARMUP; ++s) world.step(dt);
+        world.resetTimers();
+        pmc.start();
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) world.step(dt);
+        const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+        const long long misses = pmc.stop();
+
+        double dist = 0;
+        long pairs = 0;
+        for (int i = 0; i < N; ++i)
+            for (int j : world.neighbors(i)) { dist += std::abs(i - j); ++pairs; }
 
-    std::vector<Agent> agents;
-    agents.reserve(N);
+        // 生成順（ハンドル）に位置を並べ直して，並べ替えなしの結果と比べる
+        std::vector<Vec2> byId(N);
+        for (int id = 0; id < N; ++id) {
+            const int i = world.indexOf(hs[id]);
+            if (i < 0 || !(world.handleAt(i) == hs[id])) { idsOk = false; continue; }
+            byId[id] = world.agents()[i].pos();
+        }
+        if (ref.empty()) ref = byId;
+        else for (int id = 0; id < N; ++id) dev = std::max(dev, norm(byId[id] - ref[id]));
+
+        char label[16], miss[24];
+        std::snprintf(label, sizeof(label), period ? "every %d" : "none", period);
+        if (pmc.ok()) std::snprintf(miss, sizeof(miss), "%.0f", (double)misses / STEPS);
+        else          std::snprintf(miss, sizeof(miss), "n/a");
+        std::printf("%-10s %10.3f %12.3f %10.3f %10.3f %14s %12.0f\n", label, ms,
+                    1e3 * world.perceiveSeconds() / STEPS, 1e3 * world.driveSeconds() / STEPS,
+                    1e3 * world.morton().stats().seconds / STEPS, miss, pairs ? dist / pairs : 0.0);
+    }
+    std::printf("handles: %s, max |dp| by handle vs unsorted: %.2e (summation order only)\n",
+                idsOk ? "ok" : "BROKEN", dev);
+    return idsOk ? 0 : 1;
+}
+
+// 個体の生成・消滅を毎ティック繰り返したときのコストとハンドルの正しさ：
+//   毎ティック個体数の rate だけランダムに消して同じ数を生み，
+//   生きているハンドルが自分の個体を指すこと，消したハンドルが nullptr になること，
+//   reserve した配列が再確保されないことを確かめる（Morton 並べ替えありでも）
+static int benchPopulation(int N)
+{
+    const float S = 3000.f, VR = 50.f, dt = 0.01f;
+    const int   STEPS = 100;
+    std::printf("population benchmark: N=%d, world=%.0fx%.0f, %d steps of spawn/despawn churn\n", N, S, S, STEPS);
+    std::printf("%8s %8s %10s %14s %10s %10s\n", "churn", "morton", "ms/tick", "ns/(spawn+kill)", "handles", "reallocs");
+    bool ok = true;
+    for (int morton : {0, 16}) {
+        for (float rate : {0.f, 0.01f, 0.1f}) {
+            std::srand(23);
+            World world(S, S, 20.f, VR, 1);
+            world.reserve(N);
+            world.morton().enabled = morton > 0;
+            world.morton().period  = morton;
+            auto born = [&]{
+                Vec2 p{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) };
+                return world.spawn(p, Agent::randomDir() * 40.f, 3.f, VR);
+            };
+            std::vector<Handle> live, dead;
+            for (int i = 0; i < N; ++i) live.push_back(born());
+            for (int s = 0; s < 5; ++s) world.step(dt);
+            const size_t cap = world.agents().capacity();
+            const int K = (int)(rate * N);
+            int reallocs = 0;
+            double churnSec = 0;
+            world.resetTimers();
+            const auto t0 = std::chrono::steady_clock::now();
+            for (int s = 0; s < STEPS; ++s) {
+                const auto c0 = std::chrono::steady_clock::now();
+                for (int k = 0; k < K; ++k) {
+                    const int j = std::rand() % (int)live.size();
+                    if (!world.despawn(live[j])) ok = false;
+                    dead.push_back(live[j]);
+                    live[j] = born();
+                }
+                churnSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - c0).count();
+                world.step(dt);
+                if (world.agents().capacity() != cap) { ++reallocs; }
+            }
+            const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+
+            bool handlesOk = world.population() == (int)live.size();
+            for (Handle h : live) {
+                const int i = world.indexOf(h);
+                if (i < 0 || !(world.handleAt(i) == h) || world.get(h) != &world.agents()[i]) handlesOk = false;
+            }
+            for (Handle h : dead) if (world.get(h)) handlesOk = false;
+            ok = ok && handlesOk && reallocs == 0;
+            std::printf("%7.0f%% %8s %10.3f %14.1f %10s %10d\n", 100.f * rate, morton ? "on" : "off", ms,
+                        K ? 1e9 * churnSec / ((double)K * STEPS) : 0.0, handlesOk ? "ok" : "BROKEN", reallocs);
+        }
+    }
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// 定常ループがヒープ確保をしないことの検査：機能ごとに World を組み，
+// ウォームアップ後の 1000 ティック（100 Hz で 10 秒）の operator new 回数を数える．
+// 1 回でもあれば失敗（どのティックで何回かを出す）
+template<class WorldT, class Setup>
+static bool allocRun(const char* name, int N, Setup&& setup)
+{
+    constexpr int D = WorldT::dim;
+    const int WARMUP = 100, STEPS = 1000;
+    std::srand(29);
+    Vec<D> ext;
+    for (int k = 0; k < D; ++k) ext[k] = 1000.f;
+    WorldT world(ext, 20.f, 50.f, 1);
+    world.reserve(N, 256);                     // 近傍の件数だけは負荷次第（ゴールに集まると 60 件超）
+    for (int i = 0; i < N; ++i) {
+        Vec<D> p;
+        for (int k = 0; k < D; ++k) p[k] = 50.f + std::rand() % 900;
+        world.spawn(p, WorldT::AgentD::randomDir() * 40.f, 3.f, 50.f);
+    }
+    setup(world);
+    for (int s = 0; s < WARMUP; ++s) world.step(0.01f);
+    uint64_t total = 0, worst = 0;
+    int first = -1;
+    double nbrs = 0;
+    for (int s = 0; s < STEPS; ++s) {
+        const uint64_t n0 = AllocCounter::news();
+        world.step(0.01f);
+        const uint64_t n = AllocCounter::news() - n0;
+        total += n;
+        worst = std::max(worst, n);
+        if (n && first < 0) first = s;
+        size_t k = 0;
+        for (int i = 0; i < world.population(); ++i) k += world.neighbors(i).size();
+        nbrs = std::max(nbrs, (double)k / N);
+    }
+    std::printf("%-22s %10llu %10llu %10d %12zu %10.1f %s\n", name, (unsigned long long)total,
+                (unsigned long long)worst, first, world.arena().highWater(), nbrs, total ? "FAIL" : "ok");
+    return total == 0;
+}
+
+static int checkAlloc(int N)
+{
+    if (!BOIDS_COUNT_ALLOC) {
+        std::printf("alloc check: operator new is not counted; rebuild with -DBOIDS_COUNT_ALLOC=1 (CMake: -DBOIDS_COUNT_ALLOC=ON)\n");
+        return 1;
+    }
+    std::printf("alloc check: N=%d, 100 warmup + 1000 ticks at dt=0.01, operator new calls in the loop\n", N);
+    std::printf("%-22s %10s %10s %10s %12s %10s\n", "configuration", "news", "max/tick", "first", "arena bytes", "peak nbrs");
+    bool ok = true;
+    ok &= allocRun<World>("2D euler", N, [](auto&){});
+    ok &= allocRun<World>("2D +visibility", N, [](auto& w){ w.visibility().enabled = true; });
+    ok &= allocRun<World>("2D +contact", N, [](auto& w){ w.contact().enabled = true; });
+    ok &= allocRun<World>("2D +multirate 4", N, [](auto& w){ w.multirate().enabled = true; w.multirate().period = 4; });
+    ok &= allocRun<World>("2D +adaptive", N, [](auto& w){ w.substep().enabled = true; });
+    ok &= allocRun<World>("2D +morton 16", N, [](auto& w){ w.morton().enabled = true; w.morton().period = 16; });
+    ok &= allocRun<World>("2D +goal", N, [](auto& w){ w.flow().setGoal(Vec2{800.f, 800.f}); });
+    ok &= allocRun<BasicWorld<2, RK4>>("2D rk4", N, [](auto&){});
+    ok &= allocRun<BasicWorld<3>>("3D euler +contact", N, [](auto& w){ w.contact().enabled = true; });
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// 量子化した詰めた状態（CompactFlock）と float の p, v, a を同じ場・同じ式で進め（後半は近傍の群れを World と），
+// 1 体あたりのバイト数・スループット・軌道の誤差を比べる．場は中心まわりの渦と壁
+static int benchCompact(int N)
+{
+    const float S = 4096.f, C = 64.f, dt = 0.01f;
+    const Vec2 center{ S * 0.5f, S * 0.5f };
+    auto swirl = [&](const Vec2& p, const Vec2&) {
+        const Vec2 r = p - center;
+        return Vec2{ -r.y, r.x } * (60.f / (norm(r) + 1.f));
+    };
+    auto drift = [](const Vec2&, const Vec2&) { return Vec2{}; };
+    SpeciesParams P;
+    auto floatStep = [&](std::vector<Vec2>& p, std::vector<Vec2>& v, std::vector<Vec2>& a, auto&& field) {
+        const float margin = 10.f;
+        for (size_t i = 0; i < p.size(); ++i) {
+            Vec2 w{};
+            for (int k = 0; k < 2; ++k) {
+                if (p[i][k] < margin)     w[k] += P.k_wall * (margin - p[i][k]);
+                if (p[i][k] > S - margin) w[k] -= P.k_wall * (p[i][k] - (S - margin));
+            }
+            Vec2 ai = (field(p[i], v[i]) + w - v[i] * P.D) * (1.0f / P.M);
+            const float an = norm(ai);
+            if (an > P.Amax) ai = ai * (P.Amax / (an + 1e-6f));
+            Vec2 vi = v[i] + ai * dt;
+            const float vn = norm(vi);
+            if (vn > P.Vmax) vi = vi * (P.Vmax / (vn + 1e-6f));
+            Vec2 pi = p[i] + vi * dt;
+            for (int k = 0; k < 2; ++k) pi[k] = std::min(std::max(pi[k], 3.f), S - 3.f);
+            p[i] = pi; v[i] = vi; a[i] = ai;
+        }
+    };
+    auto init = [&](int n, std::vector<Vec2>& p, std::vector<Vec2>& v) {
+        std::srand(31);
+        p.resize(n); v.resize(n);
+        for (int i = 0; i < n; ++i) {
+            p[i] = Vec2{ 10.f + (float)std::rand() / RAND_MAX * (S - 20.f), 10.f + (float)std::rand() / RAND_MAX * (S - 20.f) };
+            v[i] = Agent::randomDir() * (20.f + std::rand() % 60);
+        }
+    };
+
+    std::printf("compact state benchmark: world=%.0fx%.0f, cell=%.0f, swirl field + wall, dt=%g\n", S, S, C, dt);
+    std::printf("bytes/agent: float p,v,a %zu (2D) / %zu (3D), compact %zu (2D) / %zu (3D) incl. 4-byte id\n",
+                3 * sizeof(Vec2), 3 * sizeof(Vec3), CompactFlock<2>::bytesPerAgent(), CompactFlock<3>::bytesPerAgent());
+
+    // スループット（大きな N）．場なし（減衰・壁・制限だけ）と渦の 2 通り
+    auto throughput = [&](const char* name, auto&& field) {
+        const int STEPS = 10;
+        std::vector<Vec2> p, v, a;
+        init(N, p, v);
+        a.assign(N, Vec2{});
+        CompactFlock<2> cf(Vec2{S, S}, C, 3.f, P);
+        cf.assign(p, v);
+        cf.step(dt, field);                                // 1 回目（ページフォルトなど）は外す
+        floatStep(p, v, a, field);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) floatStep(p, v, a, field);
+        const double fl = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+        t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) cf.step(dt, field);
+        const double cp = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+        std::printf("%-6s %8.1f %10.1f %8.2f %10.1f %10.1f %8.2f %8d\n", name,
+                    1e3 * fl, N / fl * 1e-6, 2.0 * 3 * sizeof(Vec2) * N / fl * 1e-9,
+                    1e3 * cp, N / cp * 1e-6, 2.0 * CompactFlock<2>::bytesPerAgent() * N / cp * 1e-9, cf.rebins());
+    };
+    std::printf("N=%d, ms/step, Magents/s and state traffic GB/s (read + write)\n", N);
+    std::printf("%-6s %8s %10s %8s %10s %10s %8s %8s\n", "field", "float", "Magt/s", "GB/s", "compact", "Magt/s", "GB/s", "rebins");
+    throughput("drift", drift);
+    throughput("swirl", swirl);
+
+    // 軌道の誤差（小さな N で長く）
+    {
+        const int M = 20000;
+        std::printf("%8s %12s %12s %12s %8s\n", "step", "rms |dp|", "max |dp|", "rms |dv|", "rebins");
+        std::vector<Vec2> p, v, a, cp, cv;
+        init(M, p, v);
+        a.assign(M, Vec2{});
+        CompactFlock<2> cf(Vec2{S, S}, C, 3.f, P);
+        cf.assign(p, v);
+        for (int s = 1; s <= 2000; ++s) {
+            floatStep(p, v, a, swirl);
+            cf.step(dt, swirl);
+            if (s == 1 || s == 10 || s == 100 || s == 1000 || s == 2000) {
+                cf.unpack(cp, cv);
+                double sp = 0, mp = 0, sv = 0;
+                for (int i = 0; i < M; ++i) {
+                    const double ep = norm(cp[i] - p[i]), ev = norm(cv[i] - v[i]);
+                    sp += ep * ep; mp = std::max(mp, ep); sv += ev * ev;
+                }
+                std::printf("%8d %12.5f %12.5f %12.5f %8d\n", s, std::sqrt(sp / M), mp, std::sqrt(sv / M), cf.rebins());
+            }
+        }
+        std::printf("position quantum %.5f px, velocity relative quantum %.1e\n", C / 32768.f, 1.0 / 2048);
+    }
+
+    // 近傍の群れ：World（決定的モード・1 スレッド・全項）と flockStep を同じ初期状態・同じ乱数
+    // （系列 = 生成順の番号 = 初期のハンドル）で進め，バイト数・スループットと World の軌道からのずれを比べる．
+    // 群れは混沌的なので，初期位置を 1 ulp ずらした World のずれも並べて基準にする
+    {
+        const float VR = 20.f, FC = VR * 0.5f;             // セル幅は World の格子と同じ（視野半径の半分）
+        auto setup = [&](World& w, int n, bool nudge) {
+            const float FS = w.width();
+            std::srand(37);
+            w.deterministic().enabled = true;
+            w.reserve(n);
+            for (int i = 0; i < n; ++i) {
+                Vec2 p{ 10.f + (float)std::rand() / RAND_MAX * (FS - 20.f), 10.f + (float)std::rand() / RAND_MAX * (FS - 20.f) };
+                if (nudge) p[0] = std::nextafter(p[0], FS);
+                w.spawn(p, Agent::randomDir() * (20.f + std::rand() % 60), 3.f, VR);
+            }
+        };
+        auto pack = [&](World& w, CompactFlock<2>& cf) {
+            std::vector<Vec2> p, v;
+            for (const auto& a : w.agents()) { p.push_back(a.pos()); v.push_back(a.vel()); }
+            cf.assign(p, v);
+        };
+        auto flock = [&](World& w, CompactFlock<2>& cf, uint32_t tick) {
+            const float kr = w.species().params(0).k_ran;
+            cf.flockStep<FullBoids>(dt, VR, [&](uint32_t id){
+                return Agent::randomDir(RandomDraw{ &w.deterministic(), id, tick }) * 30.f * kr;
+            });
+        };
+        auto stats = [](const std::vector<Vec2>& p, const std::vector<Vec2>& v) {
+            Vec2 c{};
+            double spd = 0, spread = 0;
+            for (size_t i = 0; i < p.size(); ++i) { c += p[i]; spd += norm(v[i]); }
+            c = c * (1.0f / p.size());
+            for (const Vec2& q : p) spread += norm(q - c);
+            return Vec2{ (float)(spd / p.size()), (float)(spread / p.size()) };
+        };
+
+        const int NF = std::min(N, 1000000), STEPS = 5;
+        const float FS = std::sqrt(NF * 180.f);             // 1 体あたり 180 平方（近傍 7 体ほど）
+        World w(FS, FS, 20.f, VR, 1);
+        setup(w, NF, false);
+        CompactFlock<2> cf(Vec2{FS, FS}, FC, 3.f, w.species().params(0));
+        pack(w, cf);
+        w.step(dt);
+        flock(w, cf, 0);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) w.step(dt);
+        const double wt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+        t0 = std::chrono::steady_clock::now();
+        for (int s = 0; s < STEPS; ++s) flock(w, cf, 1 + s);
+        const double ct = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / STEPS;
+        std::printf("flock (separation, alignment, cohesion, wall, random walk): N=%d, world %.0fx%.0f, view radius %.0f, 1 thread\n",
+                    NF, FS, FS, VR);
+        std::printf("%-8s %12s %10s %10s\n", "state", "bytes/agent", "ms/step", "Magt/s");
+        std::printf("%-8s %12zu %10.1f %10.2f\n", "World", sizeof(World::AgentD), 1e3 * wt, NF / wt * 1e-6);
+        std::printf("%-8s %12zu %10.1f %10.2f   (cell %.0f, rebins %d)\n", "compact", CompactFlock<2>::bytesPerAgent(),
+                    1e3 * ct, NF / ct * 1e-6, FC, cf.rebins());
+
+        const int M = std::min(N, 20000);
+        const float MS = std::sqrt(M * 180.f);
+        World ref(MS, MS, 20.f, VR, 1), ulp(MS, MS, 20.f, VR, 1);
+        setup(ref, M, false);
+        setup(ulp, M, true);
+        CompactFlock<2> cm(Vec2{MS, MS}, FC, 3.f, ref.species().params(0));
+        pack(ref, cm);
+        std::printf("trajectory vs World, N=%d: %8s %12s %12s %14s\n", M, "step", "rms |dp|", "max |dp|", "World+1ulp rms");
+        std::vector<Vec2> cp, cv, rp, rv, up, uv;
+        for (int s = 1; s <= 1000; ++s) {
+            flock(ref, cm, (uint32_t)(s - 1));
+            ref.step(dt);
+            ulp.step(dt);
+            if (s == 1 || s == 10 || s == 100 || s == 1000) {
+                cm.unpack(cp, cv);
+                rp.clear(); rv.clear(); up.clear(); uv.clear();
+                for (const auto& a : ref.agents()) { rp.push_back(a.pos()); rv.push_back(a.vel()); }
+                for (const auto& a : ulp.agents()) { up.push_back(a.pos()); uv.push_back(a.vel()); }
+                double se = 0, me = 0, su = 0;
+                for (int i = 0; i < M; ++i) {
+                    const double e = norm(cp[i] - rp[i]), u = norm(up[i] - rp[i]);
+                    se += e * e; me = std::max(me, e); su += u * u;
+                }
+                std::printf("%37d %12.5f %12.5f %14.5f\n", s, std::sqrt(se / M), me, std::sqrt(su / M));
+            }
+        }
+        const Vec2 a = stats(rp, rv), b = stats(cp, cv), c = stats(up, uv);
+        std::printf("after 1000 steps: mean speed World %.2f / compact %.2f / World+1ulp %.2f, "
+                    "spread %.1f / %.1f / %.1f\n", a[0], b[0], c[0], a[1], b[1], c[1]);
+    }
+    return 0;
+}
+
+// 固まった群れ（個体の 7 割が 3 つの小さな塊，残りは一様）の知覚を 4 スレッドで：
+//   static    セル数で等分・盗みなし（従来の静的分割）
+//   estimate  セルの個体数^2 の見積もりで等分・盗みなし
+//   steal     セル数で細かく切って盗む
+//   est+steal 見積もりで切って盗む
+// 不均衡比はスレッドごとの仕事量（格子で見た候補の数）の max / mean．
+// 近傍リストが直列（1 スレッド）と同じかも確かめる
+static int benchSteal(int N)
+{
+    const float S = 2000.f, VR = 40.f, dt = 0.01f;
+    const int   T = 4, TICKS = 12;
+    struct Mode { const char* name; bool weighted, stealing; int perThread; };
+    const Mode modes[] = { {"static", false, false, 1}, {"estimate", true, false, 8},
+                           {"steal", false, true, 8},   {"est+steal", true, true, 8} };
+    auto scene = [&](World& world) {
+        std::srand(23);
+        world.reserve(N);
+        world.species().params(0).k_ran = 0.f;
+        const Vec2 clumps[] = { {400.f, 300.f}, {1500.f, 250.f}, {900.f, 1700.f} };
+        for (int i = 0; i < N; ++i) {
+            Vec2 p;
+            if (i % 10 < 7) p = clumps[i % 3] + Agent::randomDir() * (200.f * std::sqrt((float)std::rand() / RAND_MAX));
+            else            p = Vec2{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) };
+            world.spawn(p, Agent::randomDir() * 20.f, 3.f, VR);
+        }
+    };
+    // 直列の近傍リスト（ティックごとの和で比べる）
+    auto digest = [](const World& w) {
+        uint64_t h = 1469598103934665603ull;
+        for (int i = 0; i < (int)w.agents().size(); ++i)
+            for (int j : w.neighbors(i)) h = (h ^ (uint64_t)(i * 1000003 + j)) * 1099511628211ull;
+        return h;
+    };
+    std::vector<uint64_t> ref;
+    {
+        World w(S, S, 20.f, VR, 1);
+        scene(w);
+        for (int t = 0; t < TICKS; ++t) { w.step(dt); ref.push_back(digest(w)); }
+    }
+
+    std::printf("work-stealing benchmark: N=%d (70%% in 3 clumps of r=200), world=%.0fx%.0f, viewRad=%.0f, %d threads on %u cores\n",
+                N, S, S, VR, T, std::thread::hardware_concurrency());
+    std::printf("per tick: imbalance = max/mean of per-thread work (candidates visited), stolen = tasks run by a non-owner\n");
+    std::printf("%5s", "tick");
+    for (const Mode& m : modes) std::printf(" %17s", m.name);
+    std::printf("\n");
+    double imb[4][TICKS], ms[4] = {};
+    int    stolen[4][TICKS], tasks[4] = {};
+    bool   same = true;
+    for (int m = 0; m < 4; ++m) {
+        World w(S, S, 20.f, VR, T);
+        w.scheduler().weighted       = modes[m].weighted;
+        w.scheduler().stealing       = modes[m].stealing;
+        w.scheduler().tasksPerThread = modes[m].perThread;
+        scene(w);
+        for (int t = 0; t < TICKS; ++t) {
+            w.step(dt);
+            imb[m][t]    = w.scheduler().last().imbalance;
+            stolen[m][t] = w.scheduler().last().stolen;
+            same &= digest(w) == ref[t];
+        }
+        ms[m]    = 1e3 * w.perceiveSeconds() / TICKS;
+        tasks[m] = w.scheduler().last().tasks;
+    }
+    for (int t = 0; t < TICKS; ++t) {
+        std::printf("%5d", t);
+        for (int m = 0; m < 4; ++m) std::printf("       %5.2f %5d", imb[m][t], stolen[m][t]);
+        std::printf("\n");
+    }
+    std::printf("%5s", "tasks");
+    for (int m = 0; m < 4; ++m) std::printf(" %17d", tasks[m]);
+    std::printf("\n%5s", "ms");
+    for (int m = 0; m < 4; ++m) std::printf(" %17.2f", ms[m]);
+    std::printf("  (perceive per tick)\nneighbor lists vs 1 thread: %s\n", same ? "identical" : "DIFFERENT");
+    return same ? 0 : 1;
+}
+
+// 置き場所の検査：N 体を reserve して（huge page・first-touch）一様にばらまき，
+// 起動ログを出して数ティック回す．first-touch の後も個体がそのままか，
+// 配列のアドレスが huge page 境界に揃っているかを見る（1 ノードなら従来どおりの確保）
+static int checkPlacement(int N)
+{
+    const float S = 20000.f, VR = 20.f, dt = 0.01f;
+    const int   T = std::max(1u, std::thread::hardware_concurrency());
+    std::srand(31);
+    World world(S, S, 20.f, VR, T);
+    world.species().params(0).k_ran = 0.f;
+    world.reserve(N);
+    std::vector<Vec2> p0;
+    p0.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        p0.push_back(Vec2{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) });
+        world.spawn(p0.back(), Agent::randomDir() * 40.f, 3.f, VR);
+    }
+    world.logPlacement(stdout);
+    bool ok = true;
+    for (int i = 0; i < N; ++i) {
+        const Vec2 q = world.agents()[i].pos();
+        ok &= q.x == p0[i].x && q.y == p0[i].y;
+    }
+    const uintptr_t at = (uintptr_t)world.agents().data();
+    std::printf("  agent array at %#llx (%s 2 MiB boundary), %zu bytes/agent\n", (unsigned long long)at,
+                at % HugePages::kHuge == 0 ? "on a" : "not on a", sizeof(World::AgentD));
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < 5; ++s) world.step(dt);
+#ifdef __linux__
+    {   // 実際に huge page に載った量（THP は madvise しても載るとは限らない）
+        std::FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+        char line[256];
+        while (f && std::fgets(line, sizeof(line), f))
+            if (!std::strncmp(line, "AnonHugePages:", 14)) std::printf("  process %s", line);
+        if (f) std::fclose(f);
+    }
+#endif
+    std::printf("  %d agents, %d threads: %.1f ms/tick, agents intact after reserve: %s\n", N, T,
+                1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / 5, ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
+
+// 領域分割の 1 rank：全員が同じ乱数列で N 体を作り，自分の短冊の分だけ持つ．
+// ticks 進めたら ID 順の最終状態を out に（先頭にティック時間と通信量）
+struct DomainRun {
+    int      agents = 20000, ticks = 200;
+    unsigned seed   = 41;
+    float    spawnW = 0;             // 初期配置の x の幅（0 ならワールド全体）
+    bool     rebalance = false, useWork = false;
+    double   budgetMs  = 0.5;
+};
+struct DomainResult {
+    double   ms = 0, commMs = 0, computeMs = 0, migrateMsMax = 0;
+    double   computeMsTail = 0;          // 最後の 1/4 のティックの計算時間（落ち着いた後の分担）
+    uint64_t halo = 0, migrated = 0;
+    int      owned = 0, migratedMax = 0, shifts = 0;
+    float    x0 = 0, x1 = 0;
+};
+static constexpr float kDomainS = 1500.f, kDomainVR = 40.f, kDomainDt = 0.01f;
+template<class Put>
+static void domainSpawn(const DomainRun& cfg, Put&& put)
+{
+    const int W = (int)(cfg.spawnW > 0 ? cfg.spawnW : kDomainS);
+    std::srand(cfg.seed);
+    for (int i = 0; i < cfg.agents; ++i) {
+        Vec2 p{ (float)(std::rand() % W), (float)(std::rand() % (int)kDomainS) };
+        put((uint64_t)i, Agent(p, Agent::randomDir() * 40.f, 3.f, kDomainVR));
+    }
+}
+template<class Transport>
+static bool runDomainRank(Transport& tr, const Strip& strip, const DomainRun& cfg, const char* out)
+{
+    if (!tr.good()) return false;
+    DomainWorld<Transport> world(kDomainS, kDomainS, 20.f, kDomainVR, strip, tr);
+    world.rebalance().enabled  = cfg.rebalance;
+    world.rebalance().useWork  = cfg.useWork;
+    world.rebalance().budgetMs = cfg.budgetMs;
+    domainSpawn(cfg, [&](uint64_t id, const Agent& a){ world.add(id, a); });
+    const auto t0 = std::chrono::steady_clock::now();
+    double tail = 0;
+    for (int s = 0; s < cfg.ticks && world.good(); ++s) {
+        if (s == cfg.ticks * 3 / 4) tail = world.stats().computeSec;
+        world.step(kDomainDt);
+    }
+    const auto& st = world.stats();
+    DomainResult r;
+    r.ms       = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / cfg.ticks;
+    r.commMs   = 1e3 * st.commSec / cfg.ticks;
+    r.computeMs = 1e3 * st.computeSec / cfg.ticks;
+    r.computeMsTail = 1e3 * (st.computeSec - tail) / (cfg.ticks - cfg.ticks * 3 / 4);
+    r.migrateMsMax = 1e3 * st.migrateSecMax;
+    r.halo     = st.halo;
+    r.migrated = st.migrated;
+    r.migratedMax = st.migratedMax;
+    r.shifts   = world.rebalance().stats().shifts;
+    r.owned    = world.population();
+    r.x0       = world.strip().x0;
+    r.x1       = world.strip().x1;
+    std::vector<typename DomainWorld<Transport>::Rec> recs;
+    world.records(recs);
+    std::FILE* f = out ? std::fopen(out, "wb") : nullptr;
+    if (f) {
+        std::fwrite(&r, sizeof(r), 1, f);
+        if (!recs.empty()) std::fwrite(recs.data(), sizeof(recs[0]), recs.size(), f);
+        std::fclose(f);
+    }
+    if (!out)
+        std::fprintf(stderr, "rank %d/%d [%s] x in [%.0f, %.0f): %d agents, %.3f ms/tick (compute %.3f, comm %.3f), halo %llu, migrated %llu%s\n",
+                     strip.rank, strip.size, Transport::name, r.x0, r.x1, r.owned, r.ms, r.computeMs, r.commMs,
+                     (unsigned long long)r.halo, (unsigned long long)r.migrated, world.good() ? "" : " (transport failed)");
+    return world.good();
+}
+
+// --domain RANK SIZE [--transport shm|tcp] [--port P] [--hosts h0,h1,...] [--agents N] [--steps K] [--rebalance]
+//   同じ引数で rank 0..SIZE-1 を別々に起動する（ノードをまたぐなら tcp と --hosts）
+static int runDomain(int argc, char** argv)
+{
+    if (argc < 4) { std::fprintf(stderr, "usage: --domain RANK SIZE [--transport shm|tcp] [--port P] [--hosts a,b,...]\n"); return 1; }
+    const int rank = std::atoi(argv[2]), size = std::atoi(argv[3]);
+    std::string transport = "shm", name = "/boids-domain";
+    std::vector<std::string> hosts;
+    int port = 31000;
+    DomainRun cfg;
+    const char* out = nullptr;
+    for (int i = 4; i < argc; ++i) {
+        if      (!std::strcmp(argv[i], "--transport") && i+1 < argc) transport  = argv[++i];
+        else if (!std::strcmp(argv[i], "--port")      && i+1 < argc) port       = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--agents")    && i+1 < argc) cfg.agents = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--steps")     && i+1 < argc) cfg.ticks  = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--shm")       && i+1 < argc) name       = argv[++i];
+        else if (!std::strcmp(argv[i], "--out")       && i+1 < argc) out        = argv[++i];
+        else if (!std::strcmp(argv[i], "--rebalance"))               cfg.rebalance = true;
+        else if (!std::strcmp(argv[i], "--budget-ms") && i+1 < argc) cfg.budgetMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--hosts")     && i+1 < argc) {
+            std::string h = argv[++i];
+            for (size_t b = 0, e; b <= h.size(); b = e + 1) {
+                e = h.find(',', b);
+                if (e == std::string::npos) e = h.size();
+                hosts.push_back(h.substr(b, e - b));
+            }
+        }
+        else { std::fprintf(stderr, "unknown option: %s\n", argv[i]); return 1; }
+    }
+    if (rank < 0 || rank >= size) { std::fprintf(stderr, "rank must be in [0, SIZE)\n"); return 1; }
+    const Strip strip(rank, size, kDomainS);
+#ifdef __linux__
+    if (transport == "tcp") {
+        TcpTransport tr(rank, size, port, hosts);
+        return runDomainRank(tr, strip, cfg, out) ? 0 : 1;
+    }
+    ShmTransport tr(name.c_str(), rank, size);
+    return runDomainRank(tr, strip, cfg, out) ? 0 : 1;
+#else
+    std::fprintf(stderr, "--domain needs POSIX shared memory / sockets\n");
+    return 1;
+#endif
+}
+
+#ifdef __linux__
+// P 個の rank を fork して回し，ID 順に集めた最終状態と rank ごとの結果を返す（失敗なら false）
+using DomainRec = AgentRec;
+static bool forkDomain(const DomainRun& cfg, int P, bool tcp, std::vector<DomainRec>& all, std::vector<DomainResult>& ranks)
+{
+    static int serial = 0;
+    const int pid = (int)getpid(), run = serial++;
+    const std::string shm = "/boids-domain-" + std::to_string(pid) + "-" + std::to_string(run);
+    const int port = 31000 + (pid % 1000) * 16 + (run % 4) * 4;     // 同時に走る検査どうしでぶつからないように
+    std::vector<std::string> files;
+    std::vector<pid_t> kids;
+    std::fflush(stdout);
+    for (int r = 0; r < P; ++r) {
+        files.push_back("/tmp/boids-domain-" + std::to_string(pid) + "-" + std::to_string(r) + ".bin");
+        const pid_t k = fork();
+        if (k == 0) {
+            const Strip strip(r, P, kDomainS);
+            bool good;
+            if (tcp) { TcpTransport tr(r, P, port); good = runDomainRank(tr, strip, cfg, files[r].c_str()); }
+            else     { ShmTransport tr(shm.c_str(), r, P); good = runDomainRank(tr, strip, cfg, files[r].c_str()); }
+            _exit(good ? 0 : 1);
+        }
+        kids.push_back(k);
+    }
+    bool good = true;
+    for (pid_t k : kids) { int st = 0; waitpid(k, &st, 0); good &= WIFEXITED(st) && WEXITSTATUS(st) == 0; }
+    all.clear();
+    ranks.assign(P, DomainResult{});
+    for (int r = 0; r < P; ++r) {
+        std::FILE* f = std::fopen(files[r].c_str(), "rb");
+        if (!f || std::fread(&ranks[r], sizeof(DomainResult), 1, f) != 1) { good = false; if (f) std::fclose(f); continue; }
+        std::vector<DomainRec> part(ranks[r].owned);
+        good &= std::fread(part.data(), sizeof(DomainRec), part.size(), f) == part.size();
+        std::fclose(f);
+        std::remove(files[r].c_str());
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end(), [](const DomainRec& a, const DomainRec& b){ return a.id < b.id; });
+    return good;
+}
+// 1 プロセスの World と ID ごとに位置・速度・加速度がビット単位で一致するか
+static bool sameAsWorld(const std::vector<DomainRec>& all, const World& ref)
+{
+    if ((int)all.size() != ref.population()) return false;
+    for (int i = 0; i < (int)all.size(); ++i) {
+        const Agent& a = ref.agents()[i];
+        const Vec2 q[3] = { a.pos(), a.vel(), a.acc() };
+        const Vec2 d[3] = { all[i].p, all[i].v, all[i].a };
+        if (all[i].id != (uint64_t)i || std::memcmp(q, d, sizeof(q)) != 0) return false;
+    }
+    return true;
+}
+#endif
+
+// 基準：同じ初期状態の 1 プロセスの World（決定的モード・SoA なし・接触なし）を回す
+static double domainReference(const DomainRun& cfg, World& ref)
+{
+    ref.soa().enabled = false;                     // 後処理の順が違うと丸めが変わるので AoS の経路で
+    ref.deterministic().enabled = true;
+    ref.reserve(cfg.agents);
+    domainSpawn(cfg, [&](uint64_t, const Agent& a){ ref.spawn(a); });
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < cfg.ticks; ++s) ref.step(kDomainDt);
+    return 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / cfg.ticks;
+}
+
+// 領域分割の検査：P = 2, 3, 4 プロセスを fork して共有メモリ・TCP（ループバック）の両方で回し，
+// ID で集めた最終状態が 1 プロセスの World とビット単位で一致するか
+static int checkDomain(int N)
+{
+    DomainRun cfg;
+    cfg.agents = N;
+    std::printf("domain decomposition check: N=%d, %d ticks, world %.0f x %.0f, view radius %.0f\n",
+                N, cfg.ticks, kDomainS, kDomainS, kDomainVR);
+    World ref(kDomainS, kDomainS, 20.f, kDomainVR, 1);
+    const double refMs = domainReference(cfg, ref);
+    std::printf("%-10s %5s %10s %10s %10s %10s %10s\n", "transport", "ranks", "ms/tick", "comm ms", "halo/tick", "migr/tick", "vs 1 proc");
+    std::printf("%-10s %5d %10.3f %10s %10s %10s %10s\n", "-", 1, refMs, "-", "-", "-", "-");
+#ifdef __linux__
+    bool ok = true;
+    for (int tcp = 0; tcp < 2; ++tcp) {
+        for (int P = 2; P <= 4; ++P) {
+            std::vector<DomainRec> all;
+            std::vector<DomainResult> ranks;
+            const bool good = forkDomain(cfg, P, tcp, all, ranks);
+            const bool same = good && sameAsWorld(all, ref);
+            DomainResult sum;
+            for (const DomainResult& r : ranks) {
+                sum.ms = std::max(sum.ms, r.ms);
+                sum.commMs = std::max(sum.commMs, r.commMs);
+                sum.halo += r.halo;
+                sum.migrated += r.migrated;
+            }
+            ok &= same;
+            std::printf("%-10s %5d %10.3f %10.3f %10.1f %10.1f %10s\n", tcp ? "tcp" : "shm", P, sum.ms, sum.commMs,
+                        (double)sum.halo / cfg.ticks, (double)sum.migrated / cfg.ticks,
+                        !good ? "FAILED" : same ? "identical" : "differs");
+        }
+    }
+    std::printf("domain decomposition: %s\n", ok ? "OK (bit-identical to the single-process run)" : "FAILED");
+    return ok ? 0 : 1;
+#else
+    std::printf("domain decomposition needs POSIX shared memory / sockets\n");
+    return 0;
+#endif
+}
+
+// 境界を動かす負荷分散：群れを左端の 1/4 に置き（等分した短冊では rank 0 がほぼ全部を持つ），
+// 4 rank で固定の短冊と，計測時間・仕事量で境界を動かした場合を比べる．
+// rank ごとの計算時間の max / mean（不均衡比），最終的な持ち分と境界，
+// 1 ティックの移住数・移住の処理時間の最大（予算と比べる），1 プロセスとの一致を出す
+static int benchRebalance(int N)
+{
+    DomainRun cfg;
+    cfg.agents = N;
+    cfg.ticks  = 400;
+    cfg.spawnW = kDomainS / 4;
+    const int P = 4;
+    std::printf("rebalance bench: N=%d in x < %.0f, %d ticks, %d ranks (shm), budget %.2f ms/tick\n",
+                N, cfg.spawnW, cfg.ticks, P, cfg.budgetMs);
+    World ref(kDomainS, kDomainS, 20.f, kDomainVR, 1);
+    domainReference(cfg, ref);
+#ifdef __linux__
+    bool ok = true;
+    std::printf("%-10s %10s %10s %10s %14s %10s %8s %10s  %s\n", "partition", "ms/tick", "imbalance", "last 1/4",
+                "max migr/tick", "migr ms", "shifts", "vs 1 proc", "final strips (agents)");
+    for (int mode = 0; mode < 3; ++mode) {
+        cfg.rebalance = mode > 0;
+        cfg.useWork   = mode == 2;
+        std::vector<DomainRec> all;
+        std::vector<DomainResult> ranks;
+        const bool good = forkDomain(cfg, P, false, all, ranks);
+        const bool same = good && sameAsWorld(all, ref);
+        ok &= same;
+        double ms = 0, cmax = 0, csum = 0, tmax = 0, tsum = 0, migMs = 0;
+        int migMax = 0, shifts = 0;
+        for (const DomainResult& r : ranks) {
+            ms = std::max(ms, r.ms);
+            cmax = std::max(cmax, r.computeMs);
+            csum += r.computeMs;
+            tmax = std::max(tmax, r.computeMsTail);
+            tsum += r.computeMsTail;
+            migMax = std::max(migMax, r.migratedMax);
+            migMs = std::max(migMs, r.migrateMsMax);
+            shifts = std::max(shifts, r.shifts);
+        }
+        std::printf("%-10s %10.3f %10.2f %10.2f %14d %10.3f %8d %10s  ", mode == 0 ? "fixed" : mode == 1 ? "time" : "work",
+                    ms, csum > 0 ? cmax * P / csum : 1.0, tsum > 0 ? tmax * P / tsum : 1.0, migMax, migMs, shifts,
+                    !good ? "FAILED" : same ? "identical" : "differs");
+        for (const DomainResult& r : ranks) std::printf("[%.0f,%.0f)(%d) ", r.x0, r.x1, r.owned);
+        std::printf("\n");
+    }
+    return ok ? 0 : 1;
+#else
+    std::printf("rebalance bench needs POSIX shared memory\n");
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+// 外部記憶モードの形：高さは 1500 に固定し，密度が --check-domain と同じになるよう x 方向に伸ばす．
+// チャンクは 1 本あたり perChunk 体くらい（幅は視野半径の 2 倍以上）
+struct StreamLayout {
+    float W, H;
+    int   chunks;
+    StreamLayout(uint64_t N, uint64_t perChunk) : H(1500.f) {
+        const double density = 20000.0 / (1500.0 * 1500.0);
+        W = (float)std::max<double>(H, (double)N / density / H);
+        const int byWidth = std::max(1, (int)(W / (2 * kDomainVR)));
+        chunks = (int)std::clamp<uint64_t>((N + perChunk - 1) / perChunk, 1, (uint64_t)byWidth);
+    }
+};
+
+// 作業ディレクトリ（なければ作る）
+static bool streamDir(const std::string& dir) {
+    return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+static void streamClean(const StreamWorld<>& w, const std::string& dir) {
+    for (int g = 0; g < 2; ++g)
+        for (int k = 0; k < w.chunks(); ++k) std::remove(w.path(g, k).c_str());
+    rmdir(dir.c_str());
+}
+
+// 生のディスク帯域：bytes を順に書いて（fdatasync）ページキャッシュから落とし，読み直す
+static void diskBandwidth(const std::string& dir, uint64_t bytes, double& readMBs, double& writeMBs)
+{
+    const std::string f = dir + "/bandwidth.bin";
+    std::vector<unsigned char> block(ChunkWriter::kBlock, 0x5a);
+    ChunkWriter w;
+    auto t0 = std::chrono::steady_clock::now();
+    w.open(f);
+    for (uint64_t n = 0; n < bytes; n += block.size()) w.write(block.data(), block.size());
+    w.close(true);
+    const double ws = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    t0 = std::chrono::steady_clock::now();
+    const int fd = ::open(f.c_str(), O_RDONLY);
+    uint64_t got = 0;
+    for (ssize_t k; fd >= 0 && (k = ::read(fd, block.data(), block.size())) > 0; ) got += (uint64_t)k;
+    if (fd >= 0) { posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); ::close(fd); }
+    const double rs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::remove(f.c_str());
+    writeMBs = w.written() / 1048576.0 / ws;
+    readMBs  = got / 1048576.0 / rs;
+}
+
+// --stream DIR [--agents N] [--chunks-of K] [--steps S] [--drop-cache] [--keep]
+//   DIR にチャンクを作って S ティック流す（--keep なら最後の世代を残す）
+static int runStream(int argc, char** argv)
+{
+    if (argc < 3) { std::fprintf(stderr, "usage: --stream DIR [--agents N] [--chunks-of K] [--steps S] [--drop-cache] [--keep]\n"); return 1; }
+    const std::string dir = argv[2];
+    uint64_t N = 10000000, perChunk = 250000;
+    int steps = 10;
+    bool drop = false, keep = false;
+    for (int i = 3; i < argc; ++i) {
+        if      (!std::strcmp(argv[i], "--agents")    && i+1 < argc) N = std::strtoull(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--chunks-of") && i+1 < argc) perChunk = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--steps")     && i+1 < argc) steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--drop-cache"))              drop = true;
+        else if (!std::strcmp(argv[i], "--keep"))                    keep = true;
+        else { std::fprintf(stderr, "unknown option: %s\n", argv[i]); return 1; }
+    }
+    if (!streamDir(dir)) { std::perror(dir.c_str()); return 1; }
+    const StreamLayout L(N, perChunk);
+    StreamWorld<> world(dir, L.W, L.H, L.chunks, kDomainVR);
+    world.dropCache = drop;
+    std::printf("stream: %llu agents, world %.0f x %.0f, %d chunks, %s\n", (unsigned long long)N, L.W, L.H, L.chunks,
+                drop ? "page cache dropped after each chunk" : "page cache kept");
+    bool ok = world.generate(N);
+    for (int s = 0; s < steps && ok; ++s) {
+        const auto before = world.stats();
+        ok = world.step(kDomainDt);
+        const auto& st = world.stats();
+        const double sec = st.wallSec - before.wallSec;
+        std::printf("tick %3d: %8.1f ms, %6.2f M agent-ticks/s, read %7.1f MB/s, write %7.1f MB/s, compute %4.1f%%\n",
+                    s, 1e3 * sec, (st.agentTicks - before.agentTicks) / sec * 1e-6,
+                    (st.bytesRead - before.bytesRead) / 1048576.0 / sec,
+                    (st.bytesWritten - before.bytesWritten) / 1048576.0 / sec,
+                    100.0 * (st.computeSec - before.computeSec) / sec);
+    }
+    if (!keep) streamClean(world, dir);
+    return ok ? 0 : 1;
+}
+
+// 外部記憶モードの検査
+//   1. 20,000 体・8 チャンクで 50 ティック流し，1 プロセスの World とビット単位で一致するか
+//   2. N 体をページキャッシュを落としながら流し（毎ティック実際にディスクから読む），
+//      ティック時間・スループットと，同じバイト数の生の順次読み書きの帯域を比べる
+static int checkStream(uint64_t N)
+{
+    const std::string dir = "/tmp/boids-stream-" + std::to_string((int)getpid());
+    if (!streamDir(dir)) { std::perror(dir.c_str()); return 1; }
+    bool same = true;
+    {
+        const uint64_t n = 20000;
+        const int TICKS = 50;
+        StreamWorld<> sw(dir, kDomainS, kDomainS, 8, kDomainVR);
+        World ref(kDomainS, kDomainS, 20.f, kDomainVR, 1);
+        ref.soa().enabled = false;
+        ref.deterministic().enabled = true;
+        ref.reserve((int)n);
+        for (int k = 0; k < sw.chunks(); ++k)
+            for (uint64_t id = n * k / sw.chunks(); id < n * (k + 1) / sw.chunks(); ++id)
+                ref.spawn(StreamWorld<>::initial(ref.deterministic(), id, sw.chunk(k), kDomainS, kDomainVR));
+        same = sw.generate(n);
+        for (int s = 0; s < TICKS && same; ++s) { same = sw.step(kDomainDt); ref.step(kDomainDt); }
+        uint64_t seen = 0;
+        same = same && sw.forEach([&](const AgentRec& r){
+            const Agent& a = ref.agents()[(int)r.id];
+            const Vec2 q[3] = { a.pos(), a.vel(), a.acc() };
+            const Vec2 d[3] = { r.p, r.v, r.a };
+            same &= r.id == seen++ && std::memcmp(q, d, sizeof(q)) == 0;
+        });
+        same &= seen == n;
+        std::printf("stream check: %llu agents, %d chunks, %d ticks vs single-process World: %s\n",
+                    (unsigned long long)n, sw.chunks(), TICKS, same ? "identical" : "DIFFERS");
+        streamClean(sw, dir);
+        streamDir(dir);
+    }
+    const StreamLayout L(N, 250000);
+    const int TICKS = 3;
+    StreamWorld<> world(dir, L.W, L.H, L.chunks, kDomainVR);
+    world.dropCache = true;
+    bool ok = world.generate(N);
+    for (int s = 0; s < TICKS && ok; ++s) ok = world.step(kDomainDt);
+    const auto& st = world.stats();
+    const uint64_t tickBytes = N * sizeof(AgentRec);
+    double rMBs = 0, wMBs = 0;
+    diskBandwidth(dir, tickBytes, rMBs, wMBs);
+    streamClean(world, dir);
+    const double sec   = st.wallSec / TICKS;
+    const double floor = tickBytes / 1048576.0 / rMBs + tickBytes / 1048576.0 / wMBs;   // 読んで書くだけの時間
+    const double rate  = st.agentTicks / st.wallSec;
+    std::printf("stream bench: %llu agents (%.1f MiB/generation), world %.0f x %.0f, %d chunks, page cache dropped\n",
+                (unsigned long long)N, tickBytes / 1048576.0, L.W, L.H, L.chunks);
+    std::printf("  window peak %zu agents (%.1f MiB resident state), %zu bytes/agent on disk\n",
+                st.windowPeak, st.windowPeak * (sizeof(Agent) + sizeof(AgentRec)) / 1048576.0, sizeof(AgentRec));
+    std::printf("  %.1f ms/tick, %.2f M agent-ticks/s, compute %.1f%% of the tick\n",
+                1e3 * sec, rate * 1e-6, 100.0 * st.computeSec / st.wallSec);
+    std::printf("  streamed I/O %.1f MB/s read + %.1f MB/s write (prefetch thread read %.1f MiB in %.1f ms)\n",
+                st.bytesRead / 1048576.0 / st.wallSec, st.bytesWritten / 1048576.0 / st.wallSec,
+                world.prefetcher().bytes() / 1048576.0, 1e3 * world.prefetcher().seconds());
+    std::printf("  raw disk: %.1f MB/s sequential read, %.1f MB/s sequential write (fdatasync)\n", rMBs, wMBs);
+    std::printf("  I/O floor %.1f ms/tick -> tick is %.2fx the floor; %.0f agent-ticks/s per MB/s of disk bandwidth\n",
+                1e3 * floor, sec / floor, rate / (2.0 / (1.0 / rMBs + 1.0 / wMBs)));
+    std::printf("stream: %s\n", same && ok ? "OK" : "FAILED");
+    return same && ok ? 0 : 1;
+}
+#endif
+
+#ifdef __linux__
+// fork チェックポイントの検査：同じ群れを 100 ティック回し，25 ティックごとに
+//   取らない / ループ内で同期に書く / fork（同時 1 本）/ fork（同時 2 本）
+// で比べる．ティック時間の平均・最大（止まった時間），fork の停止時間，書き終えるまでの遅延，
+// 子が生きている間の親のページフォールト（COW）を出し，最後のファイルを読み戻して
+// 取った瞬間の個体配列とバイト単位で一致するかを見る
+static int checkCheckpoint(int N)
+{
+    const float S = std::sqrt(N * 180.f), VR = 20.f, dt = 0.01f;   // 1 体あたり 180 平方（近傍 7 体ほど）
+    const int   TICKS = 100, PERIOD = 25;
+    const int   T = std::max(1u, std::thread::hardware_concurrency());
+    const std::string dir = "/tmp/boids-ckpt-" + std::to_string((int)getpid());
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) { std::perror(dir.c_str()); return 1; }
+    std::printf("checkpoint check: N=%d, %d threads, %d ticks, every %d ticks, %.1f MiB agent array\n",
+                N, T, TICKS, PERIOD, N * sizeof(World::AgentD) / 1048576.0);
+    std::printf("%-12s %9s %9s %9s %10s %12s %14s %8s %10s\n", "mode", "ms/tick", "max tick", "pause", "latency",
+                "faults/snap", "pages in array", "skipped", "read back");
+    bool ok = true;
+    for (int mode = 0; mode < 4; ++mode) {
+        std::srand(33);
+        World world(S, S, 20.f, VR, T);
+        world.species().params(0).k_ran = 0.f;
+        world.reserve(N);
+        for (int i = 0; i < N; ++i)
+            world.spawn(Vec2{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) }, Agent::randomDir() * 40.f, 3.f, VR);
+        ForkCheckpoint& c = world.checkpoint();
+        c.enabled     = mode > 0;
+        c.useFork     = mode >= 2;
+        c.maxInFlight = mode == 3 ? 2 : 1;
+        c.period      = PERIOD;
+        c.dir         = dir;
+        std::vector<World::AgentD> copy;               // 検査用：最後に取った瞬間の配列
+        uint64_t copyTick = 0;
+        double sum = 0, worst = 0;
+        for (int s = 0; s < TICKS; ++s) {
+            const int taken = c.stats().taken;
+            const auto t0 = std::chrono::steady_clock::now();
+            world.step(dt);
+            const double ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            sum += ms;
+            worst = std::max(worst, ms);
+            if (c.stats().taken != taken) {
+                copy.assign(world.agents().begin(), world.agents().end());
+                copyTick = (uint64_t)(s + 1);
+            }
+        }
+        c.poll(true);
+        const auto& st = c.stats();
+        bool same = true;
+        if (mode > 0) {
+            char path[512];
+            c.path(copyTick, path, sizeof(path));
+            World back(S, S, 20.f, VR, 1);
+            same = back.restore(path) && back.population() == (int)copy.size()
+                && std::memcmp(back.agents().data(), copy.data(), copy.size() * sizeof(World::AgentD)) == 0;
+            for (uint64_t t = PERIOD; t <= (uint64_t)TICKS; t += PERIOD) { c.path(t, path, sizeof(path)); std::remove(path); }
+            ok &= same && st.failed == 0;
+        }
+        const char* name[] = { "none", "sync", "fork x1", "fork x2" };
+        std::printf("%-12s %9.2f %9.2f %9.2f %10.1f %12.0f %14zu %8d %10s\n", name[mode], sum / TICKS, worst,
+                    st.pauseMsMax, st.latencyMsSum / std::max(1, st.done),
+                    mode >= 2 ? (double)st.parentFaults / std::max(1, st.done) : 0.0,
+                    N * sizeof(World::AgentD) / 4096, st.skipped, mode == 0 ? "-" : same ? "identical" : "DIFFERS");
+    }
+
+    // 再開：決定的モードで Morton の並べ替えと despawn / spawn を挟みながら回し，T0 ティック目の
+    // チェックポイントから復元して続けた K ティックが，止めずに回した場合とビット単位で同じか．
+    // 乱数の流れはハンドルで決まり，復元後の spawn は空きリストを使うので，どちらも保存元どおりでないと崩れる
+    {
+        const int   N2 = std::min(N, 4000), T0 = 60, K = 60;
+        const float S2 = std::sqrt(N2 * 180.f);
+        auto setup = [&](World& w) {
+            w.deterministic().enabled = true;
+            w.morton().enabled = true;
+            w.morton().period  = 16;
+        };
+        auto churn = [&](World& w, int t) {            // 7 ティックごとに 3 体消して 2 体足す（位置はティックから）
+            if (t % 7 != 0) return;
+            for (int k = 0; k < 3; ++k) w.despawn(w.handleAt((t * 131 + k * 977) % w.population()));
+            for (int k = 0; k < 2; ++k)
+                w.spawn(Vec2{ std::fmod(t * 37.f + k * 101.f, S2 - 20.f) + 10.f, std::fmod(t * 53.f + k * 67.f, S2 - 20.f) + 10.f },
+                        Vec2{ 20.f, -10.f }, 3.f, VR);
+        };
+        std::srand(34);
+        World a(S2, S2, 20.f, VR, T);
+        setup(a);
+        a.reserve(N2);
+        for (int i = 0; i < N2; ++i)
+            a.spawn(Vec2{ (float)(std::rand() % (int)S2), (float)(std::rand() % (int)S2) }, Agent::randomDir() * 40.f, 3.f, VR);
+        const std::string path = dir + "/resume.bin";
+        bool saved = false;
+        int  freeAtSave = 0;
+        for (int t = 1; t <= T0 + K; ++t) {
+            churn(a, t);
+            a.step(dt);
+            if (t == T0) {
+                const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                SnapshotWriter w(fd);
+                saved = fd >= 0 && a.writeSnapshot(w) && w.finish();
+                if (fd >= 0) close(fd);
+                freeAtSave = a.freeSlots();
+            }
+        }
+        World b(S2, S2, 20.f, VR, T);
+        setup(b);
+        bool same = saved && b.restore(path.c_str());
+        for (int t = T0 + 1; same && t <= T0 + K; ++t) {
+            churn(b, t);
+            b.step(dt);
+        }
+        same = same && b.population() == a.population()
+            && std::memcmp(b.agents().data(), a.agents().data(), a.population() * sizeof(World::AgentD)) == 0;
+        for (int i = 0; same && i < a.population(); ++i) same = b.handleAt(i) == a.handleAt(i);
+        std::remove(path.c_str());
+        std::printf("resume: N=%d, deterministic, morton 16, churn every 7 ticks (%d free slots at tick %d), "
+                    "%d ticks after restore vs uninterrupted: %s\n", N2, freeAtSave, T0, K, same ? "identical" : "DIFFERS");
+        ok &= same;
+    }
+    rmdir(dir.c_str());
+    std::printf("checkpoint: %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// パラメータの差し替えの検査：群れを回しながら別スレッドが JSON を 25 ms ごとに書き換える
+// （その場で書く / 別名に書いて rename を交互に）．各版は k_sep = k_ali = k_coh = k_wall = k，
+// Vmax = 100 + k なので，ティックごとにこの関係が崩れていないか（半分だけ新しい値を見ていないか）を
+// 確かめ，書き終えてから使われるまでの遅延と，差し替えなしの場合とのティック時間の最大を比べる．
+// 最後に壊れた JSON と，読めるが危ない値（M = 0，負の Vmax，float に収まらない値）を書き，
+// どれも拒まれて前の版のまま動き続けるかを見る
+static int checkReload(int N)
+{
+    const float S = 1500.f, VR = 40.f, dt = 0.01f;
+    const int   WRITES = 40, GAP_MS = 25;
+    const std::string dir  = "/tmp/boids-reload-" + std::to_string((int)getpid());
+    const std::string path = dir + "/params.json";
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) { std::perror(dir.c_str()); return 1; }
+    using Clock = std::chrono::steady_clock;
+    auto write = [&](const std::string& text, bool viaRename) {
+        const std::string to = viaRename ? path + ".tmp" : path;
+        { std::ofstream f(to, std::ios::trunc); f << text; }
+        if (viaRename) std::rename(to.c_str(), path.c_str());
+    };
+    auto version = [](int i) {                         // k = i / 4（float で正確に表せる）
+        char buf[256];
+        const double k = i * 0.25;
+        std::snprintf(buf, sizeof(buf), "{ \"species\": [ { \"k_sep\": %g, \"k_ali\": %g, \"k_coh\": %g, "
+                      "\"k_wall\": %g, \"Vmax\": %g } ] }\n", k, k, k, k, 100 + k);
+        return std::string(buf);
+    };
+    auto make = [&](World& world) {
+        std::srand(49);
+        world.reserve(N);
+        for (int i = 0; i < N; ++i)
+            world.spawn(Vec2{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) }, Agent::randomDir() * 40.f, 3.f, VR);
+    };
+    std::printf("reload check: N=%d, %d rewrites every %d ms (in place / rename alternately)\n", N, WRITES, GAP_MS);
+
+    // 差し替えあり
+    World world(S, S, 20.f, VR, 1);
+    make(world);
+    write(version(4), true);
+    if (!world.params().watch(path, world.species())) return 1;
+    std::vector<std::atomic<int64_t>> writtenAt(WRITES + 8);
+    std::atomic<bool> done{false};
+    std::thread writer([&]{
+        for (int i = 5; i < 5 + WRITES; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(GAP_MS));
+            write(version(i), i % 2 == 0);
+            writtenAt[i - 4] = Clock::now().time_since_epoch().count();
+        }
+        done = true;
+    });
+    int ticks = 0, torn = 0, seen = 0;
+    double worst = 0, latSum = 0, latMax = 0;
+    float last = -1.f;
+    const auto start = Clock::now();
+    while (!done || last != (4 + WRITES) * 0.25f) {
+        const auto t0 = Clock::now();
+        world.step(dt);
+        const auto t1 = Clock::now();
+        worst = std::max(worst, 1e3 * std::chrono::duration<double>(t1 - t0).count());
+        ++ticks;
+        const SpeciesParams& P = world.species().params(0);
+        if (P.k_ali != P.k_sep || P.k_coh != P.k_sep || P.k_wall != P.k_sep || P.Vmax != 100.f + P.k_sep) ++torn;
+        if (P.k_sep != last) {
+            last = P.k_sep;
+            const int i = (int)(P.k_sep * 4.f) - 4;
+            if (i > 0 && i < (int)writtenAt.size() && writtenAt[i] != 0) {
+                const double ms = 1e-6 * (double)(t1.time_since_epoch().count() - writtenAt[i].load());
+                latSum += ms; latMax = std::max(latMax, ms); ++seen;
+            }
+        }
+        if (Clock::now() - start > std::chrono::seconds(10)) break;   // 見張りが止まっていたら
+    }
+    writer.join();
+    const auto& st = world.params().stats();
+    const uint64_t reloads = st.reloads, failures = st.failures, applied = st.applied;
+
+    // 壊れた JSON・危ない値は拒まれ，前の版のまま
+    const uint64_t before = world.params().version();
+    const char* bad[] = {
+        "{ \"species\": [ { \"k_sep\": 1.0, ",
+        "{ \"species\": [ { \"k_sep\": 1.0, \"M\": 0 } ] }",
+        "{ \"species\": [ { \"k_sep\": 1.0, \"Vmax\": -5 } ] }",
+        "{ \"species\": [ { \"k_sep\": 1e39 } ] }",
+    };
+    for (const char* text : bad) {
+        write(text, true);
+        for (auto t0 = Clock::now(); Clock::now() - t0 < std::chrono::milliseconds(150); ) world.step(dt);
+    }
+    const int nbad = (int)(sizeof(bad) / sizeof(bad[0]));
+    const bool rejected = st.failures >= failures + nbad && world.params().version() == before
+                       && world.species().params(0).k_sep == last;
+    world.params().stop();
+
+    // 差し替えなし（同じティック数）
+    World base(S, S, 20.f, VR, 1);
+    make(base);
+    double baseWorst = 0;
+    for (int s = 0; s < ticks; ++s) {
+        const auto t0 = Clock::now();
+        base.step(dt);
+        baseWorst = std::max(baseWorst, 1e3 * std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    std::remove(path.c_str());
+    std::remove((path + ".tmp").c_str());
+    rmdir(dir.c_str());
+
+    std::printf("  %d ticks, %llu reloads, %llu rejected during rewrites, %llu versions applied, parse max %.2f ms\n",
+                ticks, (unsigned long long)reloads, (unsigned long long)failures, (unsigned long long)applied, st.parseMsMax.load());
+    std::printf("  adoption latency (write -> tick that used it): mean %.1f ms, max %.1f ms over %d versions\n",
+                latSum / std::max(1, seen), latMax, seen);
+    std::printf("  max tick: %.2f ms with reloads, %.2f ms without\n", worst, baseWorst);
+    std::printf("  torn parameter sets: %d, final value reached: %s, invalid files rejected: %s\n",
+                torn, last == (4 + WRITES) * 0.25f ? "yes" : "NO", rejected ? "yes" : "NO");
+    const bool ok = torn == 0 && last == (4 + WRITES) * 0.25f && rejected;
+    std::printf("reload: %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+#endif
+
+// 周期タスクのスケジューラの検査：物理 100 Hz・入力 1 kHz・ログ 10 Hz・メトリクス 1 Hz を SEC 秒，
+//   coroutine   TaskLoop（タスクごとに自分の期限まで眠る）
+//   while loop  これまでの形（1 ms ごとに sleep_until で起き，回数で各仕事を振り分ける）
+// で回し，タスクごとの遅れ（期限から走り始めるまで）・取りこぼし・仕事の時間と，
+// CPU 時間が仕事の合計をどれだけ超えたか（スピンしていればここが壁時計に近づく）を比べる
+static int checkTasks(double SEC)
+{
+    using namespace std::chrono;
+    using Clock = steady_clock;
+    const int   N = 2000;
+    const float S = 1500.f, VR = 40.f, dt = 0.01f;
+    const int   SIM_TICKS = (int)std::lround(SEC * 100);
+    std::FILE* sink = std::tmpfile();                  // ログの行き先（書き出しの費用だけ見る）
+    if (!sink) { std::perror("tmpfile"); return 1; }
+    auto make = [&](World& world) {
+        std::srand(50);
+        world.reserve(N);
+        for (int i = 0; i < N; ++i)
+            world.spawn(Vec2{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) }, Agent::randomDir() * 40.f, 3.f, VR);
+    };
+    volatile float stick = 0.f;                        // 入力の代わり（読むだけ）
+    std::printf("task check: %.1f s, sim 100 Hz (N=%d), input 1 kHz, log 10 Hz, metrics 1 Hz\n", SEC, N);
+
+    auto table = [&](const char* mode, const std::deque<TaskStats>& st, double wall, double cpu) {
+        double work = 0;
+        for (const TaskStats& s : st) work += s.busySumUs * 1e-6;
+        std::printf("%s: wall %.2f s, cpu %.2f s, work %.2f s, cpu beyond work %.1f%% of wall\n",
+                    mode, wall, cpu, work, 100.0 * std::max(0.0, cpu - work) / wall);
+        std::printf("  %-8s %8s %7s %12s %12s %12s %12s\n", "task", "runs", "missed", "late mean", "late p99", "late max", "work mean");
+        for (const TaskStats& s : st)
+            std::printf("  %-8s %8llu %7llu %9.1f us %9.0f us %9.1f us %9.1f us\n", s.name,
+                        (unsigned long long)s.runs, (unsigned long long)s.missed,
+                        s.lateMeanUs(), s.latePercentileUs(0.99), s.lateMaxUs, s.busyMeanUs());
+    };
+
+    // coroutine
+    bool ok = true;
+    {
+        World world(S, S, 20.f, VR, 1);
+        make(world);
+        TaskLoop loop;
+        int ticks = 0;
+        auto sim = [&](TaskLoop& L) -> PeriodicTask {
+            for (Ticker t = L.every("sim", milliseconds(10)); co_await t.next(); ) {
+                world.step(dt);
+                if (++ticks == SIM_TICKS) L.stop();
+            }
+        };
+        auto input = [&](TaskLoop& L) -> PeriodicTask {
+            for (Ticker t = L.every("input", milliseconds(1)); co_await t.next(); ) stick = stick + 0.f;
+        };
+        auto log = [&](TaskLoop& L) -> PeriodicTask {
+            for (Ticker t = L.every("log", milliseconds(100)); co_await t.next(); ) {
+                std::fprintf(sink, "tick %d\n", ticks);
+                std::fflush(sink);
+            }
+        };
+        auto metrics = [&](TaskLoop& L) -> PeriodicTask {
+            for (Ticker t = L.every("metrics", seconds(1)); co_await t.next(); ) {
+                const auto m = world.metrics();
+                std::fprintf(sink, "speed %.2f spread %.2f\n", m.meanSpeed, m.spread);
+            }
+        };
+        loop.spawn(sim(loop));
+        loop.spawn(input(loop));
+        loop.spawn(log(loop));
+        loop.spawn(metrics(loop));
+        const std::clock_t c0 = std::clock();
+        loop.run();
+        const double cpu = (double)(std::clock() - c0) / CLOCKS_PER_SEC;
+        table("coroutine", loop.stats(), loop.seconds(), cpu);
+        std::printf("  %llu sleeps, %llu wakes\n", (unsigned long long)loop.sleeps(), (unsigned long long)loop.wakes());
+        for (const TaskStats& s : loop.stats()) {       // 遅れて飛ばした分も含めて周期どおりの回数か
+            const double want = std::floor((SIM_TICKS - 1) * 0.01 * s.hz()) + 1;   // 最後の sim の期限まで
+            ok &= std::fabs((double)(s.runs + s.missed) - want) <= 2.0;
+        }
+    }
+
+    // while loop（1 ms ごとに起きて，回数で振り分ける）
+    {
+        World world(S, S, 20.f, VR, 1);
+        make(world);
+        std::deque<TaskStats> st(4);
+        const char* names[] = { "sim", "input", "log", "metrics" };
+        const int   every[] = { 10, 1, 100, 1000 };    // 何 ms ごとか
+        for (int k = 0; k < 4; ++k) { st[k].name = names[k]; st[k].period = milliseconds(every[k]); }
+        const auto t0 = Clock::now();
+        const std::clock_t c0 = std::clock();
+        int ticks = 0;
+        for (int64_t ms = 0; ticks < SIM_TICKS; ++ms) {
+            const auto due = t0 + milliseconds(ms);
+            std::this_thread::sleep_until(due);
+            for (int k = 0; k < 4; ++k) {
+                if (ms % every[k] != 0) continue;
+                const auto s0 = Clock::now();
+                st[k].record(1e6 * duration<double>(s0 - due).count());
+                switch (k) {
+                    case 0: world.step(dt); ++ticks; break;
+                    case 1: stick = stick + 0.f; break;
+                    case 2: std::fprintf(sink, "tick %d\n", ticks); std::fflush(sink); break;
+                    case 3: { const auto m = world.metrics(); std::fprintf(sink, "speed %.2f spread %.2f\n", m.meanSpeed, m.spread); } break;
+                }
+                st[k].work(1e6 * duration<double>(Clock::now() - s0).count());
+            }
+        }
+        const double cpu = (double)(std::clock() - c0) / CLOCKS_PER_SEC;
+        table("while loop", st, duration<double>(Clock::now() - t0).count(), cpu);
+    }
+    std::fclose(sink);
+    std::printf("tasks: %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// フローフィールドの差分更新の検査：ランダムに障害物を置く/消す・ゴールを動かす編集を
+// ROUNDS 回，同じ編集を 2 枚の場に与え，片方は update()（変わった範囲だけ），
+// もう片方は毎回 rebuild()（全面）で張り直して，全セルの距離が一致するかを見る
+// （同じ長さの経路は足す順で丸めが違うので，差は相対 1e-4 まで許す）
+static int checkFlowField(int ROUNDS)
+{
+    const float W = 1280.f, H = 960.f, C = 20.f;
+    FlowField inc(W, H, C), full(W, H, C);
+    std::srand(26);
+    auto randomPoint = [&]{ return Vec2{ (float)(std::rand() % (int)W), (float)(std::rand() % (int)H) }; };
+    const Vec2 g0{ W * 0.9f, H * 0.5f };
+    inc.setGoal(g0);  full.setGoal(g0);
+    inc.update();     full.rebuild();
+    std::printf("flow field check: %dx%d cells, %d rounds of random edits (1-8 obstacle toggles up to 20%% blocked, goal move 1 in 10)\n",
+                inc.cols(), inc.rows(), ROUNDS);
+    double maxDiff = 0, incSec = 0, fullSec = 0;
+    long   incCells = 0, fullCells = 0, mismatches = 0, goalMoves = 0;
+    int    blocked = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        const int k = 1 + std::rand() % 8;
+        for (int e = 0; e < k; ++e) {
+            Vec2 p = randomPoint();
+            while (blocked >= inc.size() / 5 && !inc.blockedAt(p)) p = randomPoint();   // 障害物は 2 割まで
+            blocked += inc.blockedAt(p) ? -1 : 1;
+            inc.toggleObstacle(p);
+            full.toggleObstacle(p);
+        }
+        if (std::rand() % 10 == 0 || !inc.hasGoal()) {
+            const Vec2 p = randomPoint();
+            inc.setGoal(p);
+            full.setGoal(p);
+            ++goalMoves;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        incCells += inc.update();
+        auto t1 = std::chrono::steady_clock::now();
+        fullCells += full.rebuild();
+        auto t2 = std::chrono::steady_clock::now();
+        incSec  += std::chrono::duration<double>(t1 - t0).count();
+        fullSec += std::chrono::duration<double>(t2 - t1).count();
+        for (int c = 0; c < inc.size(); ++c) {
+            const float a = inc.distance(c), b = full.distance(c);
+            if (std::isinf(a) || std::isinf(b)) { mismatches += std::isinf(a) != std::isinf(b); continue; }
+            const double d = std::fabs((double)a - b);
+            maxDiff = std::max(maxDiff, d);
+            if (d > 1e-4 * std::max(1.0, (double)b)) ++mismatches;
+        }
+    }
+    std::printf("  goal moves %ld, cells recomputed per round: update %.0f, rebuild %.0f\n",
+                goalMoves, (double)incCells / ROUNDS, (double)fullCells / ROUNDS);
+    std::printf("  time per round: update %.1f us, rebuild %.1f us\n", 1e6 * incSec / ROUNDS, 1e6 * fullSec / ROUNDS);
+    std::printf("  max |distance difference| %.2e cells, mismatched cells %ld\n", maxDiff, mismatches);
+    std::printf("flow field: %s\n", mismatches == 0 ? "OK" : "FAILED");
+    return mismatches == 0 ? 0 : 1;
+}
+
+// 決定的モードの検査：同じ初期状態から 1, 2, 3, 4 スレッド（4 は 2 回）で TICKS 進め，
+// 位置・速度と群れの統計がビット単位で一致するかを見る．比較のため速い（非決定的）
+// モードも同じように回し，ティック時間の差をコストとして出す
+static int checkDeterminism(int N)
+{
+    const float S = 1500.f, VR = 40.f, dt = 0.01f;
+    const int   TICKS = 200;
+    const int   runs[] = {1, 2, 3, 4, 4};
+    struct Out { std::vector<Vec2> pv; World::Metrics m; double ms; };
+    auto simulate = [&](bool det, int T) {
+        std::srand(29);
+        World world(S, S, 20.f, VR, T);
+        world.reserve(N);
+        world.deterministic().enabled = det;
+        world.contact().enabled = true;
+        for (int i = 0; i < N; ++i) {
+            Vec2 p{ (float)(std::rand() % (int)S), (float)(std::rand() % (int)S) };
+            world.spawn(p, Agent::randomDir() * 40.f, 3.f, VR);
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        World::Metrics m;
+        for (int s = 0; s < TICKS; ++s) { world.step(dt); m = world.metrics(); }
+        Out o;
+        o.ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / TICKS;
+        o.m  = m;
+        for (const auto& a : world.agents()) { o.pv.push_back(a.pos()); o.pv.push_back(a.vel()); }
+        return o;
+    };
+    auto same = [](const Out& a, const Out& b) {
+        return a.pv.size() == b.pv.size()
+            && std::memcmp(a.pv.data(), b.pv.data(), a.pv.size() * sizeof(Vec2)) == 0
+            && std::memcmp(&a.m, &b.m, sizeof(a.m)) == 0;
+    };
+    std::printf("determinism check: N=%d, %d ticks, contact on, %u cores\n", N, TICKS, std::thread::hardware_concurrency());
+    std::printf("%-14s %8s %10s %14s %14s %12s\n", "mode", "threads", "ms/tick", "mean speed", "spread", "vs 1 thread");
+    bool detOk = true;
+    double cost[2] = {};
+    for (int det = 1; det >= 0; --det) {
+        Out ref;
+        for (int k = 0; k < (int)std::size(runs); ++k) {
+            const Out o = simulate(det, runs[k]);
+            const bool eq = k == 0 || same(ref, o);
+            if (k == 0) ref = o;
+            if (det) detOk &= eq;
+            cost[det] += o.ms;
+            std::printf("%-14s %8d %10.3f %14.9g %14.9g %12s\n", det ? "deterministic" : "fast",
+                        runs[k], o.ms, o.m.meanSpeed, o.m.spread, k == 0 ? "-" : eq ? "identical" : "differs");
+        }
+    }
+    std::printf("deterministic mode cost: %+.1f%% ms/tick (mean over the runs above)\n",
+                100.0 * (cost[1] / cost[0] - 1.0));
+    std::printf("deterministic: %s\n", detOk ? "OK (bit-identical for every thread count and run)" : "FAILED");
+    return detOk ? 0 : 1;
+}
+
+// norm の精度段階ごとに同じ初期状態・同じ乱数列から 10,000 ステップ進め，
+// Exact との位置のずれを 10/100/1000/10000 ステップで測る．群れは混沌的なので
+// 初期位置を 1 ulp ずらした Exact も走らせ，そのずれを基準に上限を判定する．
+// --soa の後処理（SoATail）も同じ段階で |a| / |v| を求めるので，各段階を SoA でも走らせる
+template<class B>
+static std::vector<std::vector<Vec2>> precisionRun(int N, int steps, bool nudge, double& ms, bool soa = false)
+{
+    const float S = 500.f, VR = 50.f, dt = 0.01f;
+    std::srand(21);
+    BasicWorld<2, SemiImplicitEuler, B> world(S, S, 20.f, VR, 1);
+    world.soa().enabled = soa;
+    for (int i = 0; i < N; ++i) {
+        Vec2 p{ 50.f + std::rand() % 400, 50.f + std::rand() % 400 };
+        if (nudge) p[0] = std::nextafter(p[0], S);
+        world.spawn(p, Vec2{ (float)(std::rand() % 81 - 40), (float)(std::rand() % 81 - 40) }, 3.f, VR);
+    }
+    std::vector<std::vector<Vec2>> snaps;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 1; s <= steps; ++s) {
+        world.step(dt);
+        if (s == 10 || s == 100 || s == 1000 || s == steps) {
+            snaps.emplace_back();
+            for (const auto& a : world.agents()) snaps.back().push_back(a.pos());
+            snaps.back().push_back(Vec2{});          // 末尾に（平均速さ, 重心からの広がり）
+            Vec2 c{};
+            float spd = 0.f;
+            for (const auto& a : world.agents()) { c += a.pos(); spd += norm<Precision::Exact>(a.vel()); }
+            c = c * (1.0f / N);
+            float spread = 0.f;
+            for (const auto& a : world.agents()) spread += norm<Precision::Exact>(a.pos() - c);
+            snaps.back().back() = Vec2{ spd / N, spread / N };
+        }
+    }
+    ms = 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / steps;
+    return snaps;
+}
+
+static int checkPrecision(int N)
+{
+    const int STEPS = 10000;
+    const int at[] = { 10, 100, 1000, STEPS };
+    std::printf("precision check: N=%d, world=500x500, %d steps, divergence from Exact (rms / max px)\n", N, STEPS);
+    std::printf("%-12s %9s", "tier", "ms/tick");
+    for (int s : at) std::printf(" %17d", s);
+    std::printf(" %9s %9s\n", "speed", "spread");
+
+    double ms;
+    const auto ref = precisionRun<WithTier<Precision::Exact>>(N, STEPS, false, ms);
+    auto row = [&](const char* name, const std::vector<std::vector<Vec2>>& r, double t, double* rmsOut) {
+        std::printf("%-12s %9.3f", name, t);
+        for (size_t k = 0; k < r.size(); ++k) {
+            double se = 0, me = 0;
+            for (int i = 0; i < N; ++i) {
+                const double e = norm<Precision::Exact>(r[k][i] - ref[k][i]);
+                se += e*e; me = std::max(me, e);
+            }
+            rmsOut[k] = std::sqrt(se / N);
+            std::printf("  %7.3f / %7.3f", rmsOut[k], me);
+        }
+        std::printf(" %9.2f %9.2f\n", r.back()[N][0], r.back()[N][1]);
+    };
+    double base[4], rms[4];
+    row("exact", ref, ms, base);
+    const auto ulp = precisionRun<WithTier<Precision::Exact>>(N, STEPS, true, ms);
+    row("exact+1ulp", ulp, ms, base);
+
+    // 判定：短時間（100 ステップまで）は 1 px 未満，その後は 1 ulp 基準の 4 倍 + 1 px 以内，
+    // 最終の平均速さ・広がりは Exact と 10% 以内（統計的に同じ群れであること）
+    bool ok = true;
+    auto judge = [&](const char* name, const std::vector<std::vector<Vec2>>& r) {
+        for (int k = 0; k < 4; ++k) {
+            const double lim = (k < 2) ? 1.0 : 4.0 * base[k] + 1.0;
+            if (rms[k] > lim) {
+                std::printf("  FAIL %s: rms %.3f > %.3f at step %d\n", name, rms[k], lim, at[k]);
+                ok = false;
+            }
+        }
+        for (int c = 0; c < 2; ++c) {
+            const double x = r.back()[N][c], y = ref.back()[N][c];
+            if (std::fabs(x - y) > 0.1 * std::fabs(y)) {
+                std::printf("  FAIL %s: %s %.2f vs exact %.2f\n", name, c ? "spread" : "speed", x, y);
+                ok = false;
+            }
+        }
+    };
+    const auto nw = precisionRun<WithTier<Precision::Newton>>(N, STEPS, false, ms);
+    row("newton", nw, ms, rms);
+    judge("newton", nw);
+    const auto ap = precisionRun<WithTier<Precision::Approx>>(N, STEPS, false, ms);
+    row("approx", ap, ms, rms);
+    judge("approx", ap);
+    const auto es = precisionRun<WithTier<Precision::Exact>>(N, STEPS, false, ms, true);
+    row("exact+soa", es, ms, rms);
+    judge("exact+soa", es);
+    const auto ns = precisionRun<WithTier<Precision::Newton>>(N, STEPS, false, ms, true);
+    row("newton+soa", ns, ms, rms);
+    judge("newton+soa", ns);
+    const auto as = precisionRun<WithTier<Precision::Approx>>(N, STEPS, false, ms, true);
+    row("approx+soa", as, ms, rms);
+    judge("approx+soa", as);
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// ------------------------------------------------------------
+// 実行オプション
+//   --3d         3 次元（立方体ワールド，y 軸まわりに回る正射影で表示）
+//   --headless   ウィンドウを開かず --steps ティックだけ回して統計を出す
+//   --steps N    headless のティック数（既定 1000）
+//   --agents N   エージェント台数（既定 10）
+//   --predators N 捕食者（種 1）の台数（既定 0）．群れ（種 0）は捕食者から逃げる
+//   --integrator euler | verlet | rk4   積分器（既定 euler = 半陰的オイラー）
+//   --dt T       刻み幅 [s]（既定 0.01）
+//   --adaptive   局所的な硬さに応じて個体ごとにサブステップ（最大 16 分割）
+//   --multirate K 落ち着いた個体は K ティックに 1 回だけ知覚・力計算（既定 1 = 毎回）
+//   --precision exact | newton | approx   距離・制限の norm の精度（既定 exact．--soa の後処理も同じ段階）
+//   --morton K   K ティックごとに個体の配列を Morton 順に並べ替える（既定 0 = しない）
+//   --threads T  知覚を T スレッドのワークスティーリングで（既定 0 = コア数．遮蔽ありの 2D は直列）
+//   --deterministic  スレッド数に依らずビット単位で同じ結果（カウンタ型乱数・固定ブロックの総和）
+//   --compact    2D headless の群れを量子化した詰めた状態（位置 16 bit・速度半精度，12 B/体）で進める
+//                （1 種・euler だけ．--goal / --occlusion / --contact / --soa / --adaptive / --multirate /
+//                  --morton / --checkpoint / --params / --predators とは組み合わせられない）
+// ------------------------------------------------------------
+struct Options {
+    std::string integrator = "euler";
+    std::string precision  = "exact";
+    float dt       = 0.01f;
+    bool adaptive  = false;
+    bool goal      = false;              // 2D：壁とゴールのフローフィールドを置く
+    bool occlusion = false;              // 2D：障害物・他個体の陰は見えない（DDA の視線判定）
+    bool contact   = false;              // 半径ぶんは重ならない（位置ベースの接触ソルバ）
+    bool soa       = false;              // 積分の後処理を SoA の分岐なしパスで（丸めが AoS と変わる）
+    bool compact   = false;              // 2D headless：量子化した詰めた状態（CompactFlock）で進める
+    int  multirate = 1;
+    int  morton    = 0;
+    int  threads   = 0;
+    bool deterministic = false;
+    bool three     = false;
+    bool headless  = false;
+    int  steps     = 1000;
+    int  agents    = 10;
+    int  predators = 0;
+    int  checkpoint = 0;                 // 何ティックごとに fork でチェックポイントを取るか（0 なら取らない）
+    int  snapshots  = 1;                 // 同時に書いている子の上限
+    std::string checkpointDir = ".";
+    std::string params;                  // 見張る JSON のパラメータファイル
+};
+
+// --checkpoint K [--checkpoint-dir D] [--snapshots M]
+template<class WorldT>
+static void configureCheckpoint(WorldT& world, const Options& opt)
+{
+#ifdef __linux__
+    ForkCheckpoint& c = world.checkpoint();
+    c.enabled     = opt.checkpoint > 0;
+    c.period      = opt.checkpoint;
+    c.maxInFlight = opt.snapshots;
+    c.dir         = opt.checkpointDir;
+#else
+    if (opt.checkpoint > 0) std::fprintf(stderr, "--checkpoint needs fork(); ignored\n");
+    (void)world;
+#endif
+}
+
+// --params FILE：種の設定（捕食者など）を済ませた表を土台に見張り始める
+template<class WorldT>
+static bool watchParams(WorldT& world, const Options& opt)
+{
+    if (opt.params.empty()) return true;
+    if (!world.params().watch(opt.params, world.species())) return false;
+    std::printf("params: watching %s (edit and save to apply at the next tick)\n", opt.params.c_str());
+    return true;
+}
+
+// 種 0 = 群れ（既定ゲイン），種 1 = 捕食者（単独で速く，群れを追う）
+static void setupPredatorPrey(SpeciesTable& sp)
+{
+    sp.resize(2);
+    SpeciesParams& pred = sp.params(1);
+    pred.k_ali  = 0.f;
+    pred.k_coh  = 0.f;
+    pred.k_goal = 0.f;
+    pred.Vmax   = 130.f;
+    pred.Amax   = 150.f;
+    sp.setInteract(1, 0,  +80.f);   // 捕食者 → 群れ：追う
+    sp.setInteract(0, 1, -150.f);   // 群れ → 捕食者：逃げる
+}
+
+// 群れはワールド中心から全方向へ散らばる初期状態，捕食者はランダムな位置から
+template<class WorldT>
+static void spawnAgents(WorldT& world, int N, float R, float VR, int predators = 0)
+{
+    constexpr int D = WorldT::dim;
+    using VecD = Vec<D>;
+    using AgentD = typename WorldT::AgentD;
+    world.reserve(N + predators);
+    if (predators > 0) setupPredatorPrey(world.species());
+    for (int i=0; i<predators; ++i){
+        VecD p;
+        for (int k=0; k<D; ++k) p[k] = ((float)std::rand()/RAND_MAX) * world.extent()[k];
+        world.spawn(p, AgentD::randomDir() * 50.f, R*1.5f, VR, 1);
+    }
     for (int i=0; i<N; ++i){
-        float ang = (float)std::rand()/RAND_MAX * 2.f*PI;
+        VecD dir = AgentD::randomDir();
         float spd = 40.f + (std::rand()%60);
-        agents.emplace_back(
-            Vec2{W*0.5f, H*0.5f},                      // 初期位置＝中心
-            Vec2{std::cos(ang)*spd, std::sin(ang)*spd},// 初期速度
+        world.spawn(
+            world.extent() * 0.5f,                     // 初期位置＝中心
+            dir * spd,                                 // 初期速度
             R, VR
         );
     }
+}
+
+// ウィンドウなしで steps ティック進め，所要時間と群れの統計を出す
+template<class WorldT>
+static int runHeadless(WorldT& world, int steps, float dt)
+{
+    constexpr int D = WorldT::dim;
+    const uint64_t news0 = AllocCounter::news();
+    const auto t0 = std::chrono::steady_clock::now();
+    int    parallelTicks = 0, stolen = 0;
+    double imbalance = 0, worst = 1;
+    for (int s = 0; s < steps; ++s) {
+        world.step(dt);
+        const auto& st = world.scheduler().last();
+        if (st.threads > 1) {                          // 直列で回したティックは threads = 0
+            ++parallelTicks;
+            stolen    += st.stolen;
+            imbalance += st.imbalance;
+            worst      = std::max(worst, st.imbalance);
+        }
+    }
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const uint64_t news = AllocCounter::news() - news0;
+
+    const auto m = world.metrics();
+    std::printf("%dD headless (%s, dt=%g): N=%d, %d steps, %.3f ms/tick, mean speed %.2f, mean dist to centroid %.2f\n",
+                D, WorldT::integrator::name, dt, world.population(), steps, 1e3 * sec / std::max(1, steps), m.meanSpeed, m.spread);
+    if (world.deterministic().enabled)
+        std::printf("  deterministic (%d threads): counter RNG, fixed-block tree sums\n", world.threads());
+    if (world.multirate().enabled) {
+        const auto& st = world.multirate().stats();
+        std::printf("  multirate (period %d): updated %.1f%% of agent-ticks, %llu wakes\n",
+                    world.multirate().period, 100.0 * st.updated / std::max<uint64_t>(1, st.agentTicks),
+                    (unsigned long long)st.wakes);
+    }
+    if (world.substep().enabled) {
+        const auto& st = world.substep().stats();
+        std::printf("  adaptive substeps: mean %.2f, max %d, refined %.1f%% of agent-ticks\n",
+                    (double)st.substeps / std::max<uint64_t>(1, st.agentTicks), st.maxUsed,
+                    100.0 * st.refined / std::max<uint64_t>(1, st.agentTicks));
+    }
+    if (parallelTicks > 0)
+        std::printf("  work stealing (%d threads, %d tasks): imbalance mean %.2f, worst %.2f, stolen %.1f tasks/tick\n",
+                    world.scheduler().last().threads, world.scheduler().last().tasks,
+                    imbalance / parallelTicks, worst, (double)stolen / parallelTicks);
+#ifdef __linux__
+    if (world.checkpoint().enabled) {
+        world.checkpoint().poll(true);                 // 書いている子を待つ
+        const auto& st = world.checkpoint().stats();
+        std::printf("  fork checkpoints (every %d ticks, <= %d in flight): %d written, %d skipped, %d failed, "
+                    "pause max %.2f ms, latency mean %.1f ms / max %.1f ms, parent faults %.0f per snapshot\n",
+                    world.checkpoint().period, world.checkpoint().maxInFlight, st.done, st.skipped, st.failed,
+                    st.pauseMsMax, st.latencyMsSum / std::max(1, st.done), st.latencyMsMax,
+                    (double)st.parentFaults / std::max(1, st.done));
+    }
+#endif
+    if (world.params().enabled()) {
+        const auto& st = world.params().stats();
+        std::printf("  params %s: %llu reloads, %llu rejected, %llu applied (now version %llu), parse max %.2f ms\n",
+                    world.params().path().c_str(), (unsigned long long)st.reloads.load(), (unsigned long long)st.failures.load(),
+                    (unsigned long long)st.applied.load(), (unsigned long long)world.params().version(), st.parseMsMax.load());
+    }
+    if (BOIDS_COUNT_ALLOC)
+        std::printf("  heap allocations in the loop: %llu (arena high-water %zu bytes)\n",
+                    (unsigned long long)news, world.arena().highWater());
+    return 0;
+}
+
+// --compact：spawn した群れを CompactFlock（2D 12 B/体）に詰め，量子化した状態のまま
+// flockStep で steps ティック進める．乱数力は決定的モードと同じカウンタ型（系列 = 生成順）．
+// 1 種・半陰的オイラーだけ（ゴール・遮蔽・接触などは main で断る）
+template<class Behavior, class WorldT>
+static int runCompact(WorldT& world, int steps, float dt)
+{
+    const float VR = world.agents().empty() ? 1.f : world.agents()[0].viewRadius();
+    const float R  = world.agents().empty() ? 1.f : world.agents()[0].radius();
+    const float C  = VR * 0.5f;                        // World の格子と同じセル幅
+    std::vector<Vec2> p, v;
+    for (const auto& a : world.agents()) { p.push_back(a.pos()); v.push_back(a.vel()); }
+    const SpeciesParams& P = world.species().params(0);
+    CompactFlock<2> cf(world.extent(), C, R, P);
+    cf.assign(p, v);
+    Deterministic det;
+    det.enabled = true;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s)
+        cf.template flockStep<Behavior>(dt, VR, [&](uint32_t id){
+            return Agent::randomDir(RandomDraw{ &det, id, (uint32_t)s }) * 30.f * P.k_ran;
+        });
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cf.unpack(p, v);
+    Vec2 c{};
+    double spd = 0, spread = 0;
+    for (size_t i = 0; i < p.size(); ++i) { c += p[i]; spd += norm(v[i]); }
+    c = c * (1.0f / std::max<size_t>(1, p.size()));
+    for (const Vec2& q : p) spread += norm(q - c);
+    const double n = (double)std::max<size_t>(1, p.size());
+    std::printf("2D headless compact (%s, dt=%g): N=%d, %d steps, %.3f ms/tick, mean speed %.2f, mean dist to centroid %.2f\n",
+                WorldT::integrator::name, dt, cf.size(), steps, 1e3 * sec / std::max(1, steps), spd / n, spread / n);
+    std::printf("  compact state: %zu bytes/agent (World %zu), cell %.0f, %d rebins\n",
+                CompactFlock<2>::bytesPerAgent(), sizeof(typename WorldT::AgentD), C, cf.rebins());
+    return 0;
+}
+
+// ウィンドウありのループの周期タスク：ログを 10 Hz で書き出す（printf は溜めておく）
+static PeriodicTask flushLog(TaskLoop& L)
+{
+    for (Ticker t = L.every("log", std::chrono::milliseconds(100)); co_await t.next(); )
+        std::fflush(stdout);
+}
+
+// 1 Hz で群れの統計を 1 行
+template<class WorldT>
+static PeriodicTask printMetrics(TaskLoop& L, WorldT& world)
+{
+    for (Ticker t = L.every("metrics", std::chrono::seconds(1)); co_await t.next(); ) {
+        const auto m = world.metrics();
+        std::printf("metrics: N=%d, mean speed %.2f, mean dist to centroid %.2f\n",
+                    world.population(), m.meanSpeed, m.spread);
+    }
+}
+
+template<class Integrator, class Behavior = FullBoids>
+static int run3D(const Options& opt)
+{
+    const float S   = 500.f;  // 立方体の一辺
+    const float R   = 5.f;
+    const float VR  = 200.f;
+    const float dt  = opt.dt;
 
-    auto next = std::chrono::steady_clock::now();
-    while (!renderer.shouldClose()) {
-        const std::vector<Agent> snap = agents;       // 同時刻参照
+    BasicWorld<3, Integrator, Behavior> world(Vec3{S, S, S}, 0.f, VR, opt.threads);
+    world.contact().enabled = opt.contact;
+    world.soa().enabled     = opt.soa;
+    world.substep().enabled = opt.adaptive;
+    world.multirate().enabled = opt.multirate > 1;
+    world.multirate().period  = opt.multirate;
+    world.morton().enabled = opt.morton > 0;
+    world.morton().period  = opt.morton;
+    world.deterministic().enabled = opt.deterministic;
+    configureCheckpoint(world, opt);
+    spawnAgents(world, opt.agents, R, VR, opt.predators);
+    if (!watchParams(world, opt)) return 1;
+    world.logPlacement(stdout);
+    if (opt.headless) return runHeadless(world, opt.steps, dt);
 
-        for (auto& a : agents) {
-            a.drive((float)dt, snap, (float)W, (float)H); // ★uは使わない
+    Renderer renderer(500, 500, "Boids 3D (mass-damper, orthographic)");
+    if (!renderer.good()) return -1;
+
+    // 物理 1/dt Hz，描画 60 Hz，入力 1 kHz，ログ 10 Hz，メトリクス 1 Hz
+    float yaw = 0.f, spin = 0.3f;
+    Vec2  stick{};
+    TaskLoop loop;
+    auto sim = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("sim", std::chrono::duration<double>(dt)); co_await t.next(); ) {
+            world.step(dt);
+            yaw += spin * dt;                          // ゆっくり回して奥行きを見せる（スティックで速さを変える）
+        }
+    };
+    auto render = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("render", std::chrono::duration<double>(1.0 / Renderer::kFrameHz)); co_await t.next(); ) {
+            renderer.beginFrame();
+            renderer.drawAgents(world.agents(), world.extent(), yaw);
+            renderer.endFrame();
+            t.realign(std::chrono::steady_clock::now() - Renderer::kSwapLead);
+            if (renderer.shouldClose()) L.stop();
+        }
+    };
+    auto input = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("input", std::chrono::milliseconds(1)); co_await t.next(); ) {
+            renderer.pollInput(stick);
+            spin = 0.3f + 2.f * stick.x;
         }
+    };
+    loop.spawn(sim(loop));
+    loop.spawn(render(loop));
+    loop.spawn(input(loop));
+    loop.spawn(flushLog(loop));
+    loop.spawn(printMetrics(loop, world));
+    loop.run();
+    loop.report(stdout);
+    return 0;
+}
 
-        renderer.beginFrame();
-        renderer.drawAgents(agents);
-        renderer.endFrame();
+template<class Integrator, class Behavior = FullBoids>
+static int run2D(const Options& opt)
+{
+    const int   W   = 500;
+    const int   H   = 500;
+    const int   N   = opt.agents; // エージェント台数
+    const float R   = 5.f;    // 半径
+    const float VR  = 200.f;  // 視野半径
+    const double dt = opt.dt; // サンプリング [s]（既定 100Hz）
+    const float CELL = 20.f;  // フローフィールドのセル幅
 
-        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
-                    std::chrono::duration<double>(dt));
-        std::this_thread::sleep_until(next);
+    BasicWorld<2, Integrator, Behavior> world((float)W, (float)H, CELL, VR, opt.threads);
+    world.visibility().enabled = opt.occlusion;       // 障害物・他個体の陰は見えない
+    world.contact().enabled    = opt.contact;         // 半径ぶんは重ならない
+    world.soa().enabled        = opt.soa;             // 後処理を SoA の 1 パスで
+    world.substep().enabled    = opt.adaptive;        // 混み合った個体だけ刻む
+    world.multirate().enabled  = opt.multirate > 1;   // 落ち着いた個体は間引く
+    world.multirate().period   = opt.multirate;
+    world.morton().enabled     = opt.morton > 0;      // 配列を Z 順に並べ直す
+    world.morton().period      = opt.morton;
+    world.deterministic().enabled = opt.deterministic;  // スレッド数に依らない結果
+    configureCheckpoint(world, opt);
+    spawnAgents(world, N, R, VR, opt.predators);
+    if (!watchParams(world, opt)) return 1;
+    world.logPlacement(stdout);
+
+    // --goal：フローフィールドに中央右の縦の壁（中ほどに隙間）と右端のゴールを置く
+    // （置かなければゴール項は 0 で，もとの群れのまま）
+    // 左クリック＝ゴール移動，右クリック＝障害物の置く/消す
+    FlowField& flow = world.flow();
+    if (opt.goal) {
+        for (float y = H*0.2f; y < H*0.8f; y += CELL)
+            if (y < H*0.45f || y > H*0.55f) flow.setObstacle(Vec2{W*0.65f, y}, true);
+        flow.setGoal(Vec2{W*0.9f, H*0.5f});
     }
+
+    if (opt.compact)  return runCompact<Behavior>(world, opt.steps, (float)dt);
+    if (opt.headless) return runHeadless(world, opt.steps, (float)dt);
+
+    Renderer renderer(W, H, "Boids (mass-damper, a->v->p)");
+    if (!renderer.good()) return -1;
+    renderer.setBackground(1.f, 1.f, 1.f);
+
+    // 物理 1/dt Hz，描画 60 Hz，入力 1 kHz（クリックとスティックでゴールを動かす），ログ 10 Hz，メトリクス 1 Hz
+    auto& agents = world.agents();
+    Vec2 goal{W*0.9f, H*0.5f}, stick{};
+    TaskLoop loop;
+    auto sim = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("sim", std::chrono::duration<double>(dt)); co_await t.next(); )
+            world.step((float)dt);
+    };
+    auto render = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("render", std::chrono::duration<double>(1.0 / Renderer::kFrameHz)); co_await t.next(); ) {
+            renderer.beginFrame();
+            renderer.drawFlowField(flow);
+            renderer.drawAgents(agents);
+            renderer.endFrame();
+            t.realign(std::chrono::steady_clock::now() - Renderer::kSwapLead);
+            if (renderer.shouldClose()) L.stop();
+        }
+    };
+    auto input = [&](TaskLoop& L) -> PeriodicTask {
+        for (Ticker t = L.every("input", std::chrono::milliseconds(1)); co_await t.next(); ) {
+            renderer.pollInput(stick);
+            Vec2 click; int button;
+            while (renderer.popClick(click, button)) {
+                if (button == GLFW_MOUSE_BUTTON_LEFT)  flow.setGoal(goal = click);
+                if (button == GLFW_MOUSE_BUTTON_RIGHT) flow.toggleObstacle(click);
+            }
+            if (stick.x != 0.f || stick.y != 0.f) {   // 200 px/s．同じセルの間は setGoal は何もしない
+                goal.x = std::clamp(goal.x + 0.2f * stick.x, 0.f, W - 1.f);
+                goal.y = std::clamp(goal.y + 0.2f * stick.y, 0.f, H - 1.f);
+                flow.setGoal(goal);
+            }
+        }
+    };
+    loop.spawn(sim(loop));
+    loop.spawn(render(loop));
+    loop.spawn(input(loop));
+    loop.spawn(flushLog(loop));
+    loop.spawn(printMetrics(loop, world));
+    loop.run();
+    loop.report(stdout);
     return 0;
 }
+
+int main(int argc, char** argv){
+    if (argc > 1 && std::strcmp(argv[1], "--bench-perception") == 0)
+        return benchPerception(argc > 2 ? std::atoi(argv[2]) : 5000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-contact") == 0)
+        return benchContact(argc > 2 ? std::atoi(argv[2]) : 20000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-species") == 0)
+        return benchSpecies(argc > 2 ? std::atoi(argv[2]) : 10000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-integrators") == 0)
+        return benchIntegrators(argc > 2 ? std::atoi(argv[2]) : 200);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-substep") == 0)
+        return benchSubstep(argc > 2 ? std::atoi(argv[2]) : 300);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-multirate") == 0)
+        return benchMultirate(argc > 2 ? std::atoi(argv[2]) : 5000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-behavior") == 0)
+        return benchBehavior(argc > 2 ? std::atoi(argv[2]) : 10000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-fixed") == 0)
+        return benchFixed();
+    if (argc > 1 && std::strcmp(argv[1], "--bench-tail") == 0)
+        return benchTail(argc > 2 ? std::atoi(argv[2]) : 10000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-precision") == 0)
+        return checkPrecision(argc > 2 ? std::atoi(argv[2]) : 200);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-morton") == 0)
+        return benchMorton(argc > 2 ? std::atoi(argv[2]) : 50000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-population") == 0)
+        return benchPopulation(argc > 2 ? std::atoi(argv[2]) : 10000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-alloc") == 0)
+        return checkAlloc(argc > 2 ? std::atoi(argv[2]) : 1000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-placement") == 0)
+        return checkPlacement(argc > 2 ? std::atoi(argv[2]) : 1000000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-flowfield") == 0)
+        return checkFlowField(argc > 2 ? std::atoi(argv[2]) : 2000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-tasks") == 0)
+        return checkTasks(argc > 2 ? std::atof(argv[2]) : 3.0);
+    if (argc > 1 && std::strcmp(argv[1], "--check-determinism") == 0)
+        return checkDeterminism(argc > 2 ? std::atoi(argv[2]) : 4000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-domain") == 0)
+        return checkDomain(argc > 2 ? std::atoi(argv[2]) : 20000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-rebalance") == 0)
+        return benchRebalance(argc > 2 ? std::atoi(argv[2]) : 8000);
+#ifdef __linux__
+    if (argc > 1 && std::strcmp(argv[1], "--check-stream") == 0)
+        return checkStream(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000);
+    if (argc > 1 && std::strcmp(argv[1], "--stream") == 0)
+        return runStream(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--check-checkpoint") == 0)
+        return checkCheckpoint(argc > 2 ? std::atoi(argv[2]) : 200000);
+    if (argc > 1 && std::strcmp(argv[1], "--check-reload") == 0)
+        return checkReload(argc > 2 ? std::atoi(argv[2]) : 2000);
+#endif
+    if (argc > 1 && std::strcmp(argv[1], "--domain") == 0)
+        return runDomain(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-steal") == 0)
+        return benchSteal(argc > 2 ? std::atoi(argv[2]) : 20000);
+    if (argc > 1 && std::strcmp(argv[1], "--bench-compact") == 0)
+        return benchCompact(argc > 2 ? std::atoi(argv[2]) : 10000000);
+
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        if      (!std::strcmp(argv[i], "--3d"))                   opt.three    = true;
+        else if (!std::strcmp(argv[i], "--headless"))             opt.headless = true;
+        else if (!std::strcmp(argv[i], "--adaptive"))             opt.adaptive = true;
+        else if (!std::strcmp(argv[i], "--goal"))                 opt.goal     = true;
+        else if (!std::strcmp(argv[i], "--occlusion"))            opt.occlusion = true;
+        else if (!std::strcmp(argv[i], "--contact"))              opt.contact  = true;
+        else if (!std::strcmp(argv[i], "--soa"))                  opt.soa      = true;
+        else if (!std::strcmp(argv[i], "--compact"))              opt.compact  = true;
+        else if (!std::strcmp(argv[i], "--deterministic"))        opt.deterministic = true;
+        else if (!std::strcmp(argv[i], "--steps")  && i+1 < argc) opt.steps    = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--agents") && i+1 < argc) opt.agents   = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--predators") && i+1 < argc) opt.predators = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--dt")     && i+1 < argc) opt.dt       = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--multirate") && i+1 < argc) opt.multirate = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--morton")    && i+1 < argc) opt.morton    = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads")   && i+1 < argc) opt.threads   = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--checkpoint") && i+1 < argc) opt.checkpoint = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--snapshots")  && i+1 < argc) opt.snapshots  = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--checkpoint-dir") && i+1 < argc) opt.checkpointDir = argv[++i];
+        else if (!std::strcmp(argv[i], "--params")     && i+1 < argc) opt.params     = argv[++i];
+        else if (!std::strcmp(argv[i], "--integrator") && i+1 < argc) opt.integrator = argv[++i];
+        else if (!std::strcmp(argv[i], "--precision")  && i+1 < argc) opt.precision  = argv[++i];
+        else { std::fprintf(stderr, "unknown option: %s\n", argv[i]); return 1; }
+    }
+
+    std::srand((unsigned)std::time(nullptr));
+    // 積分器 × norm の精度段階の実体化を選ぶ
+    auto run = [&]<class I>() {
+        auto go = [&]<class B>() { return opt.three ? run3D<I, B>(opt) : run2D<I, B>(opt); };
+        if (opt.precision == "newton") return go.template operator()<WithTier<Precision::Newton>>();
+        if (opt.precision == "approx") return go.template operator()<WithTier<Precision::Approx>>();
+        return go.template operator()<FullBoids>();
+    };
+    if (opt.precision != "exact" && opt.precision != "newton" && opt.precision != "approx") {
+        std::fprintf(stderr, "unknown precision: %s (exact | newton | approx)\n", opt.precision.c_str());
+        return 1;
+    }
+    if (opt.compact && (opt.three || !opt.headless || opt.integrator != "euler" || opt.predators > 0 || opt.goal
+                        || opt.occlusion || opt.contact || opt.soa || opt.adaptive || opt.multirate > 1
+                        || opt.morton > 0 || opt.checkpoint > 0 || !opt.params.empty())) {
+        std::fprintf(stderr, "--compact runs the 2D headless euler flock of one species only "
+                             "(no --3d, --predators, --goal, --occlusion, --contact, --soa, --adaptive, "
+                             "--multirate, --morton, --checkpoint, --params)\n");
+        return 1;
+    }
+    if (opt.integrator == "euler")  return run.template operator()<SemiImplicitEuler>();
+    if (opt.integrator == "verlet") return run.template operator()<VelocityVerlet>();
+    if (opt.integrator == "rk4")    return run.template operator()<RK4>();
+    std::fprintf(stderr, "unknown integrator: %s (euler | verlet | rk4)\n", opt.integrator.c_str());
+    return 1;
+}